@@ -14,6 +14,11 @@
 #include "SceneManager.h"
 #include "KeyboardController.h"
 #include "MouseController.h"
+#include "UniformCache.h"
+#include "ShaderCache.h"
+#include "AssetCache.h"
+#include "LoadTGA.h"
+#include "LightBaker.h"
 
 GLFWwindow* m_window;
 const unsigned char FPS = 60; // FPS of this game
@@ -89,7 +94,7 @@ void Application::Init()
 	}
 
 	//Set the GLFW window creation hints - these are optional
-	glfwWindowHint(GLFW_SAMPLES, 4); //Request 4x antialiasing
+	glfwWindowHint(GLFW_SAMPLES, 0); //The scene is antialiased in the renderer's offscreen target instead
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); //Request a specific OpenGL version
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); //Request a specific OpenGL version
 	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
@@ -142,14 +147,23 @@ void Application::Init()
 		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
 		//return -1;
 	}
+
+	// Keep textures uncompressed where the driver cannot sample BC1/BC3
+	if (!GLEW_EXT_texture_compression_s3tc)
+		SetTextureCompression(false);
 }
 
 void Application::Run()
 {
 	//initialize the scene manager and set the first scene to be the lobby
 	SceneManager::GetInstance()->Init();
+	SceneManager::GetInstance()->SetAntiAliasing(antiAliasing);
 
 	m_timer.startTimer();    // Start timer to calculate how long it takes to render this frame
+
+	// GPU render time since shader variants were last switched on or off
+	double variantRenderTime = 0.0;
+	unsigned variantFrames = 0;
 	while (!glfwWindowShouldClose(m_window) && !IsKeyPressed(VK_ESCAPE))
 	{
 
@@ -182,6 +196,75 @@ void Application::Run()
 
 		SceneManager::GetInstance()->Update(m_timer.getElapsedTime());
 		SceneManager::GetInstance()->Render();
+		variantRenderTime += SceneManager::GetInstance()->GetLastRenderTime();
+		++variantFrames;
+
+		// Report how many uniform uploads the shadow copy saved last frame
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F3))
+		{
+			const UniformCache::Stats& stats = UniformCache::GetInstance()->GetLastFrameStats();
+			printf("Uniform uploads: %u, skipped: %u\n", stats.uploads, stats.skipped);
+			const Mesh::MemoryStats& fetch = Mesh::GetLastFrameFetchStats();
+			printf("Vertex/index fetch: %llu KB (unpacked %llu KB)\n", fetch.bytes / 1024, fetch.unpackedBytes / 1024);
+			printf("Scene render (GPU): %.3f ms\n", SceneManager::GetInstance()->GetLastRenderTime() * 1000.0);
+			const RenderQueue::CullStats& cull = SceneManager::GetInstance()->GetLastCullStats();
+			printf("Frustum culling: %u visible, %u culled, %u material ranges culled\n", cull.visible, cull.culled, cull.culledMaterials);
+			printf("Coarser levels of detail: %u\n", cull.coarserLods);
+			printf("Portal cells: %u rendered, %u culled\n", cull.visibleCells, cull.culledCells);
+			if (SceneManager::GetInstance()->IsUsingDynamicResolution())
+				printf("Scene resolution: %.0f%% of the window\n", SceneManager::GetInstance()->GetResolutionScale() * 100.f);
+			printf("Anti-aliasing: %s, scene target %.1f MB\n",
+				DynamicResolution::GetName(SceneManager::GetInstance()->GetAntiAliasing()),
+				SceneManager::GetInstance()->GetSceneTargetMemory() / (1024.0 * 1024.0));
+			if (cull.clusteredLights > 0)
+				printf("Clustered lights: %u, %.1f per cluster on average, %u at most\n", cull.clusteredLights,
+					static_cast<double>(cull.clusterLightRefs) / LightClusters::CLUSTER_COUNT, cull.maxClusterLights);
+			const ShaderCache::Stats& shaders = ShaderCache::GetInstance()->GetStats();
+			printf("Shader programs: %u compiled, %u from binary, %u shared, %.1f ms spent, about %.1f ms saved\n",
+				shaders.compiled, shaders.fromBinary, shaders.shared, shaders.loadTime * 1000.0, shaders.savedTime * 1000.0);
+			const LightBaker::Stats& bake = LightBaker::GetLastBakeStats();
+			if (bake.vertices > 0 || bake.fromCache > 0)
+				printf("Last light bake: %u vertices on %u threads, %u from cache, %.1f ms\n",
+					bake.vertices, bake.threads, bake.fromCache, bake.bakeTime * 1000.0);
+		}
+
+		// Toggle threaded asset loading to compare the longest frame of a switch
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F4))
+		{
+			AssetCache* assets = AssetCache::GetInstance();
+			assets->SetAsync(!assets->IsAsync());
+			printf("Asset loading: %s\n", assets->IsAsync() ? "threaded" : "synchronous");
+		}
+
+		// Toggle mipmapped sampling to compare the scene render time on F3
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F5))
+		{
+			AssetCache* assets = AssetCache::GetInstance();
+			assets->SetMipmapping(!assets->IsMipmapping());
+			printf("Texture sampling: %s\n", assets->IsMipmapping() ? "mipmapped" : "top level only");
+		}
+
+		// Switch between shader variants and the plain shaders' switch uniforms, printing the
+		// average GPU render time of the mode being left so the two can be compared
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F6))
+		{
+			SceneManager* scenes = SceneManager::GetInstance();
+			bool variants = scenes->IsUsingShaderVariants();
+			printf("Scene render (GPU) with %s: %.3f ms over %u frames\n", variants ? "shader variants" : "plain shaders",
+				variantFrames ? variantRenderTime / variantFrames * 1000.0 : 0.0, variantFrames);
+			scenes->SetUseShaderVariants(!variants);
+			printf("Shaders: %s\n", variants ? "plain" : "variants");
+			variantRenderTime = 0.0;
+			variantFrames = 0;
+		}
+
+		// Toggle the dynamic resolution scaling to compare against drawing at window size
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F7))
+		{
+			SceneManager* scenes = SceneManager::GetInstance();
+			scenes->SetUseDynamicResolution(!scenes->IsUsingDynamicResolution());
+			printf("Dynamic resolution: %s\n", scenes->IsUsingDynamicResolution() ? "on" : "off");
+		}
 
 		//Swap buffers
 		glfwSwapBuffers(m_window);
@@ -203,10 +286,89 @@ void Application::Run()
 	SceneManager::GetInstance()->Exit();
 }
 
+/******************************************************************************/
+/*!
+\brief
+Draw every scene with each anti-aliasing mode in turn and print the average
+and worst GPU render time and the memory of the scene target. The scaling is
+off, so every mode draws at window size. Runs instead of Run.
+*/
+/******************************************************************************/
+void Application::BenchmarkAntiAliasing()
+{
+	const unsigned WARMUP_FRAMES = 30;
+	const unsigned MEASURED_FRAMES = 120;
+	const SceneManager::SCENE_TYPE sceneTypes[] = {
+		SceneManager::SCENE_LOBBY,
+		SceneManager::SCENE_DUCKS,
+		SceneManager::SCENE_SHOOTING,
+		SceneManager::SCENE_CANS,
+		SceneManager::SCENE_TANK,
+	};
+	const char* sceneNames[] = { "Lobby", "Ducks", "Shooting", "Cans", "Tank" };
+	const DynamicResolution::ANTI_ALIASING modes[] = {
+		DynamicResolution::AA_MSAA,
+		DynamicResolution::AA_FXAA,
+		DynamicResolution::AA_NONE,
+	};
+
+	SceneManager* scenes = SceneManager::GetInstance();
+	scenes->Init();
+	scenes->SetUseDynamicResolution(false);
+	m_timer.startTimer();
+	auto runFrame = [&]()
+	{
+		scenes->Update(m_timer.getElapsedTime());
+		scenes->Render();
+		glfwSwapBuffers(m_window);
+		glfwPollEvents();
+	};
+
+	printf("%-10s %-6s %12s %12s %12s\n", "Scene", "AA", "GPU ms", "worst ms", "target MB");
+	for (unsigned scene = 0; scene < sizeof(sceneTypes) / sizeof(sceneTypes[0]); ++scene)
+	{
+		SceneManager::SCENE_TYPE sceneType = sceneTypes[scene];
+		if (scenes->GetCurrentSceneType() != sceneType)
+			scenes->SwitchScene(sceneType);
+		do
+		{
+			runFrame();
+		} while (scenes->IsLoading() && !glfwWindowShouldClose(m_window));
+
+		for (DynamicResolution::ANTI_ALIASING mode : modes)
+		{
+			scenes->SetAntiAliasing(mode);
+			for (unsigned i = 0; i < WARMUP_FRAMES; ++i)
+				runFrame();
+
+			double total = 0.0, worst = 0.0;
+			for (unsigned i = 0; i < MEASURED_FRAMES; ++i)
+			{
+				runFrame();
+				double renderTime = scenes->GetLastRenderTime();
+				total += renderTime;
+				if (renderTime > worst)
+					worst = renderTime;
+			}
+			printf("%-10s %-6s %12.3f %12.3f %12.1f\n", sceneNames[scene], DynamicResolution::GetName(mode),
+				total / MEASURED_FRAMES * 1000.0, worst * 1000.0, scenes->GetSceneTargetMemory() / (1024.0 * 1024.0));
+		}
+	}
+	scenes->Exit();
+}
+
+void Application::SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing)
+{
+	this->antiAliasing = antiAliasing;
+}
+
 void Application::Exit()
 {
 	SceneManager::DestroyInstance();
 	KeyboardController::DestroyInstance();
+	UniformCache::DestroyInstance();
+	ShaderCache::DestroyInstance();
+	AssetCache::DestroyInstance();
 
 	//Close OpenGL window and terminate GLFW
 	glfwDestroyWindow(m_window);
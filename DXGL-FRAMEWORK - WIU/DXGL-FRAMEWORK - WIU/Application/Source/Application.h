@@ -3,6 +3,7 @@
 #define APPLICATION_H
 
 #include "timer.h"
+#include "DynamicResolution.h"
 
 class Application
 {
@@ -12,6 +13,8 @@ public:
 	void Init();
 	void Run();
 	void Exit();
+	void BenchmarkAntiAliasing();
+	void SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing);
 	static bool IsKeyPressed(unsigned short key);
 
 private:
@@ -21,6 +24,9 @@ private:
 
 	bool enablePointer = true;
 	bool showPointer = true;
+
+	// Of the scene render, picked with --aa= at startup
+	DynamicResolution::ANTI_ALIASING antiAliasing = DynamicResolution::AA_MSAA;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,684 @@
+#include "AssetCache.h"
+#include "GL\glew.h"
+#include "LoadTGA.h"
+
+#include <cctype>
+#include <iostream>
+#include <set>
+#include <memory>
+#include <sstream>
+
+
+namespace
+{
+	// Key part for a color, so two meshes that only differ in color do not share
+	std::string ColorKey(const glm::vec3& color)
+	{
+		std::ostringstream key;
+		key << color.r << ',' << color.g << ',' << color.b;
+		return key.str();
+	}
+
+	// Key of a texture file, so different spellings of one path share the texture
+	std::string TextureKey(const std::string& file_path, bool compress)
+	{
+		std::string key;
+		for (char c : file_path)
+		{
+			c = c == '\\' ? '/' : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+			if (c != '/' || key.empty() || key.back() != '/')
+				key += c;
+		}
+		return compress ? key : key + "|raw";
+	}
+
+	// Path with the spaces around it dropped
+	std::string TrimPath(const std::string& path)
+	{
+		size_t first = path.find_first_not_of(" \t");
+		if (first == std::string::npos)
+			return std::string();
+		return path.substr(first, path.find_last_not_of(" \t") - first + 1);
+	}
+
+	// Counterclockwise turns that bring a skybox image into its cube map face, in GL face order
+	const unsigned CUBE_FACE_TURNS[6] = { 2, 2, 1, 0, 2, 2 };
+
+	// Decode every file of a texture; a cube map's faces must match
+	bool DecodeTexture(const std::vector<std::string>& file_paths, bool compress, bool cubemap, std::vector<TGAImage>& images)
+	{
+		images.resize(file_paths.size());
+		for (unsigned i = 0; i < file_paths.size(); ++i)
+		{
+			if (!DecodeTGA(file_paths[i].c_str(), images[i], compress, cubemap ? CUBE_FACE_TURNS[i] : 0))
+				return false;
+			if (cubemap && (images[i].width != images[0].width || images[i].height != images[0].width
+				|| images[i].levelCount != images[0].levelCount))
+			{
+				std::cout << file_paths[i] << " does not match the other cube map faces" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Leave one core for the GL thread
+	unsigned LoaderThreadCount()
+	{
+		unsigned cores = std::thread::hardware_concurrency();
+		if (cores <= 2)
+			return 1;
+		return cores - 1 < 4 ? cores - 1 : 4;
+	}
+
+	// State shared by the two halves of a loader job
+	struct MeshJob
+	{
+		MeshData data;
+		bool loaded;
+		double loadTime;
+	};
+
+	struct TextureJob
+	{
+		std::vector<TGAImage> images;
+		bool loaded;
+		double loadTime;
+	};
+}
+
+AssetCache* AssetCache::m_instance = nullptr;
+
+AssetCache::AssetCache(void)
+	: currentBatch(nullptr)
+	, mipmapping(true)
+{
+	stats = Stats();
+	loader.Start(LoaderThreadCount());
+}
+
+AssetCache::~AssetCache(void)
+{
+	Clear();
+}
+
+AssetCache* AssetCache::GetInstance(void)
+{
+	if (m_instance == nullptr)
+	{
+		m_instance = new AssetCache();
+	}
+	return m_instance;
+}
+
+void AssetCache::DestroyInstance(void)
+{
+	if (m_instance)
+	{
+		delete m_instance;
+		m_instance = nullptr;
+	}
+}
+
+Mesh* AssetCache::GenerateAxes(const std::string& meshName, float lengthX, float lengthY, float lengthZ)
+{
+	std::ostringstream key;
+	key << "Axes|" << meshName << '|' << lengthX << '|' << lengthY << '|' << lengthZ;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateAxes(meshName, lengthX, lengthY, lengthZ); });
+}
+
+Mesh* AssetCache::GenerateQuad(const std::string& meshName, glm::vec3 color, float length)
+{
+	std::ostringstream key;
+	key << "Quad|" << meshName << '|' << ColorKey(color) << '|' << length;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateQuad(meshName, color, length); });
+}
+
+Mesh* AssetCache::GenerateSphere(const std::string& meshName, glm::vec3 color, float radius, int numSlice, int numStack)
+{
+	std::ostringstream key;
+	key << "Sphere|" << meshName << '|' << ColorKey(color) << '|' << radius << '|' << numSlice << '|' << numStack;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateSphere(meshName, color, radius, numSlice, numStack); });
+}
+
+Mesh* AssetCache::GenerateCube(const std::string& meshName, glm::vec3 color, float length)
+{
+	std::ostringstream key;
+	key << "Cube|" << meshName << '|' << ColorKey(color) << '|' << length;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateCube(meshName, color, length); });
+}
+
+Mesh* AssetCache::GenerateCylinder(const std::string& meshName, glm::vec3 color, unsigned numSlice, float radius, float height)
+{
+	std::ostringstream key;
+	key << "Cylinder|" << meshName << '|' << ColorKey(color) << '|' << numSlice << '|' << radius << '|' << height;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateCylinder(meshName, color, numSlice, radius, height); });
+}
+
+Mesh* AssetCache::GenerateRectangularPrism(const std::string& meshName, glm::vec3 color, float width, float height, float depth)
+{
+	std::ostringstream key;
+	key << "RectangularPrism|" << meshName << '|' << ColorKey(color) << '|' << width << '|' << height << '|' << depth;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateRectangularPrism(meshName, color, width, height, depth); });
+}
+
+Mesh* AssetCache::GenerateOBJ(const std::string& meshName, const std::string& file_path)
+{
+	std::string key = "OBJ|" + meshName + '|' + file_path;
+	if (!loader.IsRunning())
+		return AcquireMesh(key, [&]() { return MeshBuilder::GenerateOBJ(meshName, file_path); });
+
+	return AcquireMeshAsync(key, meshName,
+		[file_path](MeshData& data) { return MeshBuilder::LoadOBJData(file_path, data); });
+}
+
+Mesh* AssetCache::GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path)
+{
+	std::string key = "OBJMTL|" + meshName + '|' + file_path + '|' + mtl_path;
+	if (!loader.IsRunning())
+		return AcquireMesh(key, [&]() { return MeshBuilder::GenerateOBJMTL(meshName, file_path, mtl_path); });
+
+	return AcquireMeshAsync(key, meshName,
+		[file_path, mtl_path](MeshData& data) { return MeshBuilder::LoadOBJMTLData(file_path, mtl_path, data); });
+}
+
+Mesh* AssetCache::GenerateText(const std::string& meshName, unsigned numRow, unsigned numCol)
+{
+	std::ostringstream key;
+	key << "Text|" << meshName << '|' << numRow << '|' << numCol;
+	return AcquireMesh(key.str(), [&]() { return MeshBuilder::GenerateText(meshName, numRow, numCol); });
+}
+
+/******************************************************************************/
+/*!
+\brief
+Get the texture of a TGA file, loading it only if it is not resident.
+Release it with ReleaseTexture, never with glDeleteTextures.
+With loader threads the texture is empty until Update uploads it, and a file
+that cannot be read becomes a 1x1 white texture.
+
+\param path - path of the TGA file; case, separators and spaces around it do not matter
+\param compress - false to keep the pixels as stored, e.g. for a font
+\return texture name, 0 if the file could not be loaded
+*/
+/******************************************************************************/
+unsigned AssetCache::LoadTGA(const std::string& path, bool compress)
+{
+	std::string file_path = TrimPath(path);
+	return AcquireTexture(TextureKey(file_path, compress), std::vector<std::string>(1, file_path), compress, false);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Get a cube map of six TGA files, loading it only if it is not resident.
+Each face is the image as the old six quad skybox showed it from inside,
+e.g. front is the face seen when looking down -Z. Release it with
+ReleaseTexture. Faces must be square and of one size.
+
+\param right - +X face
+\param left - -X face
+\param top - +Y face
+\param bottom - -Y face
+\param back - +Z face
+\param front - -Z face
+\return texture name, 0 if a file could not be loaded
+*/
+/******************************************************************************/
+unsigned AssetCache::LoadCubemap(const std::string& right, const std::string& left, const std::string& top,
+	const std::string& bottom, const std::string& back, const std::string& front)
+{
+	const std::string* faces[6] = { &right, &left, &top, &bottom, &back, &front };
+	std::vector<std::string> file_paths;
+	std::string key = "Cube";
+	for (const std::string* face : faces)
+	{
+		file_paths.push_back(TrimPath(*face));
+		key += '|' + TextureKey(file_paths.back(), true);
+	}
+	return AcquireTexture(key, file_paths, true, true);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Start or stop the loader threads. Stopping finishes what is still loading.
+
+\param async - true to load OBJ and TGA files on loader threads
+*/
+/******************************************************************************/
+void AssetCache::SetAsync(bool async)
+{
+	if (async)
+		loader.Start(LoaderThreadCount());
+	else
+		loader.Stop();
+}
+
+bool AssetCache::IsAsync(void) const
+{
+	return loader.IsRunning();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Upload what the loader threads have finished; call once per frame
+
+\param budget - seconds this frame may spend on uploads
+*/
+/******************************************************************************/
+void AssetCache::Update(double budget)
+{
+	loader.Update(budget);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Record every mesh and texture requested from now until EndBatch, so
+IsLoading can tell when they are all uploaded. Starting a batch again
+forgets what it held before.
+
+\param batch - any id, such as a SceneManager::SCENE_TYPE
+*/
+/******************************************************************************/
+void AssetCache::BeginBatch(unsigned batch)
+{
+	currentBatch = &batches[batch];
+	currentBatch->meshes.clear();
+	currentBatch->textures.clear();
+}
+
+void AssetCache::EndBatch(void)
+{
+	currentBatch = nullptr;
+}
+
+bool AssetCache::IsLoading(unsigned batch) const
+{
+	return GetLoadProgress(batch) < 1.f;
+}
+
+// Share of the assets of a batch that are uploaded, from 0 to 1
+float AssetCache::GetLoadProgress(unsigned batch) const
+{
+	std::map<unsigned, Batch>::const_iterator it = batches.find(batch);
+	if (it == batches.end())
+		return 1.f;
+
+	const Batch& assets = it->second;
+	size_t total = assets.meshes.size() + assets.textures.size();
+	if (total == 0)
+		return 1.f;
+
+	size_t ready = 0;
+	for (const std::string& key : assets.meshes)
+	{
+		std::map<std::string, MeshEntry>::const_iterator entry = meshes.find(key);
+		if (entry == meshes.end() || entry->second.ready)
+			++ready;
+	}
+	for (const std::string& key : assets.textures)
+	{
+		std::map<std::string, TextureEntry>::const_iterator entry = textures.find(key);
+		if (entry == textures.end() || entry->second.ready)
+			++ready;
+	}
+	return static_cast<float>(ready) / total;
+}
+
+// GPU memory of the uploaded textures of a batch, next to a single level as stored in the files
+Mesh::MemoryStats AssetCache::GetBatchTextureMemory(unsigned batch) const
+{
+	Mesh::MemoryStats memory = { 0, 0 };
+	std::map<unsigned, Batch>::const_iterator it = batches.find(batch);
+	if (it == batches.end())
+		return memory;
+
+	std::set<std::string> counted;
+	for (const std::string& key : it->second.textures)
+	{
+		std::map<std::string, TextureEntry>::const_iterator entry = textures.find(key);
+		if (entry == textures.end() || !entry->second.ready || !counted.insert(key).second)
+			continue;
+		memory.bytes += entry->second.memory.bytes;
+		memory.unpackedBytes += entry->second.memory.unpackedBytes;
+	}
+	return memory;
+}
+
+void AssetCache::SetMipmapping(bool enable)
+{
+	mipmapping = enable;
+	for (std::map<std::string, TextureEntry>::iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		if (it->second.ready)
+		{
+			SetTextureMipmapping(it->second.textureID, it->second.levelCount, enable,
+				it->second.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+bool AssetCache::IsMipmapping(void) const
+{
+	return mipmapping;
+}
+
+// GPU vertex and index memory of the uploaded meshes of a batch
+Mesh::MemoryStats AssetCache::GetBatchMemory(unsigned batch) const
+{
+	Mesh::MemoryStats memory = { 0, 0 };
+	std::map<unsigned, Batch>::const_iterator it = batches.find(batch);
+	if (it == batches.end())
+		return memory;
+
+	std::set<std::string> counted;
+	for (const std::string& key : it->second.meshes)
+	{
+		std::map<std::string, MeshEntry>::const_iterator entry = meshes.find(key);
+		if (entry == meshes.end() || !entry->second.ready || !counted.insert(key).second)
+			continue;
+		Mesh::MemoryStats stats = entry->second.mesh->GetBufferStats();
+		memory.bytes += stats.bytes;
+		memory.unpackedBytes += stats.unpackedBytes;
+	}
+	return memory;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Give back a mesh from one of the Generate functions. The mesh stays resident
+for the next scene that asks for it.
+
+\param mesh - mesh to release, NULL is ignored
+*/
+/******************************************************************************/
+void AssetCache::ReleaseMesh(Mesh* mesh)
+{
+	if (!mesh)
+		return;
+
+	std::map<const Mesh*, std::string>::iterator key = meshKeys.find(mesh);
+	if (key == meshKeys.end())
+	{
+		std::cout << "Mesh " << mesh->name << " does not belong to the asset cache" << std::endl;
+		return;
+	}
+
+	MeshEntry& entry = meshes[key->second];
+	if (entry.refCount > 0)
+		--entry.refCount;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Give back a texture from LoadTGA. The texture stays resident for the next
+scene that asks for it.
+
+\param textureID - texture to release, 0 is ignored
+*/
+/******************************************************************************/
+void AssetCache::ReleaseTexture(unsigned textureID)
+{
+	if (textureID == 0)
+		return;
+
+	std::map<unsigned, std::string>::iterator key = textureKeys.find(textureID);
+	if (key == textureKeys.end())
+	{
+		std::cout << "Texture " << textureID << " does not belong to the asset cache" << std::endl;
+		return;
+	}
+
+	TextureEntry& entry = textures[key->second];
+	if (entry.refCount > 0)
+		--entry.refCount;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Delete every resident mesh and texture; call while the GL context still
+exists and after every scene has exited
+*/
+/******************************************************************************/
+void AssetCache::Clear(void)
+{
+	loader.Cancel();
+	for (std::map<std::string, MeshEntry>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		if (it->second.refCount > 0)
+			std::cout << "Mesh " << it->first << " deleted while still in use" << std::endl;
+		delete it->second.mesh;
+	}
+	for (std::map<std::string, TextureEntry>::iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		if (it->second.refCount > 0)
+			std::cout << "Texture " << it->first << " deleted while still in use" << std::endl;
+		glDeleteTextures(1, &it->second.textureID);
+	}
+	meshes.clear();
+	textures.clear();
+	meshKeys.clear();
+	textureKeys.clear();
+	batches.clear();
+	currentBatch = nullptr;
+}
+
+void AssetCache::ResetStats(void)
+{
+	stats = Stats();
+}
+
+const AssetCache::Stats& AssetCache::GetStats(void) const
+{
+	return stats;
+}
+
+// Pick up a resident mesh, NULL if there is none
+Mesh* AssetCache::FindMesh(const std::string& key)
+{
+	std::map<std::string, MeshEntry>::iterator it = meshes.find(key);
+	if (it == meshes.end())
+		return nullptr;
+
+	if (currentBatch)
+		currentBatch->meshes.push_back(key);
+	MeshEntry& entry = it->second;
+	if (entry.refCount == 0)
+	{
+		// The last scene may have changed the material or texture; start clean
+		entry.mesh->material = entry.material;
+		entry.mesh->textureID = 0;
+	}
+	++entry.refCount;
+	++stats.hits;
+	stats.savedTime += entry.buildTime;
+	return entry.mesh;
+}
+
+void AssetCache::AddMesh(const std::string& key, Mesh* mesh, double buildTime, bool ready)
+{
+	if (currentBatch)
+		currentBatch->meshes.push_back(key);
+
+	MeshEntry entry;
+	entry.mesh = mesh;
+	entry.refCount = 1;
+	entry.buildTime = buildTime;
+	entry.material = mesh->material;
+	entry.ready = ready;
+	meshes[key] = entry;
+	meshKeys[mesh] = key;
+}
+
+void AssetCache::AddTexture(const std::string& key, unsigned textureID, double buildTime, bool ready, bool cubemap)
+{
+	if (currentBatch)
+		currentBatch->textures.push_back(key);
+
+	TextureEntry entry;
+	entry.textureID = textureID;
+	entry.refCount = 1;
+	entry.buildTime = buildTime;
+	entry.ready = ready;
+	entry.cubemap = cubemap;
+	entry.levelCount = 0;
+	entry.memory.bytes = entry.memory.unpackedBytes = 0;
+	textures[key] = entry;
+	textureKeys[textureID] = key;
+}
+
+// Upload decoded images into a texture, note its memory and apply the current mipmapping
+void AssetCache::UploadTexture(const std::string& key, const std::vector<TGAImage>& images)
+{
+	TextureEntry& entry = textures[key];
+	if (entry.cubemap)
+		UploadCubemap(images.data(), entry.textureID);
+	else
+		UploadTGA(images[0], entry.textureID);
+
+	entry.levelCount = images[0].levelCount;
+	entry.memory.bytes = entry.memory.unpackedBytes = 0;
+	for (const TGAImage& image : images)
+	{
+		entry.memory.bytes += image.GetSize();
+		entry.memory.unpackedBytes += static_cast<unsigned long long>(image.width) * image.height * image.bytesPerPixel;
+	}
+	if (!mipmapping)
+		SetTextureMipmapping(entry.textureID, entry.levelCount, false, entry.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D);
+}
+
+// Find a resident texture or decode and upload a new one, on the loader threads if they run
+unsigned AssetCache::AcquireTexture(const std::string& key, const std::vector<std::string>& file_paths,
+	bool compress, bool cubemap)
+{
+	std::map<std::string, TextureEntry>::iterator it = textures.find(key);
+	if (it != textures.end())
+	{
+		if (currentBatch)
+			currentBatch->textures.push_back(key);
+		++it->second.refCount;
+		++stats.hits;
+		stats.savedTime += it->second.buildTime;
+		return it->second.textureID;
+	}
+
+	++stats.misses;
+	GLuint textureID = 0;
+	if (!loader.IsRunning())
+	{
+		timer.startTimer();
+		std::vector<TGAImage> images;
+		if (!DecodeTexture(file_paths, compress, cubemap, images))
+		{
+			stats.loadTime += timer.getElapsedTime();
+			return 0; // not cached, so a fixed file is picked up on the next try
+		}
+		glGenTextures(1, &textureID);
+		AddTexture(key, textureID, 0.0, true, cubemap);
+		UploadTexture(key, images);
+		double buildTime = timer.getElapsedTime();
+
+		stats.loadTime += buildTime;
+		textures[key].buildTime = buildTime;
+		return textureID;
+	}
+
+	glGenTextures(1, &textureID);
+	AddTexture(key, textureID, 0.0, false, cubemap);
+
+	std::shared_ptr<TextureJob> job = std::make_shared<TextureJob>();
+	loader.Submit(
+		[job, file_paths, compress, cubemap]()
+		{
+			StopWatch watch;
+			watch.startTimer();
+			job->loaded = DecodeTexture(file_paths, compress, cubemap, job->images);
+			job->loadTime = watch.getElapsedTime();
+		},
+		[this, job, key]()
+		{
+			if (!job->loaded)
+			{
+				TGAImage white;
+				white.width = white.height = 1;
+				white.bytesPerPixel = 4;
+				white.format = TEXTURE_BGRA;
+				white.levelCount = 1;
+				white.data.assign(4, 255);
+				job->images.assign(job->images.size(), white);
+			}
+			timer.startTimer();
+			UploadTexture(key, job->images);
+			double buildTime = job->loadTime + timer.getElapsedTime();
+			TextureEntry& entry = textures[key];
+			entry.buildTime = buildTime;
+			entry.ready = true;
+			stats.loadTime += buildTime;
+		});
+	return textureID;
+}
+
+// Find a resident mesh or build and time a new one
+Mesh* AssetCache::AcquireMesh(const std::string& key, const std::function<Mesh*()>& build)
+{
+	Mesh* mesh = FindMesh(key);
+	if (mesh)
+		return mesh;
+
+	timer.startTimer();
+	mesh = build();
+	double buildTime = timer.getElapsedTime();
+
+	++stats.misses;
+	stats.loadTime += buildTime;
+	if (!mesh)
+		return nullptr;
+
+	AddMesh(key, mesh, buildTime, true);
+	return mesh;
+}
+
+// Find a resident mesh or return an empty one that a loader job fills in
+Mesh* AssetCache::AcquireMeshAsync(const std::string& key, const std::string& meshName,
+	const std::function<bool(MeshData&)>& load)
+{
+	Mesh* mesh = FindMesh(key);
+	if (mesh)
+		return mesh;
+
+	mesh = new Mesh(meshName);
+	AddMesh(key, mesh, 0.0, false);
+	++stats.misses;
+
+	std::shared_ptr<MeshJob> job = std::make_shared<MeshJob>();
+	loader.Submit(
+		[job, load]()
+		{
+			StopWatch watch;
+			watch.startTimer();
+			job->loaded = load(job->data);
+			job->loadTime = watch.getElapsedTime();
+		},
+		[this, job, key, mesh]()
+		{
+			timer.startTimer();
+			if (job->loaded)
+				MeshBuilder::UploadMeshData(mesh, job->data);
+			else
+				std::cout << "Mesh " << key << " could not be loaded and stays empty" << std::endl;
+			double buildTime = job->loadTime + timer.getElapsedTime();
+			MeshEntry& entry = meshes[key];
+			entry.buildTime = buildTime;
+			entry.ready = true;
+			stats.loadTime += buildTime;
+		});
+	return mesh;
+}
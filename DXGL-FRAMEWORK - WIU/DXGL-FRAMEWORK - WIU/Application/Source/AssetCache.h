@@ -0,0 +1,138 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshBuilder.h"
+#include "AsyncLoader.h"
+#include "timer.h"
+
+struct TGAImage;
+
+/******************************************************************************/
+/*!
+		Class AssetCache:
+\brief	Meshes and textures shared by every scene. Each asset is keyed by its
+		generator and parameters, or by its file path, and counts the scenes
+		holding it. An asset nobody holds stays resident until Clear, so a
+		scene switch back to a scene reuses what it built last time.
+		OBJ and TGA files are read on loader threads: the handle is
+		returned right away and filled in by Update, so check IsLoading
+		on the batch it was requested in before drawing with it.
+*/
+/******************************************************************************/
+class AssetCache
+{
+public:
+	struct Stats
+	{
+		unsigned hits;
+		unsigned misses;
+		double loadTime;  // seconds spent building the misses
+		double savedTime; // seconds the hits took to build the first time
+	};
+
+	static AssetCache* GetInstance(void);
+	static void DestroyInstance(void);
+
+	// Same parameters as MeshBuilder; the mesh is only built on a miss
+	Mesh* GenerateAxes(const std::string& meshName, float lengthX, float lengthY, float lengthZ);
+	Mesh* GenerateQuad(const std::string& meshName, glm::vec3 color, float length = 1.f);
+	Mesh* GenerateSphere(const std::string& meshName, glm::vec3 color, float radius = 1.f, int numSlice = 360, int numStack = 360);
+	Mesh* GenerateCube(const std::string& meshName, glm::vec3 color, float length);
+	Mesh* GenerateCylinder(const std::string& meshName, glm::vec3 color, unsigned numSlice, float radius, float height);
+	Mesh* GenerateRectangularPrism(const std::string& meshName, glm::vec3 color, float width, float height, float depth);
+	Mesh* GenerateOBJ(const std::string& meshName, const std::string& file_path);
+	Mesh* GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path);
+	Mesh* GenerateText(const std::string& meshName, unsigned numRow, unsigned numCol);
+	unsigned LoadTGA(const std::string& file_path, bool compress = true);
+	unsigned LoadCubemap(const std::string& right, const std::string& left, const std::string& top,
+		const std::string& bottom, const std::string& back, const std::string& front);
+
+	// Loader threads; without them every asset is loaded inside the call
+	void SetAsync(bool async);
+	bool IsAsync(void) const;
+	void Update(double budget);
+
+	// Group the assets requested until EndBatch, e.g. everything one scene loads
+	void BeginBatch(unsigned batch);
+	void EndBatch(void);
+	bool IsLoading(unsigned batch) const;
+	float GetLoadProgress(unsigned batch) const;
+	Mesh::MemoryStats GetBatchMemory(unsigned batch) const;
+	Mesh::MemoryStats GetBatchTextureMemory(unsigned batch) const;
+
+	// Sample every texture from its mip chain, or from the top level only
+	void SetMipmapping(bool enable);
+	bool IsMipmapping(void) const;
+
+	void ReleaseMesh(Mesh* mesh);
+	void ReleaseTexture(unsigned textureID);
+	void Clear(void);
+
+	// Counters since the last ResetStats, e.g. for one scene switch
+	void ResetStats(void);
+	const Stats& GetStats(void) const;
+
+private:
+	AssetCache(void);
+	~AssetCache(void);
+
+	struct MeshEntry
+	{
+		Mesh* mesh;
+		unsigned refCount;
+		double buildTime;
+		Material material; // restored when a resident mesh is picked up again
+		bool ready;        // false while a loader job fills it in
+	};
+
+	struct TextureEntry
+	{
+		unsigned textureID;
+		unsigned refCount;
+		double buildTime;
+		bool ready;
+		bool cubemap;
+		unsigned levelCount;
+		Mesh::MemoryStats memory; // unpackedBytes is the top level as stored in the file
+	};
+
+	struct Batch
+	{
+		std::vector<std::string> meshes;
+		std::vector<std::string> textures;
+	};
+
+	Mesh* FindMesh(const std::string& key);
+	void AddMesh(const std::string& key, Mesh* mesh, double buildTime, bool ready);
+	void AddTexture(const std::string& key, unsigned textureID, double buildTime, bool ready, bool cubemap);
+	void UploadTexture(const std::string& key, const std::vector<TGAImage>& images);
+	unsigned AcquireTexture(const std::string& key, const std::vector<std::string>& file_paths,
+		bool compress, bool cubemap);
+	Mesh* AcquireMesh(const std::string& key, const std::function<Mesh*()>& build);
+	Mesh* AcquireMeshAsync(const std::string& key, const std::string& meshName,
+		const std::function<bool(MeshData&)>& load);
+
+	static AssetCache* m_instance;
+
+	std::map<std::string, MeshEntry> meshes;
+	std::map<std::string, TextureEntry> textures;
+	std::map<const Mesh*, std::string> meshKeys;
+	std::map<unsigned, std::string> textureKeys;
+	std::map<unsigned, Batch> batches;
+	Batch* currentBatch;
+	bool mipmapping;
+	Stats stats;
+	StopWatch timer;
+	AsyncLoader loader;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "AsyncLoader.h"
+
+AsyncLoader::AsyncLoader()
+	: running(0)
+	, pending(0)
+	, stopping(false)
+{
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	Stop();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Start the worker threads
+
+\param numThreads - number of workers, 0 to run every job inside Submit
+*/
+/******************************************************************************/
+void AsyncLoader::Start(unsigned numThreads)
+{
+	if (!workers.empty())
+		return;
+
+	stopping = false;
+	for (unsigned i = 0; i < numThreads; ++i)
+		workers.push_back(std::thread(&AsyncLoader::WorkerLoop, this));
+}
+
+/******************************************************************************/
+/*!
+\brief
+Finish every submitted job, then join the workers; GL thread only
+*/
+/******************************************************************************/
+void AsyncLoader::Stop()
+{
+	if (workers.empty())
+		return;
+
+	Finish();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+bool AsyncLoader::IsRunning() const
+{
+	return !workers.empty();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a job. Without workers it is run right away on the calling thread.
+
+\param work - part that runs on a worker thread, must not touch GL
+\param upload - part that runs on the GL thread after work
+*/
+/******************************************************************************/
+void AsyncLoader::Submit(const std::function<void()>& work, const std::function<void()>& upload)
+{
+	if (workers.empty())
+	{
+		work();
+		upload();
+		return;
+	}
+
+	Job job;
+	job.work = work;
+	job.upload = upload;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(job);
+		++pending;
+	}
+	wake.notify_one();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Run the uploads of finished jobs until the budget is used up; call once per
+frame on the GL thread. At least one upload runs, so a single upload larger
+than the budget still gets through.
+
+\param budget - seconds this frame may spend on uploads
+
+\return number of jobs uploaded
+*/
+/******************************************************************************/
+unsigned AsyncLoader::Update(double budget)
+{
+	unsigned uploaded = 0;
+	double elapsed = 0.0;
+	timer.startTimer();
+	while (elapsed < budget)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (finished.empty())
+				break;
+			job = finished.front();
+			finished.pop_front();
+		}
+
+		job.upload();
+		++uploaded;
+		elapsed += timer.getElapsedTime();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		--pending;
+	}
+	return uploaded;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Complete every submitted job now, helping the workers with the queued ones;
+GL thread only
+*/
+/******************************************************************************/
+void AsyncLoader::Finish()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!queued.empty())
+	{
+		Job job = queued.front();
+		queued.pop_front();
+		lock.unlock();
+		job.work();
+		lock.lock();
+		finished.push_back(job);
+	}
+	WaitIdle(lock);
+
+	std::deque<Job> uploads;
+	uploads.swap(finished);
+	pending -= static_cast<unsigned>(uploads.size());
+	lock.unlock();
+
+	for (Job& job : uploads)
+		job.upload();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Drop every job that has not been uploaded yet. Waits for the jobs a worker
+is busy with, so nothing they point to is used after this returns.
+*/
+/******************************************************************************/
+void AsyncLoader::Cancel()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	queued.clear();
+	WaitIdle(lock);
+	finished.clear();
+	pending = 0;
+}
+
+unsigned AsyncLoader::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
+
+void AsyncLoader::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+		if (stopping)
+			return;
+
+		Job job = queued.front();
+		queued.pop_front();
+		++running;
+		lock.unlock();
+
+		job.work();
+
+		lock.lock();
+		finished.push_back(job);
+		--running;
+		if (running == 0)
+			idle.notify_all();
+	}
+}
+
+// Wait until no worker is inside a job; lock must hold mutex
+void AsyncLoader::WaitIdle(std::unique_lock<std::mutex>& lock)
+{
+	idle.wait(lock, [this]() { return running == 0; });
+}
@@ -0,0 +1,61 @@
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "timer.h"
+
+/******************************************************************************/
+/*!
+		Class AsyncLoader:
+\brief	Thread pool for asset loading. Each job has a work part that runs on
+		a worker thread and must not touch GL, and an upload part that runs
+		on the GL thread in Update, within a time budget per frame. When no
+		workers are started, jobs run right away in Submit.
+*/
+/******************************************************************************/
+class AsyncLoader
+{
+public:
+	AsyncLoader();
+	~AsyncLoader();
+
+	void Start(unsigned numThreads);
+	void Stop();
+	bool IsRunning() const;
+
+	void Submit(const std::function<void()>& work, const std::function<void()>& upload);
+	unsigned Update(double budget);
+	void Finish();
+	void Cancel();
+
+	unsigned GetPendingCount() const;
+
+private:
+	struct Job
+	{
+		std::function<void()> work;
+		std::function<void()> upload;
+	};
+
+	void WorkerLoop();
+	void WaitIdle(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> workers;
+	std::deque<Job> queued;   // waiting for a worker
+	std::deque<Job> finished; // work done, waiting for Update
+	mutable std::mutex mutex;
+	std::condition_variable wake; // signals workers
+	std::condition_variable idle; // signals WaitIdle
+	unsigned running;             // jobs a worker is busy with
+	unsigned pending;             // submitted and not uploaded yet
+	bool stopping;
+	StopWatch timer;
+};
+
+#endif
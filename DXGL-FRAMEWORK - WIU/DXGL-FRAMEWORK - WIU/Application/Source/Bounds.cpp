@@ -0,0 +1,154 @@
+#include "Bounds.h"
+
+#include <cmath>
+
+namespace
+{
+	inline const glm::vec3& PositionAt(const void* positions, unsigned stride, unsigned index)
+	{
+		return *reinterpret_cast<const glm::vec3*>(static_cast<const unsigned char*>(positions) + index * stride);
+	}
+
+	// Box of the positions, then the sphere around its centre that holds them all
+	template <typename INDEX>
+	Bounds ComputeBounds(const void* positions, unsigned stride, unsigned count, INDEX index)
+	{
+		Bounds bounds;
+		if (count == 0)
+			return bounds;
+
+		bounds.min = bounds.max = PositionAt(positions, stride, index(0));
+		for (unsigned i = 1; i < count; ++i)
+		{
+			const glm::vec3& position = PositionAt(positions, stride, index(i));
+			bounds.min = glm::min(bounds.min, position);
+			bounds.max = glm::max(bounds.max, position);
+		}
+
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		float radiusSquared = 0.f;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			glm::vec3 offset = PositionAt(positions, stride, index(i)) - bounds.center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+		}
+		bounds.radius = std::sqrt(radiusSquared);
+		return bounds;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Bounds of a vertex array
+
+\param positions - position of the first vertex, 3 floats
+\param count - number of vertices
+\param stride - bytes from one position to the next
+\return bounds, invalid if count is 0
+*/
+/******************************************************************************/
+Bounds Bounds::Compute(const void* positions, unsigned count, unsigned stride)
+{
+	return ComputeBounds(positions, stride, count, [](unsigned i) { return i; });
+}
+
+/******************************************************************************/
+/*!
+\brief
+Bounds of the vertices an index range draws, e.g. one material of a mesh
+
+\param positions - position of the first vertex, 3 floats
+\param stride - bytes from one position to the next
+\param indices - first index of the range
+\param count - number of indices
+\return bounds, invalid if count is 0
+*/
+/******************************************************************************/
+Bounds Bounds::Compute(const void* positions, unsigned stride, const unsigned* indices, unsigned count)
+{
+	return ComputeBounds(positions, stride, count, [indices](unsigned i) { return indices[i]; });
+}
+
+// Radius of the sphere once model has scaled it by its largest axis
+float Bounds::GetWorldRadius(const glm::mat4& model) const
+{
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	return radius * scale;
+}
+
+Frustum::Frustum()
+{
+	for (unsigned i = 0; i < 6; ++i)
+		planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Extract the planes of a view-projection matrix: a point is inside when
+row 3 +/- row n of the matrix gives a positive distance for every axis n
+
+\param viewProjection - projection * view
+*/
+/******************************************************************************/
+void Frustum::Set(const glm::mat4& viewProjection)
+{
+	// glm stores columns, so row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++r)
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		planes[axis * 2] = rows[3] + rows[axis];
+		planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+	for (unsigned i = 0; i < 6; ++i)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.f)
+			planes[i] /= length;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Whether bounds placed by model may be seen. The sphere settles most objects,
+which are either well inside or well outside; the ones it leaves on a plane
+are tested with the box, turned and scaled into the world.
+
+\param bounds - model space bounds
+\param model - world matrix
+\return false only if the bounds are completely outside a plane
+*/
+/******************************************************************************/
+bool Frustum::IsVisible(const Bounds& bounds, const glm::mat4& model) const
+{
+	if (!bounds.IsValid())
+		return true;
+
+	glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.f));
+	glm::vec3 axes[3] = { glm::vec3(model[0]), glm::vec3(model[1]), glm::vec3(model[2]) };
+	float radius = bounds.GetWorldRadius(model);
+	glm::vec3 halfSize = (bounds.max - bounds.min) * 0.5f;
+
+	for (unsigned i = 0; i < 6; ++i)
+	{
+		glm::vec3 normal = glm::vec3(planes[i]);
+		float distance = glm::dot(normal, center) + planes[i].w;
+		if (distance < -radius)
+			return false;
+		if (distance < radius)
+		{
+			// Half the box's extent along the plane normal
+			float extent = halfSize.x * std::fabs(glm::dot(normal, axes[0]))
+				+ halfSize.y * std::fabs(glm::dot(normal, axes[1]))
+				+ halfSize.z * std::fabs(glm::dot(normal, axes[2]));
+			if (distance < -extent)
+				return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+/******************************************************************************/
+/*!
+		Struct Bounds:
+\brief	Axis aligned box and bounding sphere of some vertices in model
+		space. The sphere is centred on the box, so it is never looser than
+		the box's corners. A negative radius means the bounds are unknown
+		and the owner is never culled.
+*/
+/******************************************************************************/
+struct Bounds
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 center;
+	float radius;
+
+	Bounds() : min(0.f), max(0.f), center(0.f), radius(-1.f) {}
+	bool IsValid() const { return radius >= 0.f; }
+	float GetWorldRadius(const glm::mat4& model) const;
+
+	// Bounds of positions, each stride bytes after the last
+	static Bounds Compute(const void* positions, unsigned count, unsigned stride);
+	// Bounds of the vertices the indices name
+	static Bounds Compute(const void* positions, unsigned stride, const unsigned* indices, unsigned count);
+};
+
+/******************************************************************************/
+/*!
+		Class Frustum:
+\brief	The six planes of a view-projection matrix, pointing inwards, to
+		test model space bounds placed in the world against
+*/
+/******************************************************************************/
+class Frustum
+{
+public:
+	Frustum();
+
+	void Set(const glm::mat4& viewProjection);
+	bool IsVisible(const Bounds& bounds, const glm::mat4& model) const;
+
+private:
+	glm::vec4 planes[6];
+};
+
+#endif
@@ -0,0 +1,373 @@
+#include "DynamicResolution.h"
+#include "GL\glew.h"
+
+#include "ShaderCache.h"
+#include "UniformCache.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	const float MIN_SCALE = 0.5f;
+	const float MAX_SCALE = 1.f;
+
+	// GPU time to aim for, under 1/60 s to leave room for the CPU and for spikes
+	const double TARGET_TIME = 0.85 / 60.0;
+	// Grow only well under the target, so the scale does not flip back and forth
+	const double RAISE_TIME = TARGET_TIME * 0.8;
+	// Frames averaged per decision; the measurement itself is a frame or two old
+	const unsigned ADJUST_FRAMES = 8;
+	// Largest change per decision: drop fast, recover slowly
+	const float MAX_DROP = 0.8f;
+	const float MAX_RAISE = 1.05f;
+
+	const char* AA_NAMES[DynamicResolution::AA_TOTAL] = { "none", "msaa", "fxaa" };
+}
+
+// Name of an anti-aliasing mode, as given to --aa=
+const char* DynamicResolution::GetName(ANTI_ALIASING antiAliasing)
+{
+	return antiAliasing < AA_TOTAL ? AA_NAMES[antiAliasing] : "";
+}
+
+DynamicResolution::DynamicResolution()
+	: enabled(true)
+	, active(false)
+	, antiAliasing(AA_MSAA)
+	, scale(MAX_SCALE)
+	, timeSum(0.0)
+	, timeCount(0)
+	, targetWidth(0)
+	, targetHeight(0)
+	, width(0)
+	, height(0)
+	, samples(0)
+	, sceneFBO(0)
+	, colorBuffer(0)
+	, depthBuffer(0)
+	, resolveFBO(0)
+	, sceneTexture(0)
+	, programID(0)
+	, sceneRectLocation(-1)
+	, fxaaProgramID(0)
+	, fxaaSceneRectLocation(-1)
+	, vertexArray(0)
+{
+	std::fill(window, window + 4, 0);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Build the upscale programs; call once after the GL context exists. The targets
+are made by the first Begin, once the window size is known.
+*/
+/******************************************************************************/
+void DynamicResolution::Init()
+{
+	ShaderCache* shaders = ShaderCache::GetInstance();
+	programID = shaders->Load("Shader//Upscale.vertexshader", "Shader//Upscale.fragmentshader");
+	fxaaProgramID = shaders->Load("Shader//Upscale.vertexshader", "Shader//Upscale.fragmentshader", "#define FXAA\n");
+	shaders->Finish();
+
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(programID);
+	uniforms->Uniform1i(glGetUniformLocation(programID, "scene"), 0);
+	sceneRectLocation = glGetUniformLocation(programID, "sceneRect");
+	uniforms->UseProgram(fxaaProgramID);
+	uniforms->Uniform1i(glGetUniformLocation(fxaaProgramID, "scene"), 0);
+	fxaaSceneRectLocation = glGetUniformLocation(fxaaProgramID, "sceneRect");
+	glGenVertexArrays(1, &vertexArray);
+}
+
+void DynamicResolution::Exit()
+{
+	DeleteTargets();
+	targetWidth = targetHeight = 0;
+	glDeleteVertexArrays(1, &vertexArray);
+	vertexArray = 0;
+	ShaderCache::GetInstance()->Release(programID);
+	ShaderCache::GetInstance()->Release(fxaaProgramID);
+	programID = fxaaProgramID = 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Turn the scaling on or off; off, the scene is drawn at window size, and
+straight to the window unless the anti-aliasing needs the target. Either way
+the scale starts again from the window size.
+*/
+/******************************************************************************/
+void DynamicResolution::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+	scale = MAX_SCALE;
+	timeSum = 0.0;
+	timeCount = 0;
+}
+
+bool DynamicResolution::IsEnabled() const
+{
+	return enabled;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Pick how the scene is anti-aliased; the target is made again by the next Begin
+
+\param antiAliasing - AA_MSAA for a multisampled target, AA_FXAA for the
+	post-process pass, AA_NONE for neither
+*/
+/******************************************************************************/
+void DynamicResolution::SetAntiAliasing(ANTI_ALIASING antiAliasing)
+{
+	if (antiAliasing >= AA_TOTAL || antiAliasing == this->antiAliasing)
+		return;
+	this->antiAliasing = antiAliasing;
+	DeleteTargets();
+	targetWidth = targetHeight = 0;
+}
+
+DynamicResolution::ANTI_ALIASING DynamicResolution::GetAntiAliasing() const
+{
+	return antiAliasing;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Point the following draws at the target, with a viewport of the current
+scale. Does nothing when neither the scaling nor the anti-aliasing is on, for
+a minimized window or if the target could not be made, so the scene draws to
+the window instead.
+*/
+/******************************************************************************/
+void DynamicResolution::Begin()
+{
+	if ((!enabled && antiAliasing == AA_NONE) || active || programID == 0)
+		return;
+
+	glGetIntegerv(GL_VIEWPORT, window);
+	if (window[2] <= 0 || window[3] <= 0)
+		return;
+	if (window[2] != targetWidth || window[3] != targetHeight)
+		CreateTargets(window[2], window[3]);
+	if (sceneFBO == 0)
+		return;
+
+	width = std::max(1, static_cast<int>(targetWidth * scale + 0.5f));
+	height = std::max(1, static_cast<int>(targetHeight * scale + 0.5f));
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glViewport(0, 0, width, height);
+	active = true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Resolve the target and stretch it over the window, then leave the window
+bound with its own viewport. Does nothing unless Begin bound the target.
+*/
+/******************************************************************************/
+void DynamicResolution::Present()
+{
+	if (!active)
+		return;
+	active = false;
+
+	if (resolveFBO)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(window[0], window[1], window[2], window[3]);
+
+	// Every window pixel is written, so neither depth nor the old color matter
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	bool fxaa = antiAliasing == AA_FXAA && fxaaProgramID != 0;
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(fxaa ? fxaaProgramID : programID);
+	const float sceneRect[4] = {
+		static_cast<float>(width) / targetWidth,
+		static_cast<float>(height) / targetHeight,
+		(width - 0.5f) / targetWidth,
+		(height - 0.5f) / targetHeight,
+	};
+	uniforms->Uniform4fv(fxaa ? fxaaSceneRectLocation : sceneRectLocation, sceneRect);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sceneTexture);
+	Mesh::BindVertexArray(vertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+}
+
+bool DynamicResolution::IsActive() const
+{
+	return active;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Feed one GPU time measurement. Every ADJUST_FRAMES measurements the scale
+moves towards the one whose time would hit TARGET_TIME, assuming the time
+goes with the number of pixels drawn, i.e. with the square of the scale.
+
+\param gpuTime - GPU seconds of a frame drawn with the target
+*/
+/******************************************************************************/
+void DynamicResolution::Update(double gpuTime)
+{
+	if (!enabled || gpuTime <= 0.0)
+		return;
+	timeSum += gpuTime;
+	if (++timeCount < ADJUST_FRAMES)
+		return;
+
+	double average = timeSum / timeCount;
+	timeSum = 0.0;
+	timeCount = 0;
+	if (average > TARGET_TIME)
+		scale *= std::max(static_cast<float>(std::sqrt(TARGET_TIME / average)), MAX_DROP);
+	else if (average < RAISE_TIME)
+		scale *= std::min(static_cast<float>(std::sqrt(TARGET_TIME / average)), MAX_RAISE);
+	scale = std::min(std::max(scale, MIN_SCALE), MAX_SCALE);
+}
+
+// Share of the window's width and height the scene is drawn at
+float DynamicResolution::GetScale() const
+{
+	return scale;
+}
+
+// Size the scene was last drawn at, in pixels
+int DynamicResolution::GetWidth() const
+{
+	return width;
+}
+
+int DynamicResolution::GetHeight() const
+{
+	return height;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Video memory of the target: the color and depth samples, plus the single
+sample texture the upscale pass reads
+
+\return bytes, 0 while there is no target
+*/
+/******************************************************************************/
+unsigned long long DynamicResolution::GetTargetMemory() const
+{
+	if (sceneFBO == 0)
+		return 0;
+	// RGBA8 and DEPTH24_STENCIL8 are 4 bytes each
+	unsigned long long bytesPerPixel = samples > 0 ? samples * 8ull + 4ull : 8ull;
+	return bytesPerPixel * targetWidth * targetHeight;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Make the target at window size, multisampled for AA_MSAA. On failure the
+target stays empty and Begin leaves the scene on the window.
+
+\param width - window width in pixels
+\param height - window height in pixels
+*/
+/******************************************************************************/
+void DynamicResolution::CreateTargets(int width, int height)
+{
+	DeleteTargets();
+	targetWidth = width;
+	targetHeight = height;
+
+	samples = 0;
+	if (antiAliasing == AA_MSAA)
+	{
+		GLint maxSamples = 0;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		samples = maxSamples < MSAA_SAMPLES ? maxSamples : MSAA_SAMPLES;
+	}
+
+	glGenTextures(1, &sceneTexture);
+	glBindTexture(GL_TEXTURE_2D, sceneTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+
+	glGenFramebuffers(1, &sceneFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	if (samples > 0)
+	{
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	}
+	else
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	if (complete && samples > 0)
+	{
+		glGenFramebuffers(1, &resolveFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete)
+	{
+		printf("Dynamic resolution target %dx%d (%d samples) is incomplete, drawing to the window\n",
+			width, height, samples);
+		DeleteTargets();
+	}
+}
+
+// Keeps targetWidth and targetHeight, so a failed size is not retried every frame
+void DynamicResolution::DeleteTargets()
+{
+	if (active)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(window[0], window[1], window[2], window[3]);
+		active = false;
+	}
+	glDeleteFramebuffers(1, &sceneFBO);
+	glDeleteFramebuffers(1, &resolveFBO);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteTextures(1, &sceneTexture);
+	sceneFBO = resolveFBO = colorBuffer = depthBuffer = sceneTexture = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+/******************************************************************************/
+/*!
+		Class DynamicResolution:
+\brief	Offscreen target the scenes draw into at a share of the window's
+		resolution, then stretched over the window with a bilinear pass.
+		The share follows the GPU time SceneManager measures: it drops as
+		soon as a frame runs over the 60 Hz budget and creeps back up
+		while there is room, between MIN_SCALE and the full window size.
+
+		The target is allocated at window size and only its bottom left
+		corner is drawn, so changing the share never reallocates.
+		Everything drawn between Begin and Present goes to the target;
+		Present resolves it and draws it to the window, where the screen
+		UI then goes at full resolution.
+
+		The target also does the scene's anti-aliasing, so the window
+		itself is single sample: AA_MSAA gives the target MSAA_SAMPLES
+		samples, AA_FXAA draws it single sample and runs FXAA in the
+		upscale pass instead.
+*/
+/******************************************************************************/
+class DynamicResolution
+{
+public:
+	enum ANTI_ALIASING
+	{
+		AA_NONE = 0,
+		AA_MSAA,
+		AA_FXAA,
+
+		AA_TOTAL,
+	};
+
+	static const int MSAA_SAMPLES = 4;
+
+	static const char* GetName(ANTI_ALIASING antiAliasing);
+
+	DynamicResolution();
+	~DynamicResolution();
+
+	void Init();
+	void Exit();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const;
+	void SetAntiAliasing(ANTI_ALIASING antiAliasing);
+	ANTI_ALIASING GetAntiAliasing() const;
+
+	void Begin();
+	void Present();
+	bool IsActive() const;
+
+	void Update(double gpuTime);
+	float GetScale() const;
+	int GetWidth() const;
+	int GetHeight() const;
+	unsigned long long GetTargetMemory() const;
+
+private:
+	void CreateTargets(int width, int height);
+	void DeleteTargets();
+
+	bool enabled;      // scale with the GPU time, else draw at window size
+	bool active;       // between Begin and Present
+	ANTI_ALIASING antiAliasing;
+	float scale;       // of the window's width and height
+	double timeSum;    // GPU seconds since the last change of scale
+	unsigned timeCount;
+
+	int window[4];     // viewport of the default framebuffer, restored by Present
+	int targetWidth, targetHeight; // allocated size, the window's when Begin last ran
+	int width, height; // drawn part of the target
+	int samples;       // of the target, 0 unless AA_MSAA
+
+	unsigned sceneFBO;      // drawn by the scene
+	unsigned colorBuffer;   // multisampled color of sceneFBO, 0 without samples
+	unsigned depthBuffer;
+	unsigned resolveFBO;    // single sample copy of sceneFBO, 0 without samples
+	unsigned sceneTexture;  // read by the upscale pass
+
+	unsigned programID;     // plain bilinear upscale
+	int sceneRectLocation;
+	unsigned fxaaProgramID; // FXAA and upscale in one pass
+	int fxaaSceneRectLocation;
+	unsigned vertexArray;   // empty, the pass makes its corners from gl_VertexID
+};
+
+#endif
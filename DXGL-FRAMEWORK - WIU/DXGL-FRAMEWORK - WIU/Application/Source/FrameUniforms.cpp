@@ -0,0 +1,143 @@
+#include "FrameUniforms.h"
+#include "GL\glew.h"
+
+FrameUniforms::FrameUniforms()
+	: lights(nullptr)
+	, lightCount(0)
+	, uniformBuffer(0)
+{
+	data = FrameData();
+	data.clusterGrid = glm::ivec4(1, 1, 1, 0);
+}
+
+FrameUniforms::~FrameUniforms()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Create the uniform buffer and attach it to BINDING_POINT
+*/
+/******************************************************************************/
+void FrameUniforms::Init()
+{
+	if (uniformBuffer == 0)
+		glGenBuffers(1, &uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, uniformBuffer);
+}
+
+void FrameUniforms::Exit()
+{
+	if (uniformBuffer > 0)
+		glDeleteBuffers(1, &uniformBuffer);
+	uniformBuffer = 0;
+	lights = nullptr;
+	lightCount = 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Point a program's FrameData block at BINDING_POINT
+
+\param programID - program built from shaders declaring the block
+\return false if the program has no FrameData block, e.g. a shader variant
+	that reads nothing from it, which the compiler then drops
+*/
+/******************************************************************************/
+bool FrameUniforms::BindProgram(unsigned programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, "FrameData");
+	if (blockIndex == GL_INVALID_INDEX)
+		return false;
+	glUniformBlockBinding(programID, blockIndex, BINDING_POINT);
+	return true;
+}
+
+void FrameUniforms::SetCamera(const glm::mat4& view, const glm::mat4& projection)
+{
+	data.view = view;
+	data.projection = projection;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Use a scene's lights for the following frames. Only the pointer is kept;
+the lights are read and moved to camera space in Upload.
+
+\param lights - array of lights, must outlive this object or the next call
+\param count - number of lights, clamped to MAX_LIGHTS
+*/
+/******************************************************************************/
+void FrameUniforms::SetLights(const Light* lights, unsigned count)
+{
+	this->lights = lights;
+	lightCount = count < MAX_LIGHTS ? count : MAX_LIGHTS;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Tell the shaders how to find a fragment's light cluster
+
+\param scale - from LightClusters::GetScale
+\param grid - tiles in x and y and slices; w is 1 to shade with the clustered
+lights instead of the block's own
+*/
+/******************************************************************************/
+void FrameUniforms::SetClusters(const glm::vec4& scale, const glm::ivec4& grid)
+{
+	data.clusterScale = scale;
+	data.clusterGrid = grid;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Move the lights into camera space and upload the whole block; call once per
+frame after SetCamera
+*/
+/******************************************************************************/
+void FrameUniforms::Upload()
+{
+	for (unsigned i = 0; i < lightCount; ++i)
+		PackLight(lights[i], data.view, data.lights[i]);
+	data.numLights = lightCount;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Convert a light to the layout the shaders read, in camera space
+
+\param light - light in world space
+\param view - camera view matrix
+\param out - receives the light
+*/
+/******************************************************************************/
+void FrameUniforms::PackLight(const Light& light, const glm::mat4& view, LightData& out)
+{
+	// Directional lights store a direction in position
+	float w = light.type == Light::LIGHT_DIRECTIONAL ? 0.f : 1.f;
+	out.position_cameraspace = glm::vec3(view * glm::vec4(light.position, w));
+	out.type = light.type;
+	out.color = light.color;
+	out.power = light.power;
+	out.spotDirection = glm::vec3(view * glm::vec4(light.spotDirection, 0.f));
+	out.cosCutoff = cosf(glm::radians<float>(light.cosCutoff));
+	out.kC = light.kC;
+	out.kL = light.kL;
+	out.kQ = light.kQ;
+	out.cosInner = cosf(glm::radians<float>(light.cosInner));
+	out.exponent = light.exponent;
+	out.padding[0] = out.padding[1] = out.padding[2] = 0.f;
+}
@@ -0,0 +1,77 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include "Light.h"
+
+/******************************************************************************/
+/*!
+		Class FrameUniforms:
+\brief	Uniform buffer holding the data that is the same for every draw of a
+		frame: camera matrices, the first MAX_LIGHTS lights and the light
+		cluster grid. Mirrors the std140 FrameData block of
+		Texture.vertexshader and Text.fragmentshader and is uploaded once
+		per frame.
+*/
+/******************************************************************************/
+class FrameUniforms
+{
+public:
+	// Must match MAX_LIGHTS in the shaders
+	static const unsigned MAX_LIGHTS = 8;
+	static const unsigned BINDING_POINT = 0;
+
+	FrameUniforms();
+	~FrameUniforms();
+
+	void Init();
+	void Exit();
+	bool BindProgram(unsigned programID);
+
+	void SetCamera(const glm::mat4& view, const glm::mat4& projection);
+	void SetLights(const Light* lights, unsigned count);
+	void SetClusters(const glm::vec4& scale, const glm::ivec4& grid);
+	void Upload();
+
+	// std140 layout of struct Light; vec3s are padded by the scalar after them.
+	// LightClusters stores the same 5 vec4s per light in a buffer texture.
+	struct LightData
+	{
+		glm::vec3 position_cameraspace;
+		int type;
+		glm::vec3 color;
+		float power;
+		glm::vec3 spotDirection;
+		float cosCutoff;
+		float kC, kL, kQ;
+		float cosInner;
+		float exponent;
+		float padding[3];
+	};
+
+	static void PackLight(const Light& light, const glm::mat4& view, LightData& out);
+
+private:
+	struct FrameData
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		LightData lights[MAX_LIGHTS];
+		int numLights;
+		int padding[3];
+		glm::vec4 clusterScale; // see LightClusters::GetScale
+		glm::ivec4 clusterGrid; // tiles in x and y, slices, 1 when the lights are clustered
+	};
+
+	static_assert(sizeof(LightData) == 80, "LightData must match the std140 layout of Light");
+	static_assert(sizeof(FrameData) == 816, "FrameData must match the std140 layout of the FrameData block");
+
+	FrameData data;
+	const Light* lights;
+	unsigned lightCount;
+	unsigned uniformBuffer;
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include "LightBaker.h"
+#include "MeshBuilder.h"
+#include "MeshBin.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+namespace
+{
+	const unsigned DEFAULT_AO_RAYS = 32;
+	const float DEFAULT_AO_DISTANCE = 2.f;
+	const unsigned VERTICES_PER_CHUNK = 256;
+	// Rays start this far off the surface so they do not hit it
+	const float RAY_OFFSET = 1e-3f;
+	const float GOLDEN_ANGLE = 2.39996323f;
+
+	const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+	const unsigned long long FNV_PRIME = 1099511628211ULL;
+	// Bump when the bake itself changes, so old .meshbin files are baked again
+	const unsigned BAKE_VERSION = 1;
+
+	template <typename T>
+	unsigned long long HashValue(unsigned long long hash, const T& value)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	// Run job(i) for i in [0, count) on count threads, the last on this one
+	template <typename Job>
+	void ParallelFor(unsigned count, Job job)
+	{
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i + 1 < count; ++i)
+			threads.push_back(std::thread(job, i));
+		if (count > 0)
+			job(count - 1);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
+
+LightBaker::Stats LightBaker::lastBake = { 0, 0, 0, 0.0 };
+
+LightBaker::LightBaker()
+	: aoDistance(DEFAULT_AO_DISTANCE)
+	, stats()
+{
+	SetAmbientOcclusion(DEFAULT_AO_RAYS, DEFAULT_AO_DISTANCE);
+}
+
+LightBaker::~LightBaker()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set how ambient occlusion is sampled
+
+\param rays - rays per vertex, 0 to leave the ambient term unoccluded
+\param distance - occluders further away than this do not darken a vertex
+*/
+/******************************************************************************/
+void LightBaker::SetAmbientOcclusion(unsigned rays, float distance)
+{
+	// A spiral over the unit disc lifted onto the hemisphere, so the rays are
+	// spread evenly and weighted by cosine like diffuse light
+	aoDirections.resize(rays);
+	for (unsigned i = 0; i < rays; ++i)
+	{
+		float u = (i + 0.5f) / rays;
+		float r = sqrtf(u), phi = i * GOLDEN_ANGLE;
+		aoDirections[i] = glm::vec3(r * cosf(phi), r * sinf(phi), sqrtf(1.f - u));
+	}
+	aoDistance = distance;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Add a box that casts shadows and occludes ambient light, as a unit cube like
+MeshBuilder::GenerateCube with length 1
+
+\param model - world matrix of the box
+*/
+/******************************************************************************/
+void LightBaker::AddOccluderBox(const glm::mat4& model)
+{
+	glm::vec3 corners[8];
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+		corners[i] = glm::vec3(model * glm::vec4(corner, 1.f));
+	}
+	// Two triangles per face; rays hit them from either side
+	const unsigned faces[6][4] = {
+		{ 0, 1, 3, 2 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+	};
+	for (const unsigned* face : faces)
+	{
+		for (unsigned half = 0; half < 2; ++half)
+		{
+			Triangle triangle;
+			triangle.v0 = corners[face[0]];
+			triangle.edge1 = corners[face[1 + half]] - triangle.v0;
+			triangle.edge2 = corners[face[2 + half]] - triangle.v0;
+			occluders.push_back(triangle);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Add a mesh to be lit by the next Bake
+
+\param data - vertices to bake into; must outlive the Bake
+\param model - world matrix the mesh is drawn with
+\param material - ambient and diffuse terms of the mesh
+\param bin_path - .meshbin to keep the result in, empty to bake every time
+*/
+/******************************************************************************/
+void LightBaker::AddReceiver(MeshData& data, const glm::mat4& model, const Material& material,
+	const std::string& bin_path)
+{
+	Receiver receiver;
+	receiver.data = &data;
+	receiver.model = model;
+	receiver.material = material;
+	receiver.binPath = bin_path;
+	receivers.push_back(receiver);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Light every receiver, or load it from its .meshbin when nothing changed
+
+\param lights - lights in world space
+\param count - number of lights
+*/
+/******************************************************************************/
+void LightBaker::Bake(const Light* lights, unsigned count)
+{
+	StopWatch timer;
+	timer.startTimer();
+	stats = Stats();
+
+	std::vector<unsigned long long> hashes(receivers.size());
+	std::vector<Receiver*> pending;
+	for (size_t i = 0; i < receivers.size(); ++i)
+	{
+		Receiver& receiver = receivers[i];
+		hashes[i] = Hash(receiver, lights, count);
+		if (!receiver.binPath.empty() && MeshBin::Load(receiver.binPath, hashes[i], *receiver.data))
+			++stats.fromCache;
+		else if (!receiver.data->vertices.empty())
+			pending.push_back(&receiver);
+	}
+
+	// Chunks of vertices of every pending receiver, handed out to the threads in turn
+	std::vector<std::pair<Receiver*, unsigned>> chunks;
+	for (Receiver* receiver : pending)
+	{
+		unsigned vertexCount = static_cast<unsigned>(receiver->data->vertices.size());
+		for (unsigned first = 0; first < vertexCount; first += VERTICES_PER_CHUNK)
+			chunks.push_back(std::make_pair(receiver, first));
+		stats.vertices += vertexCount;
+	}
+
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, static_cast<unsigned>(chunks.size()));
+	stats.threads = threads;
+	std::atomic<unsigned> nextChunk(0);
+	ParallelFor(threads, [&](unsigned) {
+		for (unsigned chunk = nextChunk++; chunk < chunks.size(); chunk = nextChunk++)
+		{
+			Receiver& receiver = *chunks[chunk].first;
+			std::vector<Vertex>& vertices = receiver.data->vertices;
+			unsigned last = std::min(chunks[chunk].second + VERTICES_PER_CHUNK, static_cast<unsigned>(vertices.size()));
+			// Each chunk reads and writes only its own vertices' colors
+			for (unsigned i = chunks[chunk].second; i < last; ++i)
+				vertices[i].color = BakeVertex(receiver, i, lights, count);
+		}
+	});
+
+	for (size_t i = 0; i < receivers.size(); ++i)
+	{
+		Receiver& receiver = receivers[i];
+		if (std::find(pending.begin(), pending.end(), &receiver) == pending.end())
+			continue;
+		receiver.data->vertexFormat |= VERTEX_COLOR;
+		if (!receiver.binPath.empty())
+			MeshBin::Save(receiver.binPath, hashes[i], *receiver.data);
+	}
+	stats.bakeTime = timer.getElapsedTime();
+	lastBake = stats;
+}
+
+// Forget the occluders and receivers, keeping the ambient occlusion settings
+void LightBaker::Clear()
+{
+	occluders.clear();
+	receivers.clear();
+}
+
+// Counted by the last Bake
+const LightBaker::Stats& LightBaker::GetStats() const
+{
+	return stats;
+}
+
+// Counted by the last Bake of any baker
+const LightBaker::Stats& LightBaker::GetLastBakeStats()
+{
+	return lastBake;
+}
+
+// FNV-1a of everything a receiver's bake depends on
+unsigned long long LightBaker::Hash(const Receiver& receiver, const Light* lights, unsigned count) const
+{
+	unsigned long long hash = HashValue(FNV_OFFSET, BAKE_VERSION);
+	hash = HashValue(hash, aoDistance);
+	for (const glm::vec3& direction : aoDirections)
+		hash = HashValue(hash, direction);
+	for (const Triangle& triangle : occluders)
+		hash = HashValue(hash, triangle);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Light& light = lights[i];
+		hash = HashValue(hash, static_cast<int>(light.type));
+		hash = HashValue(hash, light.position);
+		hash = HashValue(hash, light.color);
+		hash = HashValue(hash, light.power);
+		hash = HashValue(hash, glm::vec3(light.kC, light.kL, light.kQ));
+		hash = HashValue(hash, light.spotDirection);
+		hash = HashValue(hash, light.cosCutoff);
+	}
+	hash = HashValue(hash, receiver.model);
+	hash = HashValue(hash, receiver.material.kAmbient);
+	hash = HashValue(hash, receiver.material.kDiffuse);
+	for (const Vertex& vertex : receiver.data->vertices)
+	{
+		hash = HashValue(hash, vertex.pos);
+		hash = HashValue(hash, vertex.color);
+		hash = HashValue(hash, vertex.normal);
+	}
+	for (unsigned index : receiver.data->indices)
+		hash = HashValue(hash, index);
+	return hash;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Light of one vertex, with the attenuation and spot cone of Text.fragmentshader
+
+\param receiver - mesh of the vertex
+\param index - index of the vertex
+\param lights - lights in world space
+\param count - number of lights
+\return the vertex color times the light it receives, clamped to 1
+*/
+/******************************************************************************/
+glm::vec3 LightBaker::BakeVertex(const Receiver& receiver, unsigned index, const Light* lights, unsigned count) const
+{
+	const Vertex& vertex = receiver.data->vertices[index];
+	glm::vec3 position = glm::vec3(receiver.model * glm::vec4(vertex.pos, 1.f));
+	glm::vec3 normal = glm::normalize(glm::transpose(glm::inverse(glm::mat3(receiver.model))) * vertex.normal);
+	glm::vec3 origin = position + normal * RAY_OFFSET;
+
+	// Ambient occlusion, with the spiral turned per vertex so neighbours do
+	// not band along the same rays
+	float ambient = 1.f;
+	if (!aoDirections.empty())
+	{
+		glm::vec3 tangent = glm::normalize(glm::abs(normal.x) < 0.9f
+			? glm::cross(normal, glm::vec3(1.f, 0.f, 0.f)) : glm::cross(normal, glm::vec3(0.f, 1.f, 0.f)));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		float turn = index * GOLDEN_ANGLE;
+		float c = cosf(turn), s = sinf(turn);
+		unsigned open = 0;
+		for (const glm::vec3& local : aoDirections)
+		{
+			glm::vec3 direction = tangent * (local.x * c - local.y * s) + bitangent * (local.x * s + local.y * c)
+				+ normal * local.z;
+			if (!IsOccluded(origin, direction, aoDistance))
+				++open;
+		}
+		ambient = static_cast<float>(open) / aoDirections.size();
+	}
+	glm::vec3 light = receiver.material.kAmbient * ambient;
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Light& source = lights[i];
+		glm::vec3 toLight = source.type == Light::LIGHT_DIRECTIONAL ? source.position : source.position - position;
+		float distance = glm::length(toLight);
+		if (distance <= 0.f)
+			continue;
+		glm::vec3 direction = toLight / distance;
+		float cosTheta = glm::dot(normal, direction);
+		if (cosTheta <= 0.f)
+			continue;
+
+		float attenuation = 1.f;
+		if (source.type != Light::LIGHT_DIRECTIONAL)
+			attenuation = 1.f / std::max(1.f, source.kC + source.kL * distance + source.kQ * distance * distance);
+		if (source.type == Light::LIGHT_SPOT
+			&& glm::dot(direction, glm::normalize(source.spotDirection)) < cosf(glm::radians(source.cosCutoff)))
+			continue;
+
+		float maxDistance = source.type == Light::LIGHT_DIRECTIONAL ? 1e30f : distance;
+		if (IsOccluded(origin, direction, maxDistance))
+			continue;
+		light += receiver.material.kDiffuse * source.color * source.power * cosTheta * attenuation;
+	}
+	return glm::min(vertex.color * light, glm::vec3(1.f));
+}
+
+// Whether a ray hits an occluder within maxDistance (Moller-Trumbore)
+bool LightBaker::IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	for (const Triangle& triangle : occluders)
+	{
+		glm::vec3 p = glm::cross(direction, triangle.edge2);
+		float determinant = glm::dot(triangle.edge1, p);
+		if (fabsf(determinant) < 1e-8f)
+			continue;
+		float inverse = 1.f / determinant;
+		glm::vec3 t = origin - triangle.v0;
+		float u = glm::dot(t, p) * inverse;
+		if (u < 0.f || u > 1.f)
+			continue;
+		glm::vec3 q = glm::cross(t, triangle.edge1);
+		float v = glm::dot(direction, q) * inverse;
+		if (v < 0.f || u + v > 1.f)
+			continue;
+		float hit = glm::dot(triangle.edge2, q) * inverse;
+		if (hit > 0.f && hit < maxDistance)
+			return true;
+	}
+	return false;
+}
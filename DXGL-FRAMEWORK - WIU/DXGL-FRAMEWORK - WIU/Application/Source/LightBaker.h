@@ -0,0 +1,83 @@
+#ifndef LIGHT_BAKER_H
+#define LIGHT_BAKER_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Light.h"
+#include "Material.h"
+
+struct MeshData;
+
+/******************************************************************************/
+/*!
+		Class LightBaker:
+\brief	Lights static meshes once on the CPU, so they draw with the unlit
+		path instead of looping over the lights per fragment every frame.
+		Each receiver vertex gets the diffuse term of every light, with a
+		shadow ray against the occluders, plus its material's ambient term
+		scaled by ambient occlusion from a fixed set of hemisphere rays.
+		The result, times the vertex color, replaces the vertex color and
+		the mesh gains VERTEX_COLOR. Specular light depends on the camera
+		and is left out.
+
+		A receiver given a .meshbin path is saved there after baking and
+		loaded from there while its vertices, material, the occluders and
+		the lights hash the same, so only the first launch pays for it.
+		Vertices are split over one thread per core.
+*/
+/******************************************************************************/
+class LightBaker
+{
+public:
+	struct Stats
+	{
+		unsigned vertices;  // baked this time
+		unsigned fromCache; // receivers loaded from their .meshbin
+		unsigned threads;
+		double bakeTime;    // seconds, cache loads included
+	};
+
+	LightBaker();
+	~LightBaker();
+
+	void SetAmbientOcclusion(unsigned rays, float distance);
+	void AddOccluderBox(const glm::mat4& model);
+	void AddReceiver(MeshData& data, const glm::mat4& model, const Material& material,
+		const std::string& bin_path = std::string());
+	void Bake(const Light* lights, unsigned count);
+	void Clear();
+
+	const Stats& GetStats() const;
+	static const Stats& GetLastBakeStats();
+
+private:
+	struct Triangle
+	{
+		glm::vec3 v0, edge1, edge2;
+	};
+
+	struct Receiver
+	{
+		MeshData* data;
+		glm::mat4 model;
+		Material material;
+		std::string binPath;
+	};
+
+	unsigned long long Hash(const Receiver& receiver, const Light* lights, unsigned count) const;
+	glm::vec3 BakeVertex(const Receiver& receiver, unsigned index, const Light* lights, unsigned count) const;
+	bool IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	std::vector<Triangle> occluders;
+	std::vector<Receiver> receivers;
+	std::vector<glm::vec3> aoDirections; // cosine weighted, around +z
+	float aoDistance;
+	Stats stats;
+	static Stats lastBake; // of any baker, for the F3 report
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "LightClusters.h"
+#include "GL\glew.h"
+
+#include "UniformCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Brightness below which a light no longer counts, about one step of an 8 bit channel
+	const float LIGHT_CUTOFF = 1.f / 256.f;
+}
+
+LightClusters::LightClusters()
+	: scale(0.f)
+	, nearPlane(0.f)
+	, farPlane(0.f)
+	, stats()
+{
+	std::fill(sliceDepths, sliceDepths + SLICES + 1, 0.f);
+	std::fill(buffers, buffers + 3, 0);
+	std::fill(textures, textures + 3, 0);
+}
+
+LightClusters::~LightClusters()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Create the buffer textures; call once after the GL context exists
+*/
+/******************************************************************************/
+void LightClusters::Init()
+{
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		// A buffer texture needs storage before it is attached
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Exit()
+{
+	glDeleteTextures(3, textures);
+	glDeleteBuffers(3, buffers);
+	std::fill(buffers, buffers + 3, 0);
+	std::fill(textures, textures + 3, 0);
+	lightData.clear();
+	ranges.clear();
+	indices.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Point a program's cluster samplers at their texture units. Leaves the
+program in use.
+
+\param programID - program built from Text.fragmentshader
+*/
+/******************************************************************************/
+void LightClusters::BindProgram(unsigned programID) const
+{
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(programID);
+	uniforms->Uniform1i(glGetUniformLocation(programID, "clusterLights"), LIGHTS_UNIT);
+	uniforms->Uniform1i(glGetUniformLocation(programID, "clusterRanges"), RANGES_UNIT);
+	uniforms->Uniform1i(glGetUniformLocation(programID, "clusterIndices"), INDICES_UNIT);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Bin the lights into the clusters of a camera and upload the result. An
+orthographic camera has no depth slices to speak of, so every light goes into
+cluster 0 and GetScale maps every fragment there.
+
+\param lights - lights in world space
+\param count - number of lights, clamped to MAX_LIGHTS
+\param view - camera view matrix
+\param projection - camera projection matrix
+\param viewportWidth - width of the viewport in pixels
+\param viewportHeight - height of the viewport in pixels
+*/
+/******************************************************************************/
+void LightClusters::Build(const Light* lights, unsigned count, const glm::mat4& view, const glm::mat4& projection,
+	float viewportWidth, float viewportHeight)
+{
+	if (count > MAX_LIGHTS)
+		count = MAX_LIGHTS;
+	stats = Stats();
+	pairCluster.clear();
+	pairLight.clear();
+
+	lightData.resize(count);
+	for (unsigned i = 0; i < count; ++i)
+		FrameUniforms::PackLight(lights[i], view, lightData[i]);
+
+	// Near and far planes back out of a glm::perspective matrix
+	bool perspective = projection[2][3] != 0.f;
+	if (perspective)
+	{
+		nearPlane = projection[3][2] / (projection[2][2] - 1.f);
+		farPlane = projection[3][2] / (projection[2][2] + 1.f);
+		perspective = nearPlane > 0.f && farPlane > nearPlane && std::isfinite(farPlane);
+	}
+
+	if (!perspective)
+	{
+		scale = glm::vec4(0.f);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			pairCluster.push_back(0);
+			pairLight.push_back(i);
+		}
+		stats.lights = count;
+	}
+	else
+	{
+		float logRatio = logf(farPlane / nearPlane);
+		scale.x = TILES_X / viewportWidth;
+		scale.y = TILES_Y / viewportHeight;
+		scale.z = SLICES / logRatio;
+		scale.w = -logf(nearPlane) * scale.z;
+		for (unsigned s = 0; s <= SLICES; ++s)
+			sliceDepths[s] = nearPlane * expf(logRatio * s / SLICES);
+
+		// Camera space x of a point at depth d that projects to ndc x is d * (ndc + P20) / P00
+		const glm::vec2 focal(projection[0][0], projection[1][1]);
+		const glm::vec2 skew(projection[2][0], projection[2][1]);
+		const glm::vec2 tileSize(2.f / TILES_X, 2.f / TILES_Y);
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			float range = GetRange(lights[i]);
+			if (lights[i].type == Light::LIGHT_DIRECTIONAL || range < 0.f)
+			{
+				AddToAll(i);
+				++stats.lights;
+				continue;
+			}
+
+			// Spot lights are binned by their whole sphere
+			const glm::vec3& center = lightData[i].position_cameraspace;
+			float depth = -center.z;
+			if (depth + range < nearPlane || depth - range > farPlane)
+				continue;
+			++stats.lights;
+
+			unsigned lastSlice = GetSlice(depth + range);
+			for (unsigned s = GetSlice(depth - range); s <= lastSlice; ++s)
+			{
+				// Screen rectangle of the sphere's box, cut to this slice
+				float depths[2] = { std::max(sliceDepths[s], depth - range), std::min(sliceDepths[s + 1], depth + range) };
+				glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+				for (unsigned corner = 0; corner < 8; ++corner)
+				{
+					glm::vec2 point(center.x + ((corner & 1) ? range : -range), center.y + ((corner & 2) ? range : -range));
+					glm::vec2 ndc = focal * point / depths[corner >> 2] - skew;
+					ndcMin = glm::min(ndcMin, ndc);
+					ndcMax = glm::max(ndcMax, ndc);
+				}
+				if (ndcMax.x < -1.f || ndcMax.y < -1.f || ndcMin.x > 1.f || ndcMin.y > 1.f)
+					continue;
+
+				glm::ivec2 tileMin = glm::clamp(glm::ivec2(glm::floor((ndcMin + 1.f) / tileSize)),
+					glm::ivec2(0), glm::ivec2(TILES_X - 1, TILES_Y - 1));
+				glm::ivec2 tileMax = glm::clamp(glm::ivec2(glm::floor((ndcMax + 1.f) / tileSize)),
+					glm::ivec2(0), glm::ivec2(TILES_X - 1, TILES_Y - 1));
+				for (int y = tileMin.y; y <= tileMax.y; ++y)
+				{
+					for (int x = tileMin.x; x <= tileMax.x; ++x)
+					{
+						// Camera space box of the cluster, then the sphere against it
+						glm::vec2 tileNdcMin = glm::vec2(x, y) * tileSize - 1.f;
+						glm::vec2 tileNdcMax = tileNdcMin + tileSize;
+						glm::vec2 boxMin(1e30f), boxMax(-1e30f);
+						for (unsigned side = 0; side < 2; ++side)
+						{
+							float sideDepth = sliceDepths[s + side];
+							glm::vec2 a = sideDepth * (tileNdcMin + skew) / focal;
+							glm::vec2 b = sideDepth * (tileNdcMax + skew) / focal;
+							boxMin = glm::min(boxMin, glm::min(a, b));
+							boxMax = glm::max(boxMax, glm::max(a, b));
+						}
+						glm::vec3 closest = glm::clamp(center, glm::vec3(boxMin, -sliceDepths[s + 1]),
+							glm::vec3(boxMax, -sliceDepths[s]));
+						glm::vec3 offset = closest - center;
+						if (glm::dot(offset, offset) > range * range)
+							continue;
+
+						pairCluster.push_back((s * TILES_Y + y) * TILES_X + x);
+						pairLight.push_back(i);
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort of the entries into one list per cluster
+	ranges.assign(CLUSTER_COUNT * 2, 0);
+	for (unsigned cluster : pairCluster)
+		++ranges[cluster * 2 + 1];
+	unsigned offset = 0;
+	for (unsigned cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		ranges[cluster * 2] = offset;
+		offset += ranges[cluster * 2 + 1];
+		stats.maxPerCluster = std::max(stats.maxPerCluster, ranges[cluster * 2 + 1]);
+	}
+	indices.resize(pairLight.size());
+	for (size_t i = 0; i < pairLight.size(); ++i)
+		indices[ranges[pairCluster[i] * 2]++] = static_cast<unsigned short>(pairLight[i]);
+	for (unsigned cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+		ranges[cluster * 2] -= ranges[cluster * 2 + 1];
+	stats.references = static_cast<unsigned>(indices.size());
+
+	// Orphan each buffer rather than wait on draws of the last frame
+	const void* data[3] = { lightData.data(), ranges.data(), indices.data() };
+	const size_t sizes[3] = {
+		lightData.size() * sizeof(FrameUniforms::LightData),
+		ranges.size() * sizeof(unsigned),
+		indices.size() * sizeof(unsigned short),
+	};
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizes[i] > 0 ? sizes[i] : 16, sizes[i] > 0 ? data[i] : NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Bind the buffer textures to their units and go back to unit 0
+void LightClusters::Bind() const
+{
+	const unsigned units[3] = { LIGHTS_UNIT, RANGES_UNIT, INDICES_UNIT };
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Tiles per pixel in x and y, then the scale and bias taking log(depth) to a
+slice, for FrameUniforms::SetClusters
+*/
+/******************************************************************************/
+const glm::vec4& LightClusters::GetScale() const
+{
+	return scale;
+}
+
+// Counted by the last Build
+const LightClusters::Stats& LightClusters::GetStats() const
+{
+	return stats;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Distance at which a light's attenuation, as in Text.fragmentshader, brings its
+brightest channel down to LIGHT_CUTOFF
+
+\param light - light to measure
+\return the distance, negative for a light that never fades out
+*/
+/******************************************************************************/
+float LightClusters::GetRange(const Light& light) const
+{
+	float brightness = light.power * std::max(light.color.r, std::max(light.color.g, light.color.b));
+	float c = light.kC - brightness / LIGHT_CUTOFF;
+	if (brightness <= LIGHT_CUTOFF || c >= 0.f)
+		return 0.f;
+	if (light.kQ > 0.f)
+		return (-light.kL + sqrtf(light.kL * light.kL - 4.f * light.kQ * c)) / (2.f * light.kQ);
+	if (light.kL > 0.f)
+		return -c / light.kL;
+	return -1.f;
+}
+
+// Slice holding a camera space depth, clamped to the grid
+unsigned LightClusters::GetSlice(float depth) const
+{
+	if (depth <= nearPlane)
+		return 0;
+	int slice = static_cast<int>(floorf(logf(depth) * scale.z + scale.w));
+	return static_cast<unsigned>(std::min(std::max(slice, 0), static_cast<int>(SLICES) - 1));
+}
+
+void LightClusters::AddToAll(unsigned lightIndex)
+{
+	for (unsigned cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		pairCluster.push_back(cluster);
+		pairLight.push_back(lightIndex);
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <vector>
+
+#include "Light.h"
+#include "FrameUniforms.h"
+
+/******************************************************************************/
+/*!
+		Class LightClusters:
+\brief	Any number of lights, binned on the CPU each frame into a grid of
+		clusters over the view frustum: TILES_X by TILES_Y screen tiles,
+		each cut into SLICES depth slices spaced evenly in log(depth). A
+		light goes into every cluster its range sphere touches, so a
+		fragment only shades the lights of its own cluster.
+
+		The shaders read three buffer textures: the lights as 5 RGBA32F
+		texels each (FrameUniforms::LightData), the offset and count of
+		each cluster's list as RG32UI, and the lists' light indices as
+		R16UI. Clusters are numbered (slice * TILES_Y + y) * TILES_X + x,
+		tile 0 at the bottom left of the viewport.
+*/
+/******************************************************************************/
+class LightClusters
+{
+public:
+	static const unsigned TILES_X = 16;
+	static const unsigned TILES_Y = 9;
+	static const unsigned SLICES = 24;
+	static const unsigned CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	static const unsigned MAX_LIGHTS = 65535; // indices are 16 bit
+
+	// Texture units of the buffer textures; unit 0 is the color texture
+	static const unsigned LIGHTS_UNIT = 1;
+	static const unsigned RANGES_UNIT = 2;
+	static const unsigned INDICES_UNIT = 3;
+
+	struct Stats
+	{
+		unsigned lights;        // lights binned, not behind or past the camera
+		unsigned references;    // entries over all cluster lists
+		unsigned maxPerCluster; // longest cluster list
+	};
+
+	LightClusters();
+	~LightClusters();
+
+	void Init();
+	void Exit();
+	void BindProgram(unsigned programID) const;
+
+	void Build(const Light* lights, unsigned count, const glm::mat4& view, const glm::mat4& projection,
+		float viewportWidth, float viewportHeight);
+	void Bind() const;
+
+	const glm::vec4& GetScale() const;
+	const Stats& GetStats() const;
+
+private:
+	float GetRange(const Light& light) const;
+	unsigned GetSlice(float depth) const;
+	void AddToAll(unsigned lightIndex);
+
+	std::vector<FrameUniforms::LightData> lightData;
+	std::vector<unsigned> ranges;           // offset and count of each cluster
+	std::vector<unsigned short> indices;
+	std::vector<unsigned> pairCluster, pairLight; // (cluster, light) entries before sorting
+
+	glm::vec4 scale; // tiles per pixel in x and y, log(depth) scale and bias to a slice
+	float nearPlane, farPlane;
+	float sliceDepths[SLICES + 1]; // depth of each slice's near side, and of the far plane
+	Stats stats;
+
+	unsigned buffers[3];  // lights, ranges, indices
+	unsigned textures[3];
+};
+
+#endif
@@ -1,399 +1,966 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 #include "LoadOBJ.h"
+#include "MappedFile.h"
+#include "timer.h"
 
-bool LoadOBJ(
-	const char* file_path,
-	std::vector<glm::vec3>& out_vertices,
-	std::vector<glm::vec2>& out_uvs,
-	std::vector<glm::vec3>& out_normals
-)
+namespace
 {
-	//Fill up code from OBJ lecture notes
-	std::ifstream fileStream(file_path, std::ios::binary);
-	if (!fileStream.is_open())
+	// Files smaller than this are parsed on the calling thread
+	const size_t PARALLEL_PARSE_SIZE = 4 * 1024 * 1024;
+	const unsigned MAX_PARSE_THREADS = 8;
+
+	// One corner of a face, 0-based; -1 when the face leaves the attribute out
+	struct Corner
 	{
-		std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
-		return false;
-	}
-	std::vector<unsigned> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
-	while (!fileStream.eof()) {
-		char buf[256];
-		fileStream.getline(buf, 256);
-		if (strncmp("v ", buf, 2) == 0) { 
-			// process vertex glm::vec3
+		int v, vt, vn;
+	};
 
-			glm::vec3 vertex;
-			sscanf_s((buf + 2), "%f%f%f", &vertex.x, &vertex.y, &vertex.z);
-			temp_vertices.push_back(vertex);
+	// Corners of faces counted under one usemtl; an empty name continues the
+	// material before it, e.g. at the start of a chunk
+	struct MaterialRun
+	{
+		std::string name;
+		unsigned corners;
+	};
 
+	/******************************************************************************/
+	/*!
+			Struct Chunk:
+	\brief	A range of whole lines of the OBJ and what parsing it produced.
+			Negative indices can point into earlier chunks, so they are kept
+			relative to the chunk (the RELATIVE_* bits) until the chunks are
+			joined and the offsets are known.
+	*/
+	/******************************************************************************/
+	struct Chunk
+	{
+		enum
+		{
+			RELATIVE_V = 1,
+			RELATIVE_VT = 2,
+			RELATIVE_VN = 4,
+		};
+
+		const char* begin;
+		const char* end;
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<Corner> corners;           // corners of every polygon, in order
+		std::vector<unsigned char> relative;   // RELATIVE_* bits of each corner
+		std::vector<unsigned> polygonSizes;
+		std::vector<unsigned> polygonLines;    // line of each polygon, counted in the chunk
+		std::vector<MaterialRun> runs;
+		std::vector<Corner> triangles;
+
+		unsigned positionOffset, uvOffset, normalOffset;
+		unsigned errorLine;
+		std::string error;
+	};
 
+	/******************************************************************************/
+	/*!
+			Struct OBJData:
+	\brief	Attributes and triangulated corners of a whole OBJ file
+	*/
+	/******************************************************************************/
+	struct OBJData
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<Corner> triangles;
+		std::vector<MaterialRun> runs;
+	};
 
-		}
-		else if (strncmp("vt ", buf, 3) == 0) { 
-			// process texcoord
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
 
-			glm::vec2 texCoord;
-			sscanf_s((buf + 3), "%f%f", &texCoord.s, &texCoord.t);
-			temp_uvs.push_back(texCoord);
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
 
+	inline const char* SkipSpace(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			++p;
+		return p;
+	}
 
-		}
-		else if (strncmp("vn ", buf, 3) == 0) { 
-			// process normal
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newline ? newline + 1 : end;
+	}
 
-			glm::vec3 normal;
-			sscanf_s((buf + 3), "%f%f%f", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
+	// Exact powers of ten a double can hold
+	const double POW10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
 
+	/******************************************************************************/
+	/*!
+	\brief
+	Parse a decimal number such as -1.25e-3. Digits past the 19th only scale
+	the result, which is far below float precision.
+
+	\param p - first character of the number
+	\param end - end of the text
+	\param out - receives the number
+	\return the character after the number, nullptr if there is no number
+	*/
+	/******************************************************************************/
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
 		}
-		else if (strncmp("f ", buf, 2) == 0) { 
-			// process face
 
-			unsigned int vertexIndex[4], uvIndex[4], normalIndex[4];
-			int matches = sscanf_s((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-				&vertexIndex[0], &uvIndex[0], &normalIndex[0],
-				&vertexIndex[1], &uvIndex[1], &normalIndex[1],
-				&vertexIndex[2], &uvIndex[2], &normalIndex[2],
-				&vertexIndex[3], &uvIndex[3], &normalIndex[3]);
-
-			// Process faces
-			if (matches == 9) //triangle
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		for (; p < end && IsDigit(*p); ++p, any = true)
+		{
+			if (digits < 19)
 			{
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[1]);
-				vertexIndices.push_back(vertexIndex[2]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[1]);
-				uvIndices.push_back(uvIndex[2]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[1]);
-				normalIndices.push_back(normalIndex[2]);
-			}
-			else if (matches == 12) // Do the same for quad
-			{	
-				// quad is made up of 2 triangles
-				// triangle 1
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[1]);
-				vertexIndices.push_back(vertexIndex[2]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[1]);
-				uvIndices.push_back(uvIndex[2]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[1]);
-				normalIndices.push_back(normalIndex[2]);
-
-				// triangle 2
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[2]);
-				vertexIndices.push_back(vertexIndex[3]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[2]);
-				uvIndices.push_back(uvIndex[3]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[2]);
-				normalIndices.push_back(normalIndex[3]);
-
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
 			}
 			else
+				++exponent;
+		}
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p, any = true)
 			{
-				std::cout << "Error line: " << buf << std::endl;
-				std::cout << "File can't be read by parser\n";
-				return false;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
 			}
 		}
-	}
-	fileStream.close(); // close file
+		if (!any)
+			return nullptr;
 
-	// For each vertex of each triangle, after fileStream.close()
-	for (unsigned i = 0; i < vertexIndices.size(); ++i)
-	{
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = *e == '-';
+				++e;
+			}
+			if (e < end && IsDigit(*e))
+			{
+				int value = 0;
+				for (; e < end && IsDigit(*e); ++e)
+					value = value < 10000 ? value * 10 + (*e - '0') : value;
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
 
-		// Get the attributes thanks to the index
-		glm::vec3 vertex = temp_vertices[vertexIndex - 1];
-		glm::vec2 uv = temp_uvs[uvIndex - 1];
-		glm::vec3 normal = temp_normals[normalIndex - 1];
+		double value = static_cast<double>(mantissa);
+		if (exponent < 0 && exponent >= -22)
+			value /= POW10[-exponent];
+		else if (exponent > 0 && exponent <= 22)
+			value *= POW10[exponent];
+		else if (exponent != 0)
+			value *= std::pow(10.0, exponent);
 
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs.push_back(uv);
-		out_normals.push_back(normal);
+		out = static_cast<float>(negative ? -value : value);
+		return p;
 	}
 
+	const char* ParseInt(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+		if (p >= end || !IsDigit(*p))
+			return nullptr;
+
+		long long value = 0;
+		for (; p < end && IsDigit(*p); ++p)
+			value = value < 0x7FFFFFFF ? value * 10 + (*p - '0') : value;
+		if (value > 0x7FFFFFFF)
+			value = 0x7FFFFFFF;
+		out = static_cast<int>(negative ? -value : value);
+		return p;
+	}
 
-	return true;
-}
+	// Up to count floats separated by spaces; returns how many were read
+	int ParseFloats(const char* p, const char* end, float* out, int count)
+	{
+		int read = 0;
+		for (; read < count; ++read)
+		{
+			p = SkipSpace(p, end);
+			const char* next = ParseFloat(p, end, out[read]);
+			if (!next)
+				break;
+			p = next;
+		}
+		return read;
+	}
 
-struct PackedVertex {
-	glm::vec3 position;
-	glm::vec2 uv;
-	glm::vec3 normal;
-	bool operator<(const PackedVertex that) const {
-		return memcmp((void*)this, (void*)&that, sizeof(PackedVertex)) > 0;
-	};
-};
+	// Name after a keyword, without trailing spaces or \r
+	std::string ParseName(const char* p, const char* lineEnd)
+	{
+		p = SkipSpace(p, lineEnd);
+		while (lineEnd > p && (lineEnd[-1] == '\r' || lineEnd[-1] == '\n' || IsSpace(lineEnd[-1])))
+			--lineEnd;
+		return std::string(p, lineEnd);
+	}
 
-bool getSimilarVertexIndex_fast(
-	PackedVertex& packed,
-	std::map<PackedVertex, unsigned short>& VertexToOutIndex,
-	unsigned short& result
-) {
-	std::map<PackedVertex, unsigned short>::iterator it = VertexToOutIndex.find(packed);
-	if (it == VertexToOutIndex.end())
+	/******************************************************************************/
+	/*!
+	\brief
+	Turn an OBJ index into a 0-based one. Positive indices count from the start
+	of the file, negative ones back from the last attribute read so far.
+
+	\param index - index as written in the file
+	\param count - attributes read so far in this chunk
+	\param out - receives the index
+	\param relative - set if out is still relative to the chunk
+	\return false for index 0
+	*/
+	/******************************************************************************/
+	bool ResolveIndex(int index, size_t count, int& out, bool& relative)
 	{
+		if (index > 0)
+		{
+			out = index - 1;
+			relative = false;
+			return true;
+		}
+		if (index < 0)
+		{
+			out = static_cast<int>(count) + index;
+			relative = true;
+			return true;
+		}
 		return false;
 	}
-	else
+
+	bool ParseFace(Chunk& chunk, const char* p, const char* end)
 	{
-		result = it->second;
+		unsigned size = 0;
+		for (;;)
+		{
+			p = SkipSpace(p, end);
+			if (p >= end || *p == '\r' || *p == '\n' || *p == '#')
+				break;
+
+			Corner corner = { -1, -1, -1 };
+			unsigned char relative = 0;
+			bool isRelative = false;
+			int index;
+
+			p = ParseInt(p, end, index);
+			if (!p || !ResolveIndex(index, chunk.positions.size(), corner.v, isRelative))
+				return false;
+			relative |= isRelative ? Chunk::RELATIVE_V : 0;
+
+			if (p < end && *p == '/')
+			{
+				++p;
+				if (p < end && *p != '/')
+				{
+					p = ParseInt(p, end, index);
+					if (!p || !ResolveIndex(index, chunk.uvs.size(), corner.vt, isRelative))
+						return false;
+					relative |= isRelative ? Chunk::RELATIVE_VT : 0;
+				}
+				if (p < end && *p == '/')
+				{
+					++p;
+					p = ParseInt(p, end, index);
+					if (!p || !ResolveIndex(index, chunk.normals.size(), corner.vn, isRelative))
+						return false;
+					relative |= isRelative ? Chunk::RELATIVE_VN : 0;
+				}
+			}
+			if (p < end && !IsSpace(*p) && *p != '\r' && *p != '\n')
+				return false;
+
+			chunk.corners.push_back(corner);
+			chunk.relative.push_back(relative);
+			++size;
+		}
+
+		if (size < 3)
+			return false;
+		chunk.polygonSizes.push_back(size);
+		chunk.runs.back().corners += 3 * (size - 2);
 		return true;
 	}
-}
 
-void IndexVBO(
-	std::vector<glm::vec3>& in_vertices,
-	std::vector<glm::vec2>& in_uvs,
-	std::vector<glm::vec3>& in_normals,
+	/******************************************************************************/
+	/*!
+	\brief
+	Parse the lines of one chunk. Keywords other than v, vt, vn, f and usemtl
+	are skipped.
 
-	std::vector<unsigned>& out_indices,
-	std::vector<Vertex>& out_vertices
-)
-{
-	std::map<PackedVertex, unsigned short> VertexToOutIndex;
+	\param chunk - chunk to parse; receives the attributes and polygons
+	*/
+	/******************************************************************************/
+	void ParseChunk(Chunk& chunk)
+	{
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		MaterialRun continuation = { std::string(), 0 };
+		chunk.runs.push_back(continuation);
 
-	// For each input vertex
-	for (unsigned int i = 0; i < in_vertices.size(); ++i)
+		unsigned line = 0;
+		while (p < end)
+		{
+			++line;
+			const char* lineEnd = SkipLine(p, end);
+			p = SkipSpace(p, lineEnd);
+
+			if (lineEnd - p >= 2 && p[0] == 'v' && IsSpace(p[1]))
+			{
+				glm::vec3 position(0.f);
+				if (ParseFloats(p + 2, lineEnd, &position.x, 3) != 3)
+				{
+					chunk.error = "bad vertex";
+					chunk.errorLine = line;
+					return;
+				}
+				chunk.positions.push_back(position);
+			}
+			else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2]))
+			{
+				glm::vec2 uv(0.f);
+				if (ParseFloats(p + 3, lineEnd, &uv.x, 2) < 1)
+				{
+					chunk.error = "bad texture coordinate";
+					chunk.errorLine = line;
+					return;
+				}
+				chunk.uvs.push_back(uv);
+			}
+			else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2]))
+			{
+				glm::vec3 normal(0.f);
+				if (ParseFloats(p + 3, lineEnd, &normal.x, 3) != 3)
+				{
+					chunk.error = "bad normal";
+					chunk.errorLine = line;
+					return;
+				}
+				chunk.normals.push_back(normal);
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				if (!ParseFace(chunk, p + 2, lineEnd))
+				{
+					chunk.error = "bad face";
+					chunk.errorLine = line;
+					return;
+				}
+				chunk.polygonLines.push_back(line);
+			}
+			else if (lineEnd - p >= 7 && strncmp(p, "usemtl", 6) == 0 && IsSpace(p[6]))
+			{
+				MaterialRun run = { ParseName(p + 7, lineEnd), 0 };
+				chunk.runs.push_back(run);
+			}
+			p = lineEnd;
+		}
+	}
+
+	// Project a polygon to 2D along the largest axis of its Newell normal
+	glm::vec2 Project(const glm::vec3& position, int axis)
 	{
+		if (axis == 0)
+			return glm::vec2(position.y, position.z);
+		if (axis == 1)
+			return glm::vec2(position.z, position.x);
+		return glm::vec2(position.x, position.y);
+	}
 
-		PackedVertex packed = { in_vertices[i], in_uvs[i], in_normals[i] };
+	float Cross(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
 
-		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
-		bool found = getSimilarVertexIndex_fast(packed, VertexToOutIndex, index);
+	/******************************************************************************/
+	/*!
+	\brief
+	Ear clip a polygon with 5 or more corners, so concave faces come out right.
+	Falls back to a fan if the polygon is degenerate. Always adds size - 2
+	triangles.
+
+	\param corners - corners of the polygon, resolved
+	\param size - number of corners
+	\param positions - positions of the whole file
+	\param triangles - receives the triangle corners
+	*/
+	/******************************************************************************/
+	void EarClip(const Corner* corners, unsigned size, const std::vector<glm::vec3>& positions,
+		std::vector<Corner>& triangles)
+	{
+		glm::vec3 normal(0.f);
+		for (unsigned i = 0; i < size; ++i)
+		{
+			const glm::vec3& a = positions[corners[i].v];
+			const glm::vec3& b = positions[corners[(i + 1) % size].v];
+			normal += glm::vec3((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+		}
+		glm::vec3 absNormal = glm::abs(normal);
+		int axis = absNormal.x > absNormal.y ? (absNormal.x > absNormal.z ? 0 : 2) : (absNormal.y > absNormal.z ? 1 : 2);
+		float winding = normal[axis] >= 0.f ? 1.f : -1.f;
 
-		if (found)
+		std::vector<glm::vec2> points(size);
+		std::vector<unsigned> remaining(size);
+		for (unsigned i = 0; i < size; ++i)
 		{
-			// A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back(index);
+			points[i] = Project(positions[corners[i].v], axis);
+			remaining[i] = i;
 		}
-		else
+
+		size_t start = triangles.size();
+		while (remaining.size() > 3)
 		{
-			// If not, it needs to be added in the output data.
-			Vertex v;
-			v.pos = glm::vec3(in_vertices[i].x, in_vertices[i].y, in_vertices[i].z);
-			v.texCoord = glm::vec2(in_uvs[i].s, in_uvs[i].t);
-			v.normal = glm::vec3(in_normals[i].x, in_normals[i].y, in_normals[i].z);
-			v.color = glm::vec3(1, 1, 1);
-			out_vertices.push_back(v);
-			unsigned newindex = (unsigned)out_vertices.size() - 1;
-			out_indices.push_back(newindex);
-			VertexToOutIndex[packed] = newindex;
+			unsigned count = static_cast<unsigned>(remaining.size());
+			bool clipped = false;
+			for (unsigned i = 0; i < count && !clipped; ++i)
+			{
+				unsigned prev = remaining[(i + count - 1) % count];
+				unsigned curr = remaining[i];
+				unsigned next = remaining[(i + 1) % count];
+				const glm::vec2& a = points[prev];
+				const glm::vec2& b = points[curr];
+				const glm::vec2& c = points[next];
+				if (Cross(a, b, c) * winding <= 0.f)
+					continue; // reflex or flat
+
+				bool inside = false;
+				for (unsigned j = 0; j < count && !inside; ++j)
+				{
+					unsigned other = remaining[j];
+					if (other == prev || other == curr || other == next)
+						continue;
+					const glm::vec2& q = points[other];
+					inside = Cross(a, b, q) * winding >= 0.f && Cross(b, c, q) * winding >= 0.f
+						&& Cross(c, a, q) * winding >= 0.f;
+				}
+				if (inside)
+					continue;
+
+				triangles.push_back(corners[prev]);
+				triangles.push_back(corners[curr]);
+				triangles.push_back(corners[next]);
+				remaining.erase(remaining.begin() + i);
+				clipped = true;
+			}
+
+			if (!clipped)
+			{
+				triangles.resize(start);
+				for (unsigned i = 1; i + 1 < size; ++i)
+				{
+					triangles.push_back(corners[0]);
+					triangles.push_back(corners[i]);
+					triangles.push_back(corners[i + 1]);
+				}
+				return;
+			}
 		}
+		triangles.push_back(corners[remaining[0]]);
+		triangles.push_back(corners[remaining[1]]);
+		triangles.push_back(corners[remaining[2]]);
 	}
-}
 
-bool LoadMTL(const char* file_path, std::map<std::string, Material*>& materials_map)
-{
-	std::ifstream fileStream(file_path, std::ios::binary);
-	if (!fileStream.is_open())
+	/******************************************************************************/
+	/*!
+	\brief
+	Make the chunk's indices absolute, check them and split its polygons into
+	triangles. Triangles and quads keep the corner order of the old parser.
+
+	\param chunk - parsed chunk with its offsets set
+	\param data - attributes of the whole file
+	*/
+	/******************************************************************************/
+	void TriangulateChunk(Chunk& chunk, const OBJData& data)
 	{
-		std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
-		return false;
-	}
-	Material* mtl = nullptr;
-	while (!fileStream.eof()) {
-		char buf[256];
-		fileStream.getline(buf, 256);
-		if (strncmp("newmtl ", buf, 7) == 0) { //process newmtl
-			char mtl_name[256];
-			strcpy_s(mtl_name, buf + 7);
-			if (mtl_name[strlen(mtl_name) - 1] == '\r')
-				mtl_name[strlen(mtl_name) - 1] = '\0';
-			mtl = nullptr;
-			if (materials_map.find(mtl_name) == materials_map.end())
+		size_t i = 0;
+		for (size_t polygon = 0; polygon < chunk.polygonSizes.size(); ++polygon)
+		{
+			for (unsigned j = 0; j < chunk.polygonSizes[polygon]; ++j, ++i)
 			{
-				mtl = new Material();
-				materials_map.insert(std::pair<std::string, Material*>(mtl_name, mtl));
+				Corner& corner = chunk.corners[i];
+				unsigned char relative = chunk.relative[i];
+				if (relative & Chunk::RELATIVE_V)
+					corner.v += chunk.positionOffset;
+				if (relative & Chunk::RELATIVE_VT)
+					corner.vt += chunk.uvOffset;
+				if (relative & Chunk::RELATIVE_VN)
+					corner.vn += chunk.normalOffset;
+
+				if (corner.v < 0 || corner.v >= static_cast<int>(data.positions.size())
+					|| corner.vt >= static_cast<int>(data.uvs.size())
+					|| corner.vn >= static_cast<int>(data.normals.size())
+					|| ((relative & Chunk::RELATIVE_VT) && corner.vt < 0)
+					|| ((relative & Chunk::RELATIVE_VN) && corner.vn < 0))
+				{
+					chunk.error = "face index out of range";
+					chunk.errorLine = chunk.polygonLines[polygon];
+					return;
+				}
 			}
 		}
-		else if (strncmp("Ka ", buf, 3) == 0) { //process Ka
-			if (mtl != nullptr)
+
+		chunk.triangles.reserve(chunk.corners.size() * 2);
+		const Corner* polygon = chunk.corners.data();
+		for (unsigned size : chunk.polygonSizes)
+		{
+			if (size == 3)
+			{
+				chunk.triangles.insert(chunk.triangles.end(), polygon, polygon + 3);
+			}
+			else if (size == 4)
+			{
+				chunk.triangles.insert(chunk.triangles.end(), polygon, polygon + 3);
+				chunk.triangles.push_back(polygon[0]);
+				chunk.triangles.push_back(polygon[2]);
+				chunk.triangles.push_back(polygon[3]);
+			}
+			else
 			{
-				sscanf_s((buf + 2), "%f%f%f", &mtl->kAmbient.r, &mtl->kAmbient.g, &mtl->kAmbient.b);
+				EarClip(polygon, size, data.positions, chunk.triangles);
 			}
+			polygon += size;
 		}
-		else if (strncmp("Kd ", buf, 3) == 0) { //process Kd
-			if (mtl != nullptr)
+	}
+
+	// Run job(i) for i in [0, count) on count threads, the last on this one
+	template <typename Job>
+	void ParallelFor(unsigned count, Job job)
+	{
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i + 1 < count; ++i)
+			threads.push_back(std::thread(job, i));
+		if (count > 0)
+			job(count - 1);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	unsigned ParseThreadCount(size_t size)
+	{
+		if (size < PARALLEL_PARSE_SIZE)
+			return 1;
+		unsigned threads = std::thread::hardware_concurrency();
+		if (threads == 0)
+			return 1;
+		return threads < MAX_PARSE_THREADS ? threads : MAX_PARSE_THREADS;
+	}
+
+	// Error of a chunk with its line in the whole file; line numbers are counted
+	// per chunk, so the lines of the chunks before are added
+	std::string ChunkError(const std::vector<Chunk>& chunks, const Chunk& chunk)
+	{
+		unsigned line = chunk.errorLine;
+		for (const Chunk* before = chunks.data(); before != &chunk; ++before)
+			line += static_cast<unsigned>(std::count(before->begin, before->end, '\n'));
+		return chunk.error + " on line " + std::to_string(line);
+	}
+
+	/******************************************************************************/
+	/*!
+	\brief
+	Parse an OBJ file from memory into triangles. Large files are cut at line
+	breaks into one chunk per thread.
+
+	\param text - contents of the file
+	\param size - size of the file in bytes
+	\param threadCount - number of chunks to parse in parallel
+	\param data - receives the file
+	\param error - receives a description of the first error
+	\return false if the file is not a valid OBJ
+	*/
+	/******************************************************************************/
+	bool ParseOBJ(const char* text, size_t size, unsigned threadCount, OBJData& data, std::string& error)
+	{
+		if (threadCount == 0)
+			threadCount = 1;
+
+		std::vector<Chunk> chunks(threadCount);
+		const char* end = text + size;
+		const char* begin = text;
+		for (unsigned i = 0; i < threadCount; ++i)
+		{
+			const char* split = i + 1 == threadCount ? end : text + size / threadCount * (i + 1);
+			if (split < begin)
+				split = begin;
+			if (split < end)
+				split = SkipLine(split, end);
+			chunks[i].begin = begin;
+			chunks[i].end = split;
+			chunks[i].errorLine = 0;
+			begin = split;
+		}
+
+		ParallelFor(threadCount, [&chunks](unsigned i) { ParseChunk(chunks[i]); });
+
+		size_t positionCount = 0, uvCount = 0, normalCount = 0;
+		for (Chunk& chunk : chunks)
+		{
+			if (!chunk.error.empty())
 			{
-				sscanf_s((buf + 2), "%f%f%f", &mtl->kDiffuse.r, &mtl->kDiffuse.g, &mtl->kDiffuse.b);
+				error = ChunkError(chunks, chunk);
+				return false;
 			}
+			chunk.positionOffset = static_cast<unsigned>(positionCount);
+			chunk.uvOffset = static_cast<unsigned>(uvCount);
+			chunk.normalOffset = static_cast<unsigned>(normalCount);
+			positionCount += chunk.positions.size();
+			uvCount += chunk.uvs.size();
+			normalCount += chunk.normals.size();
 		}
-		else if (strncmp("Ks ", buf, 3) == 0) { //process Ks
-			if (mtl != nullptr)
+
+		data.positions.reserve(positionCount);
+		data.uvs.reserve(uvCount);
+		data.normals.reserve(normalCount);
+		for (Chunk& chunk : chunks)
+		{
+			data.positions.insert(data.positions.end(), chunk.positions.begin(), chunk.positions.end());
+			data.uvs.insert(data.uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			data.normals.insert(data.normals.end(), chunk.normals.begin(), chunk.normals.end());
+			std::vector<glm::vec3>().swap(chunk.positions);
+			std::vector<glm::vec2>().swap(chunk.uvs);
+			std::vector<glm::vec3>().swap(chunk.normals);
+		}
+
+		ParallelFor(threadCount, [&chunks, &data](unsigned i) { TriangulateChunk(chunks[i], data); });
+
+		size_t cornerCount = 0;
+		for (const Chunk& chunk : chunks)
+		{
+			if (!chunk.error.empty())
 			{
-				sscanf_s((buf + 2), "%f%f%f", &mtl->kSpecular.r, &mtl->kSpecular.g, &mtl->kSpecular.b);
+				error = ChunkError(chunks, chunk);
+				return false;
 			}
+			cornerCount += chunk.triangles.size();
 		}
-		else if (strncmp("Ns ", buf, 3) == 0) { //process Ns
-			if (mtl != nullptr)
+
+		data.triangles.reserve(cornerCount);
+		for (Chunk& chunk : chunks)
+		{
+			data.triangles.insert(data.triangles.end(), chunk.triangles.begin(), chunk.triangles.end());
+			for (const MaterialRun& run : chunk.runs)
 			{
-				sscanf_s((buf + 2), "%f", &mtl->kShininess);
+				if (run.name.empty() && !data.runs.empty())
+					data.runs.back().corners += run.corners;
+				else
+					data.runs.push_back(run);
 			}
 		}
+		return true;
 	}
-	fileStream.close(); // close file
 
-	return true;
-}
+	bool ParseOBJFile(const char* file_path, OBJData& data)
+	{
+		MappedFile file;
+		if (!file.Open(file_path))
+		{
+			std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
+			return false;
+		}
 
-bool LoadOBJMTL(const char* file_path, const char* mtl_path, std::vector<glm::vec3>& out_vertices, std::vector<glm::vec2>& out_uvs, std::vector<glm::vec3>& out_normals, std::vector<Material>& out_materials)
-{
-	std::ifstream fileStream(file_path, std::ios::binary);
-	if (!fileStream.is_open())
+		const char* text = reinterpret_cast<const char*>(file.GetData());
+		std::string error;
+		if (!ParseOBJ(text, file.GetSize(), ParseThreadCount(file.GetSize()), data, error))
+		{
+			std::cout << file_path << ": " << error << "\n";
+			std::cout << "File can't be read by parser\n";
+			return false;
+		}
+		return true;
+	}
+
+	// Flat normal of a triangle, for faces written without vn
+	glm::vec3 FaceNormal(const OBJData& data, const Corner* triangle)
 	{
-		std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
-		return false;
+		const glm::vec3& a = data.positions[triangle[0].v];
+		const glm::vec3& b = data.positions[triangle[1].v];
+		const glm::vec3& c = data.positions[triangle[2].v];
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		return length > 0.f ? normal / length : glm::vec3(0.f, 1.f, 0.f);
 	}
-	std::vector<unsigned> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
-	std::map<std::string, Material*> materials_map;
-	if(mtl_path != nullptr && !LoadMTL(mtl_path, materials_map))
-		return false;
 
-	while (!fileStream.eof()) {
-		char buf[256];
-		fileStream.getline(buf, 256);
-		if (strncmp("v ", buf, 2) == 0) { 
-			// process vertex glm::vec3
-			glm::vec3 vertex;
-			sscanf_s(buf + 2, "%f %f %f", &vertex.x, &vertex.y, &vertex.z);
-			temp_vertices.push_back(vertex);
-
-		}
-		else if (strncmp("vt ", buf, 3) == 0) { 
-			// process texcoord
-			glm::vec2 uv;
-			sscanf_s(buf + 3, "%f %f", &uv.x, &uv.y);
-			temp_uvs.push_back(uv);
-		}
-		else if (strncmp("vn ", buf, 3) == 0) { 
-			// process normal
-			glm::vec3 normal;
-			sscanf_s(buf + 3, "%f %f %f", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
-		}
-		//else if (strncmp("mtllib ", buf, 7) == 0) { //process mtllib
-		//	char mtl_path[256];
-		//	strcpy_s(mtl_path, buf + 7);
-		//	LoadMTL(mtl_path, materials_map);
-		//}
-		else if (strncmp("usemtl ", buf, 7) == 0) { 
-			// process usemtl
-			char mtl_name[256];
-			strcpy_s(mtl_name, buf + 7);
-			if (materials_map.find(mtl_name) != materials_map.end())
+	bool LoadMTL(const char* file_path, std::map<std::string, Material>& materials_map)
+	{
+		MappedFile file;
+		if (!file.Open(file_path))
+		{
+			std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
+			return false;
+		}
+
+		const char* p = reinterpret_cast<const char*>(file.GetData());
+		const char* end = p + file.GetSize();
+		Material* mtl = nullptr;
+		while (p < end)
+		{
+			const char* lineEnd = SkipLine(p, end);
+			p = SkipSpace(p, lineEnd);
+			if (lineEnd - p >= 7 && strncmp(p, "newmtl", 6) == 0 && IsSpace(p[6]))
 			{
-				Material* mtl = materials_map.find(mtl_name)->second;
-				Material material = *mtl;
-				out_materials.push_back(material);
+				std::string mtl_name = ParseName(p + 7, lineEnd);
+				// The first definition of a name wins
+				mtl = materials_map.count(mtl_name) ? nullptr : &materials_map[mtl_name];
 			}
+			else if (mtl && lineEnd - p >= 3 && p[0] == 'K' && IsSpace(p[2]))
+			{
+				if (p[1] == 'a')
+					ParseFloats(p + 3, lineEnd, &mtl->kAmbient.r, 3);
+				else if (p[1] == 'd')
+					ParseFloats(p + 3, lineEnd, &mtl->kDiffuse.r, 3);
+				else if (p[1] == 's')
+					ParseFloats(p + 3, lineEnd, &mtl->kSpecular.r, 3);
+			}
+			else if (mtl && lineEnd - p >= 3 && p[0] == 'N' && p[1] == 's' && IsSpace(p[2]))
+			{
+				ParseFloats(p + 3, lineEnd, &mtl->kShininess, 1);
+			}
+			p = lineEnd;
 		}
-		else if (strncmp("f ", buf, 2) == 0) { 
-			// process face
-			// refer to lecture on how to do it
-			unsigned int vertexIndex[4], uvIndex[4], normalIndex[4];
-			int matches = sscanf_s((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-				&vertexIndex[0], &uvIndex[0], &normalIndex[0],
-				&vertexIndex[1], &uvIndex[1], &normalIndex[1],
-				&vertexIndex[2], &uvIndex[2], &normalIndex[2],
-				&vertexIndex[3], &uvIndex[3], &normalIndex[3]);
-
-			if (matches == 9) //triangle (hint: index 0,1,2)
+		return true;
+	}
+
+	// One Material per usemtl run, sized in triangle corners. Faces before the
+	// first known material are drawn by none, as before.
+	void BuildMaterials(const OBJData& data, const std::map<std::string, Material>& materials_map,
+		std::vector<Material>& out_materials)
+	{
+		for (const MaterialRun& run : data.runs)
+		{
+			std::map<std::string, Material>::const_iterator it = materials_map.find(run.name);
+			if (it != materials_map.end())
 			{
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[1]);
-				vertexIndices.push_back(vertexIndex[2]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[1]);
-				uvIndices.push_back(uvIndex[2]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[1]);
-				normalIndices.push_back(normalIndex[2]);
-
-				if (out_materials.size() > 0)
-				{
-					out_materials.back().size += 3;
-				}
+				out_materials.push_back(it->second);
+				out_materials.back().size = 0;
 			}
-			else if (matches == 12) //quad (hint: index 0,1,2 & 0,2,3)
+			if (!out_materials.empty())
+				out_materials.back().size += run.corners;
+		}
+	}
+
+	struct CornerHash
+	{
+		size_t operator()(const Corner& corner) const
+		{
+			unsigned long long key = static_cast<unsigned>(corner.v);
+			key = key * 0x9E3779B97F4A7C15ULL ^ static_cast<unsigned>(corner.vt);
+			key = key * 0x9E3779B97F4A7C15ULL ^ static_cast<unsigned>(corner.vn);
+			return static_cast<size_t>(key ^ (key >> 29));
+		}
+	};
+
+	struct CornerEqual
+	{
+		bool operator()(const Corner& a, const Corner& b) const
+		{
+			return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+		}
+	};
+
+	/******************************************************************************/
+	/*!
+	\brief
+	Index the triangles by their v/vt/vn triple rather than by comparing whole
+	vertices. Corners without a normal get their face's normal and are never
+	shared.
+
+	\param data - parsed file
+	\param out_indices - receives one index per corner
+	\param out_vertices - receives the unique vertices
+	*/
+	/******************************************************************************/
+	void IndexTriangles(const OBJData& data, std::vector<unsigned>& out_indices, std::vector<Vertex>& out_vertices)
+	{
+		std::unordered_map<Corner, unsigned, CornerHash, CornerEqual> cornerToIndex;
+		cornerToIndex.reserve(data.positions.size() * 2);
+		out_indices.reserve(out_indices.size() + data.triangles.size());
+		out_vertices.reserve(out_vertices.size() + data.positions.size());
+
+		for (size_t i = 0; i < data.triangles.size(); ++i)
+		{
+			const Corner& corner = data.triangles[i];
+			if (corner.vn >= 0)
 			{
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[1]);
-				vertexIndices.push_back(vertexIndex[2]);
-				vertexIndices.push_back(vertexIndex[0]);
-				vertexIndices.push_back(vertexIndex[2]);
-				vertexIndices.push_back(vertexIndex[3]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[1]);
-				uvIndices.push_back(uvIndex[2]);
-				uvIndices.push_back(uvIndex[0]);
-				uvIndices.push_back(uvIndex[2]);
-				uvIndices.push_back(uvIndex[3]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[1]);
-				normalIndices.push_back(normalIndex[2]);
-				normalIndices.push_back(normalIndex[0]);
-				normalIndices.push_back(normalIndex[2]);
-				normalIndices.push_back(normalIndex[3]);
-
-				if (out_materials.size() > 0)
+				std::unordered_map<Corner, unsigned, CornerHash, CornerEqual>::iterator it = cornerToIndex.find(corner);
+				if (it != cornerToIndex.end())
 				{
-					out_materials.back().size += 6;
+					out_indices.push_back(it->second);
+					continue;
 				}
 			}
-			else
+
+			Vertex v;
+			v.pos = data.positions[corner.v];
+			v.texCoord = corner.vt >= 0 ? data.uvs[corner.vt] : glm::vec2(0.f);
+			v.normal = corner.vn >= 0 ? data.normals[corner.vn] : FaceNormal(data, &data.triangles[i - i % 3]);
+			v.color = glm::vec3(1, 1, 1);
+			out_vertices.push_back(v);
+			unsigned newindex = (unsigned)out_vertices.size() - 1;
+			out_indices.push_back(newindex);
+			if (corner.vn >= 0)
+				cornerToIndex[corner] = newindex;
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Load an OBJ straight into indexed vertices, without expanding it into
+per-corner arrays first
+
+\param file_path - path of the OBJ file
+\param mtl_path - path of the MTL file, or nullptr for none
+\param out_indices - receives one index per triangle corner
+\param out_vertices - receives the unique vertices
+\param out_materials - receives one material per usemtl, sized in indices
+\return false if either file could not be read
+*/
+/******************************************************************************/
+bool LoadOBJIndexed(const char* file_path, const char* mtl_path, std::vector<unsigned>& out_indices,
+	std::vector<Vertex>& out_vertices, std::vector<Material>& out_materials)
+{
+	std::map<std::string, Material> materials_map;
+	if (mtl_path != nullptr && !LoadMTL(mtl_path, materials_map))
+		return false;
+
+	OBJData data;
+	if (!ParseOBJFile(file_path, data))
+		return false;
+
+	IndexTriangles(data, out_indices, out_vertices);
+	if (mtl_path != nullptr)
+		BuildMaterials(data, materials_map, out_materials);
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Print how fast the parser reads an OBJ, on one thread and on all of them.
+Without a file a grid of about 3 million triangles is written and used.
+
+\param file_path - OBJ file to time, or nullptr
+*/
+/******************************************************************************/
+void BenchmarkOBJ(const char* file_path)
+{
+	const int RUNS = 3;
+	std::string path = file_path ? file_path : "BenchmarkGrid.obj";
+
+	if (!file_path)
+	{
+		const int GRID = 1200;
+		std::ofstream grid(path, std::ios::binary | std::ios::trunc);
+		if (!grid.is_open())
+		{
+			std::cout << "Impossible to write " << path << "\n";
+			return;
+		}
+		grid << "# " << GRID << " x " << GRID << " quad grid\nvn 0 1 0\n";
+		for (int z = 0; z <= GRID; ++z)
+		{
+			for (int x = 0; x <= GRID; ++x)
+			{
+				grid << "v " << x * 0.01f << ' ' << std::sin(x * 0.05f) * std::cos(z * 0.05f) << ' ' << z * 0.01f << '\n';
+				grid << "vt " << (float)x / GRID << ' ' << (float)z / GRID << '\n';
+			}
+		}
+		for (int z = 0; z < GRID; ++z)
+		{
+			for (int x = 0; x < GRID; ++x)
 			{
+				int a = z * (GRID + 1) + x + 1;
+				int b = a + GRID + 1;
+				grid << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 "
+					<< b + 1 << '/' << b + 1 << "/1 " << a + 1 << '/' << a + 1 << "/1\n";
 			}
 		}
 	}
-	fileStream.close(); // close file
 
-	// For each vertex of each triangle, after fileStream.close()
-	for (unsigned i = 0; i < vertexIndices.size(); ++i)
+	MappedFile file;
+	if (!file.Open(path))
 	{
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
-
-		// Get the attributes thanks to the index
-		glm::vec3 vertex = temp_vertices[vertexIndex - 1];
-		glm::vec2 uv = temp_uvs[uvIndex - 1];
-		glm::vec3 normal = temp_normals[normalIndex - 1];
-
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs.push_back(uv);
-		out_normals.push_back(normal);
+		std::cout << "Impossible to open " << path << ". Are you in the right directory ?\n";
+		return;
 	}
+	const char* text = reinterpret_cast<const char*>(file.GetData());
+	double megabytes = file.GetSize() / (1024.0 * 1024.0);
 
-	for (std::map<std::string, Material*>::iterator it = materials_map.begin(); it != materials_map.end(); ++it)
+	StopWatch timer;
+	unsigned threadCounts[2] = { 1, ParseThreadCount(file.GetSize()) };
+	std::cout << "OBJ benchmark: " << path << ", " << megabytes << " MB\n";
+	for (int t = 0; t < 2; ++t)
 	{
-		delete it->second;
+		double best = 1e30;
+		size_t triangles = 0;
+		for (int run = 0; run < RUNS; ++run)
+		{
+			OBJData data;
+			std::string error;
+			timer.startTimer();
+			bool parsed = ParseOBJ(text, file.GetSize(), threadCounts[t], data, error);
+			double time = timer.getElapsedTime();
+			if (!parsed)
+			{
+				std::cout << "  " << error << "\n";
+				return;
+			}
+			triangles = data.triangles.size() / 3;
+			best = time < best ? time : best;
+		}
+		std::cout << "  " << threadCounts[t] << " thread(s): " << triangles << " triangles in "
+			<< best * 1000.0 << " ms, " << megabytes / best << " MB/s\n";
 	}
-	materials_map.clear();
 
-	return true;
+	std::vector<unsigned> indices;
+	std::vector<Vertex> vertices;
+	std::vector<Material> materials;
+	timer.startTimer();
+	LoadOBJIndexed(path.c_str(), nullptr, indices, vertices, materials);
+	double indexed = timer.getElapsedTime();
+	std::cout << "  parse and index: " << vertices.size() << " vertices in " << indexed * 1000.0 << " ms\n";
+
+	file.Close();
+	if (!file_path)
+		remove(path.c_str());
 }
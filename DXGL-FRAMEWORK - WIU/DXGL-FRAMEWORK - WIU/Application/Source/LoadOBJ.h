@@ -6,29 +6,16 @@
 #include "Vertex.h"
 #include "Material.h"
 
-bool LoadOBJ(
-	const char *file_path, 
-	std::vector<glm::vec3> & out_vertices, 
-	std::vector<glm::vec2> & out_uvs, 
-	std::vector<glm::vec3> & out_normals
-);
-
-void IndexVBO(
-	std::vector<glm::vec3> & in_vertices,
-	std::vector<glm::vec2> & in_uvs,
-	std::vector<glm::vec3> & in_normals,
-
-	std::vector<unsigned> & out_indices,
-	std::vector<Vertex> & out_vertices
-);
-
-bool LoadOBJMTL(
-	const char* file_path, 
+// Parse an OBJ and its MTL into indexed vertices; mtl_path may be nullptr
+bool LoadOBJIndexed(
+	const char* file_path,
 	const char* mtl_path,
-	std::vector<glm::vec3>& out_vertices,
-	std::vector<glm::vec2>& out_uvs,
-	std::vector<glm::vec3>& out_normals,
+	std::vector<unsigned>& out_indices,
+	std::vector<Vertex>& out_vertices,
 	std::vector<Material>& out_materials
 );
 
+// Print parser throughput for file_path, or for a generated grid if nullptr
+void BenchmarkOBJ(const char* file_path);
+
 #endif
\ No newline at end of file
@@ -1,67 +1,368 @@
 
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <string>
 #include <GL\glew.h>
 
 #include "LoadTGA.h"
+#include "MeshBin.h"
+#include "TexBin.h"
+#include "TextureCompressor.h"
 
-GLuint LoadTGA(const char *file_path)				// load TGA file to memory
+static bool textureCompression = true;
+
+// Part of the .texbin hash, so changing the settings does not load stale levels
+static unsigned long long SettingsSalt(bool compress, unsigned quarterTurns)
+{
+	return (compress ? 0x6263313362633300ULL : 0) ^ (quarterTurns * 0x9E3779B97F4A7C15ULL);
+}
+
+GLuint LoadTGA(const char *file_path, bool compress)	// load TGA file to memory
+{
+	TGAImage image;
+	if (!DecodeTGA(file_path, image, compress))
+		return 0;
+	return UploadTGA(image);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Read the pixels of an uncompressed or RLE TGA file, bottom row first
+
+\param file_path - path of the TGA file
+\param image - receives the size and bytes per pixel
+\param pixels - receives the BGR or BGRA pixels
+
+\return false if the file could not be read or is not 24 or 32 bit true color
+*/
+/******************************************************************************/
+static bool ReadTGA(const char *file_path, TGAImage &image, std::vector<unsigned char> &pixels)
 {
 	std::ifstream fileStream(file_path, std::ios::binary);
 	if(!fileStream.is_open()) {
 		std::cout << "Impossible to open " << file_path << ". Are you in the right directory ?\n";
-		return 0;
+		return false;
 	}
 
-	GLubyte		header[ 18 ];									// first 6 useful header bytes
-	GLuint		bytesPerPixel;								    // number of bytes per pixel in TGA gile
-	GLuint		imageSize;									    // for setting memory
-	GLubyte *	data;
-	GLuint		texture = 0;
+	GLubyte		header[ 18 ];
 	unsigned	width, height;
 
 	fileStream.read((char*)header, 18);
 	width = header[12] + header[13] * 256;
 	height = header[14] + header[15] * 256;
+	bool rle = header[2] == 10;					// 2 is uncompressed true color, 10 the same run length encoded
 
- 	if(	width <= 0 ||								// is width <= 0
+ 	if(	!fileStream.good() ||
+		width <= 0 ||								// is width <= 0
 		height <= 0 ||								// is height <=0
+		(header[2] != 2 && header[2] != 10) ||		// is true color
 		(header[16] != 24 && header[16] != 32))		// is TGA 24 or 32 Bit
 	{
 		fileStream.close();							// close file on failure
 		std::cout << "File header error.\n";
-		return 0;										
+		return false;
+	}
+
+	image.width = width;
+	image.height = height;
+	image.bytesPerPixel = header[16] / 8;						//divide by 8 to get bytes per pixel
+	pixels.resize(width * height * image.bytesPerPixel);		// calculate memory required for TGA data
+
+	// Skip the image ID and the color map, if any
+	unsigned colorMapSize = (header[5] + header[6] * 256) * ((header[7] + 7) / 8);
+	fileStream.seekg(18 + header[0] + (header[1] ? colorMapSize : 0), std::ios::beg);
+
+	if (!rle)
+	{
+		fileStream.read((char *)&pixels[0], pixels.size());
+	}
+	else
+	{
+		// Packets of a count byte and either one pixel to repeat or count raw pixels
+		unsigned bytesPerPixel = image.bytesPerPixel;
+		size_t pixel = 0, pixelCount = width * height;
+		while (pixel < pixelCount && fileStream.good())
+		{
+			unsigned char packet = 0;
+			fileStream.read((char *)&packet, 1);
+			size_t count = (packet & 0x7F) + 1;
+			if (count > pixelCount - pixel)
+				count = pixelCount - pixel;
+
+			unsigned char *out = &pixels[pixel * bytesPerPixel];
+			if (packet & 0x80)
+			{
+				fileStream.read((char *)out, bytesPerPixel);
+				for (size_t i = 1; i < count; ++i)
+					memcpy(out + i * bytesPerPixel, out, bytesPerPixel);
+			}
+			else
+			{
+				fileStream.read((char *)out, count * bytesPerPixel);
+			}
+			pixel += count;
+		}
+	}
+	if (!fileStream.good())
+	{
+		std::cout << "Unexpected end of " << file_path << "\n";
+		return false;
+	}
+	fileStream.close();
+
+	// Bit 5 of the descriptor is set when the top row comes first
+	if (header[17] & 0x20)
+	{
+		size_t rowSize = width * image.bytesPerPixel;
+		std::vector<unsigned char> row(rowSize);
+		for (unsigned y = 0; y < height / 2; ++y)
+		{
+			unsigned char *top = &pixels[y * rowSize], *bottom = &pixels[(height - 1 - y) * rowSize];
+			memcpy(row.data(), top, rowSize);
+			memcpy(top, bottom, rowSize);
+			memcpy(bottom, row.data(), rowSize);
+		}
+	}
+	return true;
+}
+
+// Turn square pixels a quarter turn counterclockwise, bottom row first as GL reads them
+static void RotateQuarter(std::vector<unsigned char> &pixels, unsigned size, unsigned bytesPerPixel)
+{
+	std::vector<unsigned char> turned(pixels.size());
+	for (unsigned y = 0; y < size; ++y)
+	{
+		for (unsigned x = 0; x < size; ++x)
+			memcpy(&turned[(y * size + x) * bytesPerPixel], &pixels[((size - 1 - x) * size + y) * bytesPerPixel], bytesPerPixel);
+	}
+	pixels.swap(turned);
+}
+
+// Next mip level of pixels, averaging 2x2 texels; an odd last row or column is repeated
+static void Downsample(const std::vector<unsigned char> &pixels, unsigned width, unsigned height, unsigned bytesPerPixel,
+	std::vector<unsigned char> &next)
+{
+	unsigned nextWidth = width > 1 ? width / 2 : 1, nextHeight = height > 1 ? height / 2 : 1;
+	next.resize(nextWidth * nextHeight * bytesPerPixel);
+	for (unsigned y = 0; y < nextHeight; ++y)
+	{
+		unsigned y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		for (unsigned x = 0; x < nextWidth; ++x)
+		{
+			unsigned x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			for (unsigned c = 0; c < bytesPerPixel; ++c)
+			{
+				unsigned sum = pixels[(y0 * width + x0) * bytesPerPixel + c] + pixels[(y0 * width + x1) * bytesPerPixel + c]
+					+ pixels[(y1 * width + x0) * bytesPerPixel + c] + pixels[(y1 * width + x1) * bytesPerPixel + c];
+				next[(y * nextWidth + x) * bytesPerPixel + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Read a TGA file into every mip level down to 1x1, compressed as BC1, or BC3
+if it has alpha that is not all opaque. The levels are cached in a .texbin
+beside the file. Uses no GL, so it can run on a loader thread.
+
+\param file_path - path of the TGA file
+\param image - receives the size and levels
+\param compress - false to keep the pixels as stored, e.g. for a font
+\param quarterTurns - counterclockwise turns of the image, e.g. to fit a
+	cube map face; odd turns need a square image
+
+\return false if the file could not be read or is not 24 or 32 bit
+*/
+/******************************************************************************/
+bool DecodeTGA(const char *file_path, TGAImage &image, bool compress, unsigned quarterTurns)
+{
+	compress = compress && textureCompression;
+	quarterTurns %= 4;
+
+	std::string bin_path = TexBin::GetPath(file_path);
+	unsigned long long hash = MeshBin::HashFiles(std::vector<std::string>(1, file_path)) ^ SettingsSalt(compress, quarterTurns);
+	if (TexBin::Load(bin_path, hash, image))
+		return true;
+
+	std::vector<unsigned char> pixels;
+	if (!ReadTGA(file_path, image, pixels))
+		return false;
+
+	if (quarterTurns % 2 == 1 && image.width != image.height)
+	{
+		std::cout << file_path << " must be square to be turned\n";
+		return false;
+	}
+	for (unsigned turn = 0; turn < quarterTurns; ++turn)
+		RotateQuarter(pixels, image.width, image.bytesPerPixel);
+
+	bool opaque = true;
+	for (size_t i = 3; image.bytesPerPixel == 4 && i < pixels.size() && opaque; i += 4)
+		opaque = pixels[i] == 255;
+
+	if (!compress)
+		image.format = image.bytesPerPixel == 4 ? TEXTURE_BGRA : TEXTURE_BGR;
+	else
+		image.format = opaque ? TEXTURE_BC1 : TEXTURE_BC3;
+
+	image.file.reset();
+	image.data.clear();
+	image.levelCount = 0;
+	unsigned width = image.width, height = image.height;
+	std::vector<unsigned char> blocks, next;
+	while (true)
+	{
+		if (image.format == TEXTURE_BC1)
+			TextureCompressor::CompressBC1(pixels.data(), width, height, image.bytesPerPixel, blocks);
+		else if (image.format == TEXTURE_BC3)
+			TextureCompressor::CompressBC3(pixels.data(), width, height, blocks);
+		const std::vector<unsigned char> &level = compress ? blocks : pixels;
+		image.data.insert(image.data.end(), level.begin(), level.end());
+		++image.levelCount;
+
+		if (width == 1 && height == 1)
+			break;
+		Downsample(pixels, width, height, image.bytesPerPixel, next);
+		pixels.swap(next);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	TexBin::Save(bin_path, hash, image);
+	return true;
+}
+
+// Every level of image into target of the bound texture
+static void UploadLevels(const TGAImage &image, GLenum target)
+{
+	// Rows of 24 bit levels are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	const unsigned char *level = image.GetLevels();
+	for (unsigned i = 0; i < image.levelCount; ++i)
+	{
+		GLsizei width = image.width >> i ? image.width >> i : 1;
+		GLsizei height = image.height >> i ? image.height >> i : 1;
+		GLsizei size = static_cast<GLsizei>(GetTextureLevelSize(image.format, width, height));
+		if (image.format == TEXTURE_BC1)
+			glCompressedTexImage2D(target, i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, width, height, 0, size, level);
+		else if (image.format == TEXTURE_BC3)
+			glCompressedTexImage2D(target, i, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, width, height, 0, size, level);
+		else if (image.format == TEXTURE_BGR)
+			glTexImage2D(target, i, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, level);
+		else
+			glTexImage2D(target, i, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, level);
+		level += size;
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-	bytesPerPixel	= header[16] / 8;						//divide by 8 to get bytes per pixel
-	imageSize		= width * height * bytesPerPixel;	// calculate memory required for TGA data
-	
-	data = new GLubyte[ imageSize ];
-	fileStream.seekg(18, std::ios::beg);
-	fileStream.read((char *)data, imageSize);
-	fileStream.close();	
+/******************************************************************************/
+/*!
+\brief
+Upload the levels of DecodeTGA into a texture with trilinear filtering; GL
+thread only
 
-	glGenTextures(1, &texture);
-	glGenerateMipmap(GL_TEXTURE_2D);
+\param image - levels from DecodeTGA
+\param texture - texture name to fill, 0 to generate a new one
+
+\return the texture
+*/
+/******************************************************************************/
+GLuint UploadTGA(const TGAImage &image, GLuint texture)
+{
+	if (texture == 0)
+		glGenTextures(1, &texture);
 	glBindTexture(GL_TEXTURE_2D, texture);
-	if(bytesPerPixel == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-	else //bytesPerPixel == 4
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+	UploadLevels(image, GL_TEXTURE_2D);
 
 	//to do: modify the texture parameters code from here
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	SetTextureMipmapping(texture, image.levelCount, true);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	float maxAnisotropy = 1.f;
 	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT,
 		&maxAnisotropy);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
-		(GLint)maxAnisotropy);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+		maxAnisotropy);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	//end of modifiable code
 
-	delete []data;
+	return texture;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Upload six images from DecodeTGA into a cube map texture with trilinear
+filtering; GL thread only. The faces must be square, of one size and
+with the same number of levels.
+
+\param faces - +X, -X, +Y, -Y, +Z, -Z as GL numbers them
+\param texture - texture name to fill, 0 to generate a new one
+
+\return the texture
+*/
+/******************************************************************************/
+GLuint UploadCubemap(const TGAImage faces[6], GLuint texture)
+{
+	if (texture == 0)
+		glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (unsigned face = 0; face < 6; ++face)
+		UploadLevels(faces[face], GL_TEXTURE_CUBE_MAP_POSITIVE_X + face);
+
+	SetTextureMipmapping(texture, faces[0].levelCount, true, GL_TEXTURE_CUBE_MAP);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	return texture;
+}
 
-	return texture;						
-}
\ No newline at end of file
+// Bytes of one level; block formats round the size up to whole 4x4 blocks
+size_t GetTextureLevelSize(unsigned format, unsigned width, unsigned height)
+{
+	size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case TEXTURE_BC1:
+		return blocks * TextureCompressor::BC1_BLOCK_SIZE;
+	case TEXTURE_BC3:
+		return blocks * TextureCompressor::BC3_BLOCK_SIZE;
+	case TEXTURE_BGR:
+		return static_cast<size_t>(width) * height * 3;
+	default:
+		return static_cast<size_t>(width) * height * 4;
+	}
+}
+
+// Compress the textures decoded from now on; off when the driver lacks S3TC
+void SetTextureCompression(bool enable)
+{
+	textureCompression = enable;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Sample a texture trilinearly from its mip chain, or from the top level only
+as the old loader did, to compare the cost; leaves the texture bound
+
+\param texture - texture from UploadTGA or UploadCubemap
+\param levelCount - levels it was uploaded with
+\param enable - false to sample the top level only
+\param target - GL_TEXTURE_CUBE_MAP for a cube map
+*/
+/******************************************************************************/
+void SetTextureMipmapping(GLuint texture, unsigned levelCount, bool enable, GLenum target)
+{
+	glBindTexture(target, texture);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, enable && levelCount > 0 ? levelCount - 1 : 0);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, enable ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
@@ -1,6 +1,50 @@
 #ifndef LOAD_TGA_H
 #define LOAD_TGA_H
 
-GLuint LoadTGA(const char *file_path);
+#include <memory>
+#include <vector>
 
-#endif
\ No newline at end of file
+class MappedFile;
+
+enum TEXTURE_FORMAT
+{
+	TEXTURE_BGR,  // 24 bit TGA as stored
+	TEXTURE_BGRA, // 32 bit TGA as stored
+	TEXTURE_BC1,  // 8 bytes per 4x4 block, no alpha
+	TEXTURE_BC3,  // 16 bytes per 4x4 block
+};
+
+// Every mip level of a TGA file, largest first, in the format it is uploaded in
+struct TGAImage
+{
+	unsigned width;
+	unsigned height;
+	unsigned bytesPerPixel; // of the file
+	unsigned format;        // TEXTURE_FORMAT
+	unsigned levelCount;
+	std::vector<unsigned char> data;
+
+	// Set instead of data when the levels were mapped from a .texbin
+	std::shared_ptr<MappedFile> file;
+	const unsigned char* fileData;
+	size_t fileSize;
+
+	TGAImage() : width(0), height(0), bytesPerPixel(0), format(TEXTURE_BGR), levelCount(0), fileData(nullptr), fileSize(0) {}
+	const unsigned char* GetLevels() const { return file ? fileData : data.data(); }
+	size_t GetSize() const { return file ? fileSize : data.size(); }
+};
+
+GLuint LoadTGA(const char *file_path, bool compress = true);
+
+// LoadTGA split in the file read, which needs no GL, and the upload
+bool DecodeTGA(const char *file_path, TGAImage &image, bool compress = true, unsigned quarterTurns = 0);
+GLuint UploadTGA(const TGAImage &image, GLuint texture = 0);
+
+// Faces in GL order: +X, -X, +Y, -Y, +Z, -Z
+GLuint UploadCubemap(const TGAImage faces[6], GLuint texture = 0);
+
+size_t GetTextureLevelSize(unsigned format, unsigned width, unsigned height);
+void SetTextureCompression(bool enable);
+void SetTextureMipmapping(GLuint texture, unsigned levelCount, bool enable, GLenum target = GL_TEXTURE_2D);
+
+#endif
@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+
+#include <windows.h>
+
+MappedFile::MappedFile()
+	: file(INVALID_HANDLE_VALUE)
+	, mapping(NULL)
+	, data(nullptr)
+	, size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Map a file for reading
+
+\param file_path - path of the file
+\return false if the file does not exist, is empty or cannot be mapped
+*/
+/******************************************************************************/
+bool MappedFile::Open(const std::string& file_path)
+{
+	Close();
+
+	file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+	data = nullptr;
+	size = 0;
+}
+
+const unsigned char* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+
+/******************************************************************************/
+/*!
+		Class MappedFile:
+\brief	Read-only memory mapping of a whole file. The bytes stay valid until
+		Close or the destructor, and the OS pages them in on first touch.
+*/
+/******************************************************************************/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& file_path);
+	void Close();
+
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	void* file;    // HANDLE of the file
+	void* mapping; // HANDLE of the file mapping
+	const unsigned char* data;
+	size_t size;
+};
+
+#endif
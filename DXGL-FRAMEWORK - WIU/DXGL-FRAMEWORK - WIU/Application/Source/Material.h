@@ -6,6 +6,8 @@
 #include <glm\gtc\matrix_transform.hpp>
 #include <glm\gtc\type_ptr.hpp>
 
+#include "Bounds.h"
+
 
 
 struct Material
@@ -15,6 +17,7 @@ struct Material
 	glm::vec3 kSpecular;
 	float kShininess;
 	int size; // Add this member to track the number of vertices using this material
+	Bounds bounds; // of the vertices this material draws, for culling its sub-range
 
 	Material() :
 		kAmbient(0.0f, 0.0f, 0.0f), kDiffuse(0.0f, 0.0f, 0.0f), kSpecular(0.0f, 0.0f, 0.0f),
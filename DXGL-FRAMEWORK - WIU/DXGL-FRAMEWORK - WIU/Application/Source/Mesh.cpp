@@ -1,12 +1,61 @@
-
 #include "Mesh.h"
 #include "GL\glew.h"
 #include "Vertex.h"
+#include "VertexFormat.h"
+#include "UniformCache.h"
+
+namespace
+{
+	// Map each DRAW_MODE to its GL primitive at compile time
+	template <Mesh::DRAW_MODE MODE> struct DrawModeTraits;
+	template <> struct DrawModeTraits<Mesh::DRAW_TRIANGLES> { static const GLenum primitive = GL_TRIANGLES; };
+	template <> struct DrawModeTraits<Mesh::DRAW_TRIANGLE_STRIP> { static const GLenum primitive = GL_TRIANGLE_STRIP; };
+	template <> struct DrawModeTraits<Mesh::DRAW_LINES> { static const GLenum primitive = GL_LINES; };
+
+	inline GLenum IndexType(unsigned indexByteSize)
+	{
+		return indexByteSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
+
+	template <Mesh::DRAW_MODE MODE>
+	void DrawRange(unsigned offset, unsigned count, unsigned, unsigned indexByteSize)
+	{
+		glDrawElements(DrawModeTraits<MODE>::primitive, count, IndexType(indexByteSize), (void*)(static_cast<size_t>(offset) * indexByteSize));
+	}
+
+	template <Mesh::DRAW_MODE MODE>
+	void DrawRangeInstanced(unsigned offset, unsigned count, unsigned instanceCount, unsigned indexByteSize)
+	{
+		glDrawElementsInstanced(DrawModeTraits<MODE>::primitive, count, IndexType(indexByteSize), (void*)(static_cast<size_t>(offset) * indexByteSize), instanceCount);
+	}
+
+	typedef void (*DrawFunc)(unsigned offset, unsigned count, unsigned instanceCount, unsigned indexByteSize);
+	const DrawFunc drawFuncs[Mesh::DRAW_MODE_LAST] =
+	{
+		DrawRange<Mesh::DRAW_TRIANGLES>,
+		DrawRange<Mesh::DRAW_TRIANGLE_STRIP>,
+		DrawRange<Mesh::DRAW_LINES>,
+	};
+	const DrawFunc drawInstancedFuncs[Mesh::DRAW_MODE_LAST] =
+	{
+		DrawRangeInstanced<Mesh::DRAW_TRIANGLES>,
+		DrawRangeInstanced<Mesh::DRAW_TRIANGLE_STRIP>,
+		DrawRangeInstanced<Mesh::DRAW_LINES>,
+	};
+
+	// Attribute locations of InstanceData in Texture.vertexshader
+	const GLuint INSTANCE_MODEL_LOCATION = 4; // a mat4 takes locations 4 to 7
+	const GLuint INSTANCE_COLOR_LOCATION = 8;
+}
+
+unsigned Mesh::boundVertexArray = 0;
+Mesh::MemoryStats Mesh::frameFetch = { 0, 0 };
+Mesh::MemoryStats Mesh::lastFrameFetch = { 0, 0 };
 
 /******************************************************************************/
 /*!
 \brief
-Default constructor - generate VBO/IBO here
+Default constructor - generate VAO/VBO/IBO here
 
 \param meshName - name of mesh
 */
@@ -14,8 +63,16 @@ Default constructor - generate VBO/IBO here
 Mesh::Mesh(const std::string& meshName)
 	: name(meshName)
 	, mode(DRAW_TRIANGLES)
+	, instanceBuffer(0)
+	, instanceCapacity(0)
+	, indexSize(0)
+	, vertexCount(0)
+	, vertexFormat(VERTEX_LIT_TEXTURED)
+	, indexByteSize(sizeof(GLuint))
+	, color(1.f, 1.f, 1.f)
 	, textureID(0)
 {
+	glGenVertexArrays(1, &vertexArray);
 	glGenBuffers(1, &vertexBuffer);
 	glGenBuffers(1, &indexBuffer);
 }
@@ -23,16 +80,39 @@ Mesh::Mesh(const std::string& meshName)
 /******************************************************************************/
 /*!
 \brief
-Destructor - delete VBO/IBO here
+Destructor - delete VAO/VBO/IBO here
 */
 /******************************************************************************/
 Mesh::~Mesh()
 {
+	// GL may hand the same name to the next VAO, so forget it if it is cached
+	if (boundVertexArray == vertexArray)
+		boundVertexArray = 0;
+	glDeleteVertexArrays(1, &vertexArray);
 	glDeleteBuffers(1, &vertexBuffer);
 	glDeleteBuffers(1, &indexBuffer);
+	if (instanceBuffer > 0)
+		glDeleteBuffers(1, &instanceBuffer);
+	for (const LodLevel& lod : lods)
+		delete lod.mesh;
 
-	if (textureID > 0)
-		glDeleteTextures(1, &textureID);
+	// textureID is not owned by the mesh; textures come from AssetCache
+}
+
+/******************************************************************************/
+/*!
+\brief
+Bind a VAO, skipping the call when it is already bound
+
+\param vao - vertex array object to bind, 0 to unbind
+*/
+/******************************************************************************/
+void Mesh::BindVertexArray(unsigned vao)
+{
+	if (boundVertexArray == vao)
+		return;
+	glBindVertexArray(vao);
+	boundVertexArray = vao;
 }
 
 /******************************************************************************/
@@ -43,58 +123,113 @@ OpenGL render code
 /******************************************************************************/
 void Mesh::Render()
 {
-	glEnableVertexAttribArray(0); // 1st attribute buffer : positions
-	glEnableVertexAttribArray(1); // 2nd attribute buffer : colors
-	glEnableVertexAttribArray(2); // 3rd attribute : normals
-	if (textureID > 0)
-		glEnableVertexAttribArray(3); // 4th attribute : texture coordinate
-
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(glm::vec3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-		(void*)(sizeof(glm::vec3) + sizeof(glm::vec3)));
-	if (textureID > 0)
-		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(void*)(sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec3)));
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	BindVertexArray(vertexArray);
+	Draw(0);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw only the materials the culling left visible
+
+\param visibleMaterials - one flag per material, nonzero to draw it
+*/
+/******************************************************************************/
+void Mesh::Render(const unsigned char* visibleMaterials)
+{
+	BindVertexArray(vertexArray);
+	Draw(0, visibleMaterials);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw count copies of the mesh in one call, each with its own model matrix
+and color. Needs a shader that reads the InstanceData attributes.
+
+\param instances - per-instance data
+\param count - number of instances
+*/
+/******************************************************************************/
+void Mesh::RenderInstanced(const InstanceData* instances, unsigned count)
+{
+	if (count == 0)
+		return;
+
+	BindVertexArray(vertexArray);
+	if (instanceBuffer == 0)
+	{
+		// Record the per-instance layout in this mesh's VAO
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (GLuint column = 0; column < 4; ++column)
+		{
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+				(void*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+		}
+		glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+		glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)sizeof(glm::mat4));
+		glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	}
+
+	if (count > instanceCapacity)
+	{
+		instanceCapacity = count;
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), instances, GL_STREAM_DRAW);
+	}
+	else
+	{
+		// Orphan the old storage so the driver does not wait on last frame's draw
+		glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+	}
+
+	Draw(count);
+}
+
+// instanceCount of 0 draws without instancing; visibleMaterials of nullptr draws every material
+void Mesh::Draw(unsigned instanceCount, const unsigned char* visibleMaterials)
+{
+	SetConstantAttributes();
+
+	// Each index and, at worst, each vertex it names is read once per instance
+	unsigned long long instances = instanceCount > 0 ? instanceCount : 1;
+	unsigned long long drawnIndices = 0;
+
+	DrawFunc draw = (instanceCount > 0 ? drawInstancedFuncs : drawFuncs)[mode];
 	if (materials.size() == 0)
 	{
-		if (mode == DRAW_TRIANGLE_STRIP)
-			glDrawElements(GL_TRIANGLE_STRIP, indexSize, GL_UNSIGNED_INT, 0);
-		else if (mode == DRAW_LINES)
-			glDrawElements(GL_LINES, indexSize, GL_UNSIGNED_INT, 0);
-		else
-			glDrawElements(GL_TRIANGLES, indexSize, GL_UNSIGNED_INT, 0);
+		draw(0, indexSize, instanceCount, indexByteSize);
+		drawnIndices = indexSize;
 	}
 	else
 	{
+		UniformCache* uniforms = UniformCache::GetInstance();
 		for (unsigned i = 0, offset = 0; i < materials.size(); ++i)
 		{
 			Material& material = materials[i];
-			glUniform3fv(locationKa, 1, &material.kAmbient.r);
-			glUniform3fv(locationKd, 1, &material.kDiffuse.r);
-			glUniform3fv(locationKs, 1, &material.kSpecular.r);
-			glUniform1f(locationNs, material.kShininess);
-			if (mode == DRAW_TRIANGLE_STRIP)
-				glDrawElements(GL_TRIANGLE_STRIP, material.size, GL_UNSIGNED_INT, (void*)(offset *
-					sizeof(unsigned)));
-			else if (mode == DRAW_LINES)
-				glDrawElements(GL_LINES, material.size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
-			else
-				glDrawElements(GL_TRIANGLES, material.size, GL_UNSIGNED_INT, (void*)(offset *
-					sizeof(unsigned)));
+			if (!visibleMaterials || visibleMaterials[i])
+			{
+				uniforms->Uniform3fv(locationKa, &material.kAmbient.r);
+				uniforms->Uniform3fv(locationKd, &material.kDiffuse.r);
+				uniforms->Uniform3fv(locationKs, &material.kSpecular.r);
+				uniforms->Uniform1f(locationNs, material.kShininess);
+				draw(offset, material.size, instanceCount, indexByteSize);
+				drawnIndices += material.size;
+			}
 			offset += material.size;
 		}
 	}
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
-
-	if (textureID > 0)
-		glDisableVertexAttribArray(3);
+	frameFetch.bytes += instances * drawnIndices * (indexByteSize + GetVertexStride(vertexFormat));
+	frameFetch.unpackedBytes += instances * drawnIndices * (sizeof(GLuint) + sizeof(Vertex));
 }
 
 unsigned Mesh::locationKa;
@@ -112,28 +247,87 @@ void Mesh::SetMaterialLoc(unsigned kA, unsigned kD, unsigned kS, unsigned nS)
 
 void Mesh::Render(unsigned offset, unsigned count)
 {
-	glEnableVertexAttribArray(0); // 1st attribute buffer : vertices
-	glEnableVertexAttribArray(1); // 2nd attribute buffer : colors
-	glEnableVertexAttribArray(2); // 3rd attribute buffer : normals
-	if (textureID > 0)
-		glEnableVertexAttribArray(3); // 4th attribute : texture coordinate
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(glm::vec3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) + sizeof(glm::vec3)));
-	if (textureID > 0)
-		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(void*)(sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec3)));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-	if (mode == DRAW_LINES)
-		glDrawElements(GL_LINES, count, GL_UNSIGNED_INT, (void*)(offset * sizeof(GLuint)));
-	else if (mode == DRAW_TRIANGLE_STRIP)
-		glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT, (void*)(offset * sizeof(GLuint)));
-	else
-		glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(offset * sizeof(GLuint)));
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
-	if (textureID > 0)
-		glDisableVertexAttribArray(3);
+	BindVertexArray(vertexArray);
+	SetConstantAttributes();
+	frameFetch.bytes += count * (indexByteSize + GetVertexStride(vertexFormat));
+	frameFetch.unpackedBytes += count * (sizeof(GLuint) + sizeof(Vertex));
+	drawFuncs[mode](offset, count, 0, indexByteSize);
+}
+
+// Attributes the VBO leaves out read GL's current value, which is not VAO state
+void Mesh::SetConstantAttributes()
+{
+	if (!(vertexFormat & VERTEX_COLOR))
+		glVertexAttrib3fv(VERTEX_COLOR_LOCATION, &color.r);
+	if (!(vertexFormat & VERTEX_NORMAL))
+		glVertexAttrib3f(VERTEX_NORMAL_LOCATION, 0.f, 0.f, 1.f);
+	if (!(vertexFormat & VERTEX_TEXCOORD))
+		glVertexAttrib2f(VERTEX_TEXCOORD_LOCATION, 0.f, 0.f);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Add a coarser level of detail; the mesh takes ownership of it. Levels must be
+added from finest to coarsest, each with a smaller maxScreenRadius.
+
+\param lod - mesh of the level, with the same bounds as this one
+\param maxScreenRadius - largest projected radius, in pixels, it is drawn at
+*/
+/******************************************************************************/
+void Mesh::AddLod(Mesh* lod, float maxScreenRadius)
+{
+	LodLevel level;
+	level.mesh = lod;
+	level.maxScreenRadius = maxScreenRadius;
+	lods.push_back(level);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Coarsest level of detail that still looks right at a projected size
+
+\param screenRadius - projected radius of the bounding sphere in pixels
+\return level for GetLod, 0 for this mesh
+*/
+/******************************************************************************/
+unsigned Mesh::SelectLod(float screenRadius) const
+{
+	unsigned level = 0;
+	while (level < lods.size() && screenRadius <= lods[level].maxScreenRadius)
+		++level;
+	return level;
+}
+
+Mesh* Mesh::GetLod(unsigned level)
+{
+	return level == 0 ? this : lods[level - 1].mesh;
+}
+
+// Levels of detail included
+Mesh::MemoryStats Mesh::GetBufferStats() const
+{
+	MemoryStats stats;
+	stats.bytes = (unsigned long long)vertexCount * GetVertexStride(vertexFormat) + (unsigned long long)indexSize * indexByteSize;
+	stats.unpackedBytes = (unsigned long long)vertexCount * sizeof(Vertex) + (unsigned long long)indexSize * sizeof(GLuint);
+	for (const LodLevel& lod : lods)
+	{
+		MemoryStats lodStats = lod.mesh->GetBufferStats();
+		stats.bytes += lodStats.bytes;
+		stats.unpackedBytes += lodStats.unpackedBytes;
+	}
+	return stats;
+}
+
+// Start counting the next frame's vertex and index reads
+void Mesh::EndFrame()
+{
+	lastFrameFetch = frameFetch;
+	frameFetch.bytes = frameFetch.unpackedBytes = 0;
+}
+
+const Mesh::MemoryStats& Mesh::GetLastFrameFetchStats()
+{
+	return lastFrameFetch;
 }
@@ -4,6 +4,9 @@
 #include <string>
 #include <vector>
 #include "Material.h"
+#include "Bounds.h"
+
+struct InstanceData;
 
 /******************************************************************************/
 /*!
@@ -21,10 +24,34 @@ public:
 		DRAW_LINES,
 		DRAW_MODE_LAST,
 	};
+	// Bytes the vertex and index buffers take and what the draws read from them,
+	// next to the same for 44 byte Vertex and 32 bit indices
+	struct MemoryStats
+	{
+		unsigned long long bytes;
+		unsigned long long unpackedBytes;
+	};
+	// A coarser copy of the mesh, drawn while the mesh's projected bounding
+	// sphere is at most maxScreenRadius pixels
+	struct LodLevel
+	{
+		Mesh* mesh;
+		float maxScreenRadius;
+	};
+
 	Mesh(const std::string& meshName);
 	~Mesh();
 	void Render();
 	static void SetMaterialLoc(unsigned kA, unsigned kD, unsigned kS, unsigned nS);
+	static void BindVertexArray(unsigned vao);
+
+	void AddLod(Mesh* lod, float maxScreenRadius);
+	unsigned SelectLod(float screenRadius) const;
+	Mesh* GetLod(unsigned level);
+
+	MemoryStats GetBufferStats() const;
+	static void EndFrame();
+	static const MemoryStats& GetLastFrameFetchStats();
 
 	std::vector<Material> materials;
 	static unsigned locationKa;
@@ -33,13 +60,31 @@ public:
 	static unsigned locationNs;
 	const std::string name;
 	DRAW_MODE mode;
+	unsigned vertexArray;
 	unsigned vertexBuffer;
 	unsigned indexBuffer;
+	unsigned instanceBuffer; // created on the first RenderInstanced
+	unsigned instanceCapacity;
 	unsigned indexSize;
+	unsigned vertexCount;
+	unsigned vertexFormat;   // VERTEX_FORMAT bits of the VBO
+	unsigned indexByteSize;  // 2 or 4
+	glm::vec3 color;         // vertex color when the format has none
+	Bounds bounds;           // of all vertices; each material has its own
+	std::vector<LodLevel> lods; // owned, finest first; empty for a single level
 	Material material;
 	unsigned textureID;
 
 	void Render(unsigned offset, unsigned count);
+	void Render(const unsigned char* visibleMaterials);
+	void RenderInstanced(const InstanceData* instances, unsigned count);
+
+private:
+	void Draw(unsigned instanceCount, const unsigned char* visibleMaterials = nullptr);
+	void SetConstantAttributes();
+
+	static unsigned boundVertexArray; // last VAO bound through BindVertexArray
+	static MemoryStats frameFetch, lastFrameFetch;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "MeshBin.h"
+#include "MeshBuilder.h"
+#include "MappedFile.h"
+#include "timer.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include <windows.h>
+
+namespace
+{
+	const char MESH_BIN_MAGIC[4] = { 'M', 'B', 'I', 'N' };
+	const unsigned MESH_BIN_VERSION = 5;
+	const unsigned MAX_LODS = 16;
+
+	// Layout: Header, Material[materialCount], then the vertices and indices
+	// packed as they are uploaded; then each level of detail as a LodHeader
+	// followed by its materials, vertices and indices the same way
+	struct Header
+	{
+		char magic[4];
+		unsigned version;
+		unsigned long long sourceHash;
+		unsigned vertexCount;
+		unsigned indexCount;
+		unsigned materialCount;
+		unsigned mode;
+		unsigned vertexFormat;
+		unsigned indexSize;
+		Bounds bounds;
+		unsigned lodCount;
+		unsigned padding;
+	};
+	static_assert(sizeof(Header) == 88, "MeshBin header layout changed, bump MESH_BIN_VERSION");
+
+	struct LodHeader
+	{
+		unsigned vertexCount;
+		unsigned indexCount;
+		unsigned materialCount;
+		float maxScreenRadius;
+	};
+
+	const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+	const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+	unsigned long long HashBytes(unsigned long long hash, const unsigned char* bytes, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	// Map one level's materials, vertices and indices into data; returns the
+	// end of the level, or nullptr if it runs past end
+	const unsigned char* MapLevel(const unsigned char* cursor, const unsigned char* end, unsigned vertexCount,
+		unsigned indexCount, unsigned materialCount, unsigned vertexFormat, MeshData& data)
+	{
+		size_t size = static_cast<size_t>(materialCount) * sizeof(Material)
+			+ static_cast<size_t>(vertexCount) * GetVertexStride(vertexFormat)
+			+ static_cast<size_t>(indexCount) * GetIndexSize(vertexCount);
+		if (static_cast<size_t>(end - cursor) < size)
+			return nullptr;
+
+		const Material* materials = reinterpret_cast<const Material*>(cursor);
+		data.materials.assign(materials, materials + materialCount);
+		cursor += materialCount * sizeof(Material);
+
+		data.fileVertices = cursor;
+		data.fileVertexCount = vertexCount;
+		cursor += vertexCount * GetVertexStride(vertexFormat);
+
+		data.fileIndices = cursor;
+		data.fileIndexCount = indexCount;
+		cursor += indexCount * GetIndexSize(vertexCount);
+
+		data.vertexFormat = vertexFormat;
+		data.vertices.clear();
+		data.indices.clear();
+		return cursor;
+	}
+
+	void WriteLevel(std::ofstream& fileStream, const MeshData& data)
+	{
+		unsigned vertexCount = data.GetVertexCount(), indexCount = data.GetIndexCount();
+		std::vector<unsigned char> vertices, indices;
+		PackVertices(data.vertices.data(), vertexCount, data.vertexFormat, vertices);
+		PackIndices(data.indices.data(), indexCount, GetIndexSize(vertexCount), indices);
+		fileStream.write(reinterpret_cast<const char*>(data.materials.data()), data.materials.size() * sizeof(Material));
+		fileStream.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+		fileStream.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Path of the cache file of an OBJ, e.g. Models//Door.obj -> Models//Door.meshbin
+
+\param obj_path - path of the OBJ file
+\return path of the .meshbin file
+*/
+/******************************************************************************/
+std::string MeshBin::GetPath(const std::string& obj_path)
+{
+	size_t dot = obj_path.find_last_of('.');
+	size_t slash = obj_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return obj_path + ".meshbin";
+	return obj_path.substr(0, dot) + ".meshbin";
+}
+
+/******************************************************************************/
+/*!
+\brief
+FNV-1a hash of the contents of the source files of a mesh, in order.
+A missing file hashes differently from an empty one.
+
+\param file_paths - paths of the OBJ and, if any, the MTL
+\return hash stored in the .meshbin
+*/
+/******************************************************************************/
+unsigned long long MeshBin::HashFiles(const std::vector<std::string>& file_paths)
+{
+	unsigned long long hash = FNV_OFFSET;
+	for (const std::string& file_path : file_paths)
+	{
+		MappedFile file;
+		unsigned char marker = file.Open(file_path) ? 1 : 0;
+		hash = HashBytes(hash, &marker, 1);
+		hash = HashBytes(hash, file.GetData(), file.GetSize());
+	}
+	return hash;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Map a .meshbin into data. The materials are copied; the vertices and indices
+of every level stay in the mapping, which data keeps open until it is
+destroyed.
+
+\param bin_path - path of the .meshbin file
+\param sourceHash - HashFiles of the current source files
+\param data - receives the mesh
+\return false if the file is missing, stale or damaged
+*/
+/******************************************************************************/
+bool MeshBin::Load(const std::string& bin_path, unsigned long long sourceHash, MeshData& data)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(bin_path) || file->GetSize() < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file->GetData(), sizeof(Header));
+	if (memcmp(header.magic, MESH_BIN_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != MESH_BIN_VERSION
+		|| header.sourceHash != sourceHash
+		|| header.indexSize != GetIndexSize(header.vertexCount)
+		|| header.lodCount > MAX_LODS)
+		return false;
+
+	// Filled in a copy, so a damaged file leaves data as it was for the OBJ parser
+	MeshData loaded;
+	const unsigned char* end = file->GetData() + file->GetSize();
+	const unsigned char* cursor = MapLevel(file->GetData() + sizeof(Header), end, header.vertexCount,
+		header.indexCount, header.materialCount, header.vertexFormat, loaded);
+	if (!cursor)
+		return false;
+
+	loaded.lods.resize(header.lodCount);
+	for (MeshData& lod : loaded.lods)
+	{
+		if (static_cast<size_t>(end - cursor) < sizeof(LodHeader))
+			return false;
+		LodHeader lodHeader;
+		memcpy(&lodHeader, cursor, sizeof(LodHeader));
+		cursor = MapLevel(cursor + sizeof(LodHeader), end, lodHeader.vertexCount, lodHeader.indexCount,
+			lodHeader.materialCount, header.vertexFormat, lod);
+		if (!cursor)
+			return false;
+		lod.mode = static_cast<Mesh::DRAW_MODE>(header.mode);
+		lod.maxScreenRadius = lodHeader.maxScreenRadius;
+		lod.file = file;
+	}
+	if (cursor != end)
+		return false;
+
+	loaded.mode = static_cast<Mesh::DRAW_MODE>(header.mode);
+	loaded.bounds = header.bounds;
+	loaded.file = file;
+	data = std::move(loaded);
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Write data as a .meshbin. The file is written under a temporary name and
+renamed, so a crash or another loader never sees half a file.
+
+\param bin_path - path of the .meshbin file
+\param sourceHash - HashFiles of the source files data was loaded from
+\param data - mesh as returned by the OBJ parser, not one mapped from a file
+\return false if the file could not be written
+*/
+/******************************************************************************/
+bool MeshBin::Save(const std::string& bin_path, unsigned long long sourceHash, const MeshData& data)
+{
+	Header header;
+	memcpy(header.magic, MESH_BIN_MAGIC, sizeof(header.magic));
+	header.version = MESH_BIN_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexCount = data.GetVertexCount();
+	header.indexCount = data.GetIndexCount();
+	header.materialCount = static_cast<unsigned>(data.materials.size());
+	header.mode = static_cast<unsigned>(data.mode);
+	header.vertexFormat = data.vertexFormat;
+	header.indexSize = GetIndexSize(header.vertexCount);
+	header.bounds = data.bounds;
+	header.lodCount = static_cast<unsigned>(data.lods.size());
+	header.padding = 0;
+
+	std::ostringstream tmp_path;
+	tmp_path << bin_path << '.' << GetCurrentThreadId() << ".tmp";
+
+	{
+		std::ofstream fileStream(tmp_path.str(), std::ios::binary | std::ios::trunc);
+		if (!fileStream.is_open())
+		{
+			std::cout << "Impossible to write " << tmp_path.str() << "\n";
+			return false;
+		}
+		fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		WriteLevel(fileStream, data);
+		for (const MeshData& lod : data.lods)
+		{
+			LodHeader lodHeader = { lod.GetVertexCount(), lod.GetIndexCount(),
+				static_cast<unsigned>(lod.materials.size()), lod.maxScreenRadius };
+			fileStream.write(reinterpret_cast<const char*>(&lodHeader), sizeof(lodHeader));
+			WriteLevel(fileStream, lod);
+		}
+		if (!fileStream.good())
+		{
+			fileStream.close();
+			DeleteFileA(tmp_path.str().c_str());
+			return false;
+		}
+	}
+
+	// Fails if a loader still has the old file mapped; the next load writes it
+	if (!MoveFileExA(tmp_path.str().c_str(), bin_path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tmp_path.str().c_str());
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Print cold and warm load times of every OBJ in a folder. Cold parses the OBJ
+and writes the .meshbin; warm is the average of loads from the .meshbin,
+hash check included. Neither uploads to GL.
+
+\param folder - folder with the OBJ files, ending in a separator
+*/
+/******************************************************************************/
+void MeshBin::Benchmark(const std::string& folder)
+{
+	const int WARM_RUNS = 10;
+
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((folder + "*.obj").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "No OBJ files in " << folder << "\n";
+		return;
+	}
+
+	StopWatch timer;
+	double totalCold = 0.0, totalWarm = 0.0;
+	std::cout << "MeshBin benchmark (" << WARM_RUNS << " warm runs)\n";
+	do
+	{
+		std::string obj_path = folder + found.cFileName;
+		std::string mtl_path = obj_path.substr(0, obj_path.size() - 4) + ".mtl";
+		bool hasMTL = GetFileAttributesA(mtl_path.c_str()) != INVALID_FILE_ATTRIBUTES;
+
+		DeleteFileA(GetPath(obj_path).c_str());
+
+		MeshData cold;
+		timer.startTimer();
+		bool loaded = hasMTL ? MeshBuilder::LoadOBJMTLData(obj_path, mtl_path, cold)
+			: MeshBuilder::LoadOBJData(obj_path, cold);
+		double coldTime = timer.getElapsedTime();
+		if (!loaded)
+			continue;
+
+		double warmTime = 0.0;
+		volatile unsigned char touched = 0;
+		for (int run = 0; run < WARM_RUNS; ++run)
+		{
+			MeshData warm;
+			timer.startTimer();
+			if (hasMTL)
+				MeshBuilder::LoadOBJMTLData(obj_path, mtl_path, warm);
+			else
+				MeshBuilder::LoadOBJData(obj_path, warm);
+			// Touch every page like glBufferData would
+			const unsigned char* bytes = warm.fileVertices;
+			for (size_t i = 0; bytes && i < warm.GetVertexCount() * GetVertexStride(warm.vertexFormat); i += 4096)
+				touched ^= bytes[i];
+			warmTime += timer.getElapsedTime();
+		}
+		warmTime /= WARM_RUNS;
+
+		totalCold += coldTime;
+		totalWarm += warmTime;
+		std::cout << "  " << found.cFileName << ": " << cold.GetVertexCount() << " vertices, cold "
+			<< coldTime * 1000.0 << " ms, warm " << warmTime * 1000.0 << " ms\n";
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+
+	std::cout << "  total: cold " << totalCold * 1000.0 << " ms, warm " << totalWarm * 1000.0 << " ms\n";
+}
@@ -0,0 +1,31 @@
+#ifndef MESH_BIN_H
+#define MESH_BIN_H
+
+#include <string>
+#include <vector>
+
+struct MeshData;
+
+/******************************************************************************/
+/*!
+		Class MeshBin:
+\brief	Binary cache of a loaded OBJ, written beside it as <name>.meshbin.
+		It holds the packed vertices and indices, the materials with
+		their index counts and the bounds, tagged with a hash of the source
+		files so an edited OBJ or MTL is parsed again. Loading maps the file
+		and hands its vertices and indices straight to glBufferData.
+*/
+/******************************************************************************/
+class MeshBin
+{
+public:
+	static std::string GetPath(const std::string& obj_path);
+	static unsigned long long HashFiles(const std::vector<std::string>& file_paths);
+
+	static bool Load(const std::string& bin_path, unsigned long long sourceHash, MeshData& data);
+	static bool Save(const std::string& bin_path, unsigned long long sourceHash, const MeshData& data);
+
+	static void Benchmark(const std::string& folder);
+};
+
+#endif
@@ -5,6 +5,171 @@
 #include <GL\glew.h>
 #include <vector>
 #include "LoadOBJ.h"
+#include "MeshBin.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include <cfloat>
+#include <iostream>
+
+/******************************************************************************/
+/*!
+\brief
+Upload packed vertex/index data into the mesh's VBO/IBO and record the vertex
+layout in the mesh's VAO, so Mesh::Render only has to bind the VAO and draw
+
+\param mesh - mesh whose VAO/VBO/IBO receive the data
+\param format - VERTEX_FORMAT bits of the vertices
+\param vertices - vertices packed by PackVertices
+\param vertexCount - number of vertices
+\param indices - indices packed by PackIndices for vertexCount
+\param indexCount - number of indices
+*/
+/******************************************************************************/
+static void UploadPackedMesh(Mesh* mesh, unsigned format, const unsigned char* vertices, unsigned vertexCount,
+	const unsigned char* indices, unsigned indexCount)
+{
+	unsigned indexByteSize = GetIndexSize(vertexCount);
+
+	Mesh::BindVertexArray(mesh->vertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * GetVertexStride(format), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexByteSize, indices, GL_STATIC_DRAW);
+
+	SetVertexAttributes(format);
+
+	// Unbind so later IBO binds cannot leak into this mesh's VAO
+	Mesh::BindVertexArray(0);
+
+	mesh->indexSize = indexCount;
+	mesh->vertexCount = vertexCount;
+	mesh->bounds = Bounds();
+	mesh->vertexFormat = format;
+	mesh->indexByteSize = indexByteSize;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Pack vertices and indices for the GPU and upload them. Shapes of one color
+leave the color out and set Mesh::color instead.
+
+\param mesh - mesh whose VAO/VBO/IBO receive the data
+\param format - VERTEX_FORMAT bits to keep; the rest of Vertex is dropped
+\param vertex_buffer_data - vertices to upload
+\param index_buffer_data - indices to upload
+*/
+/******************************************************************************/
+static void UploadMesh(Mesh* mesh, unsigned format, const std::vector<Vertex>& vertex_buffer_data,
+	const std::vector<GLuint>& index_buffer_data)
+{
+	unsigned vertexCount = static_cast<unsigned>(vertex_buffer_data.size());
+	unsigned indexCount = static_cast<unsigned>(index_buffer_data.size());
+	std::vector<unsigned char> vertices, indices;
+	PackVertices(vertex_buffer_data.data(), vertexCount, format, vertices);
+	PackIndices(index_buffer_data.data(), indexCount, GetIndexSize(vertexCount), indices);
+	UploadPackedMesh(mesh, format, vertices.data(), vertexCount, indices.data(), indexCount);
+	mesh->bounds = Bounds::Compute(vertex_buffer_data.data(), vertexCount, sizeof(Vertex));
+}
+
+bool MeshBuilder::optimizeOBJ = true;
+
+// Optimized and plain meshes of one OBJ must not load each other's .meshbin
+static unsigned long long OptimizeSalt(bool optimize)
+{
+	return optimize ? 0x6F7074696D697A65ULL : 0;
+}
+
+// Bounds of the vertices of data and of the index range of each material
+static void ComputeBounds(MeshData& data)
+{
+	if (data.vertices.empty())
+		return;
+
+	data.bounds = Bounds::Compute(data.vertices.data(), static_cast<unsigned>(data.vertices.size()), sizeof(Vertex));
+	unsigned offset = 0;
+	for (Material& material : data.materials)
+	{
+		unsigned count = static_cast<unsigned>(material.size);
+		if (offset + count > data.indices.size())
+			break;
+		material.bounds = Bounds::Compute(data.vertices.data(), sizeof(Vertex), data.indices.data() + offset, count);
+		offset += count;
+	}
+}
+
+// Levels of detail of the round shapes: each halves the slices and stacks of
+// the one before, down to LOD_MIN_SLICES and LOD_MIN_STACKS
+static const int LOD_LEVELS = 6;
+static const unsigned LOD_MIN_SLICES = 8;
+static const unsigned LOD_MIN_STACKS = 2;
+// Largest gap between a level's silhouette and the true curve
+static const float LOD_PIXEL_ERROR = 0.5f;
+
+// Projected radius up to which a curve cut into angleStep segments stays
+// within LOD_PIXEL_ERROR; a chord is off by 1 - cos(angleStep / 2) radii
+static float LodScreenRadius(float angleStep)
+{
+	return LOD_PIXEL_ERROR / (1.f - glm::cos(angleStep * 0.5f));
+}
+
+// OBJ meshes below this many indices are not worth a level of detail
+static const unsigned LOD_MIN_OBJ_INDICES = 300;
+
+/******************************************************************************/
+/*!
+\brief
+Simplify an OBJ mesh into levels of detail, each aiming at half the
+triangles of the one before. A level is used while the distance its
+collapses moved the surface, added up over the levels before it, projects
+to at most LOD_PIXEL_ERROR. Stops early when seams and borders, which are
+never collapsed, keep a level from getting much smaller.
+
+\param data - optimized mesh with its bounds; receives the levels
+\param name - name printed in the report
+*/
+/******************************************************************************/
+static void BuildLods(MeshData& data, const std::string& name)
+{
+	data.lods.clear();
+	if (data.mode != Mesh::DRAW_TRIANGLES || data.indices.size() < LOD_MIN_OBJ_INDICES || !data.bounds.IsValid())
+		return;
+
+	std::vector<unsigned> indices = data.indices;
+	std::vector<Material> materials = data.materials;
+	float error = 0.f;
+	float maxScreenRadius = FLT_MAX;
+	for (int level = 1; level < LOD_LEVELS; ++level)
+	{
+		size_t before = indices.size();
+		error += MeshSimplifier::Simplify(data.vertices, indices, materials, static_cast<unsigned>(before / 2));
+		if (indices.size() * 4 > before * 3 || indices.size() < LOD_MIN_OBJ_INDICES / 2)
+			break;
+
+		MeshData lod;
+		lod.vertices = data.vertices;
+		lod.indices = indices;
+		lod.materials = materials;
+		lod.mode = data.mode;
+		lod.vertexFormat = data.vertexFormat;
+		MeshOptimizer::OptimizeVertexFetch(lod.vertices, lod.indices);
+		ComputeBounds(lod);
+		if (error > 0.f)
+			maxScreenRadius = std::min(maxScreenRadius, LOD_PIXEL_ERROR * data.bounds.radius / error);
+		lod.maxScreenRadius = maxScreenRadius;
+		data.lods.push_back(lod);
+	}
+
+	if (!data.lods.empty())
+	{
+		std::cout << "Levels of detail of " << name << ": " << data.indices.size() / 3;
+		for (const MeshData& lod : data.lods)
+			std::cout << " -> " << lod.indices.size() / 3 << " (" << lod.maxScreenRadius << " px)";
+		std::cout << " triangles\n";
+	}
+}
 
 
 /******************************************************************************/
@@ -56,12 +221,8 @@ Mesh* MeshBuilder::GenerateAxes(const std::string& meshName, float
 
 	Mesh *mesh = new Mesh(meshName);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
+	UploadMesh(mesh, VERTEX_COLOR, vertex_buffer_data, index_buffer_data);
 
-	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_LINES;
 
 	return mesh;
@@ -119,18 +280,63 @@ Mesh* MeshBuilder::GenerateQuad(const std::string& meshName, glm::vec3
 	// Create the new mesh
 	Mesh* mesh = new Mesh(meshName);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
+	UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+	mesh->color = color;
 
-	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLES;
 
 	return mesh;
 }
+
 /******************************************************************************/
-Mesh* MeshBuilder::GenerateSphere(const std::string& meshName,
+/*!
+\brief
+Generate a quad like GenerateQuad, cut into a grid of cells so per vertex
+data such as baked light has points to vary over. The data stays on the CPU
+until UploadMeshData.
+
+\param color - vertex color
+\param length - width and height of the quad
+\param divisions - cells along each side
+\param data - receives the vertices, indices and bounds
+*/
+/******************************************************************************/
+void MeshBuilder::GenerateGridData(glm::vec3 color, float length, unsigned divisions, MeshData& data)
+{
+	data = MeshData();
+	divisions = divisions > 0 ? divisions : 1;
+
+	Vertex v;
+	v.color = color;
+	v.normal = glm::vec3(0, 0, 1);
+	for (unsigned y = 0; y <= divisions; ++y)
+	{
+		for (unsigned x = 0; x <= divisions; ++x)
+		{
+			v.texCoord = glm::vec2(static_cast<float>(x) / divisions, static_cast<float>(y) / divisions);
+			v.pos = glm::vec3((v.texCoord.x - 0.5f) * length, (v.texCoord.y - 0.5f) * length, 0.f);
+			data.vertices.push_back(v);
+		}
+	}
+
+	// Each cell as the two triangles of GenerateQuad, counter-clockwise from +Z
+	for (unsigned y = 0; y < divisions; ++y)
+	{
+		for (unsigned x = 0; x < divisions; ++x)
+		{
+			unsigned v00 = y * (divisions + 1) + x, v10 = v00 + 1;
+			unsigned v01 = v00 + divisions + 1, v11 = v01 + 1;
+			unsigned cell[6] = { v10, v11, v01, v10, v01, v00 };
+			data.indices.insert(data.indices.end(), cell, cell + 6);
+		}
+	}
+
+	data.mode = Mesh::DRAW_TRIANGLES;
+	data.vertexFormat = VERTEX_LIT_TEXTURED;
+	ComputeBounds(data);
+}
+/******************************************************************************/
+static Mesh* GenerateSphereLevel(const std::string& meshName,
 	glm::vec3 color, float radius, int numSlice, int numStack)
 {
 	Vertex v;
@@ -184,18 +390,45 @@ Mesh* MeshBuilder::GenerateSphere(const std::string& meshName,
 	// Create the new mesh
 	Mesh* mesh = new Mesh(meshName);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
+	UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+	mesh->color = color;
 
-	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
 	return mesh;
 
 }
 
+/******************************************************************************/
+/*!
+\brief
+Generate a UV sphere with its levels of detail
+
+\param meshName - name of mesh
+\param color - vertex color
+\param radius - radius of the sphere
+\param numSlice - slices of the finest level
+\param numStack - stacks of the finest level
+
+\return Pointer to mesh of the finest level, holding the coarser ones
+*/
+/******************************************************************************/
+Mesh* MeshBuilder::GenerateSphere(const std::string& meshName,
+	glm::vec3 color, float radius, int numSlice, int numStack)
+{
+	Mesh* mesh = GenerateSphereLevel(meshName, color, radius, numSlice, numStack);
+	for (int level = 1; level < LOD_LEVELS; ++level)
+	{
+		numSlice /= 2;
+		numStack /= 2;
+		if (numSlice < (int)LOD_MIN_SLICES || numStack < (int)LOD_MIN_STACKS)
+			break;
+		float angleStep = glm::max(glm::two_pi<float>() / numSlice, glm::pi<float>() / numStack);
+		mesh->AddLod(GenerateSphereLevel(meshName, color, radius, numSlice, numStack), LodScreenRadius(angleStep));
+	}
+	return mesh;
+}
+
 /******************************************************************************/
 Mesh* MeshBuilder::GenerateTriangularPrism(const std::string& meshName, glm::vec3 color,
     float base, float height, float depth)
@@ -345,14 +578,9 @@ Mesh* MeshBuilder::GenerateTriangularPrism(const std::string& meshName, glm::vec
 
     Mesh* mesh = new Mesh(meshName);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
 
-    mesh->indexSize = index_buffer_data.size();
     mesh->mode = Mesh::DRAW_TRIANGLES;
 
     return mesh;
@@ -534,14 +762,9 @@ Mesh* MeshBuilder::GenerateRectangularPrism(const std::string& meshName, glm::ve
 
     Mesh* mesh = new Mesh(meshName);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
 
-    mesh->indexSize = index_buffer_data.size();
     mesh->mode = Mesh::DRAW_TRIANGLES;
 
     return mesh;
@@ -549,7 +772,7 @@ Mesh* MeshBuilder::GenerateRectangularPrism(const std::string& meshName, glm::ve
 
 
 /******************************************************************************/
-Mesh* MeshBuilder::GenerateHemisphere(const std::string& meshName, glm::vec3 color,
+static Mesh* GenerateHemisphereLevel(const std::string& meshName, glm::vec3 color,
 	unsigned numStack, unsigned numSlice, float radius)
 {
 	Vertex v;
@@ -614,19 +837,44 @@ Mesh* MeshBuilder::GenerateHemisphere(const std::string& meshName, glm::vec3 col
 
 	Mesh* mesh = new Mesh(meshName);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-		&vertex_buffer_data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-		&index_buffer_data[0], GL_STATIC_DRAW);
+	UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+	mesh->color = color;
 
-	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
 	return mesh;
 }
 
+/******************************************************************************/
+/*!
+\brief
+Generate a hemisphere with a flat bottom and its levels of detail
+
+\param meshName - name of mesh
+\param color - vertex color
+\param numStack - stacks of the finest level
+\param numSlice - slices of the finest level
+\param radius - radius of the hemisphere
+
+\return Pointer to mesh of the finest level, holding the coarser ones
+*/
+/******************************************************************************/
+Mesh* MeshBuilder::GenerateHemisphere(const std::string& meshName, glm::vec3 color,
+	unsigned numStack, unsigned numSlice, float radius)
+{
+	Mesh* mesh = GenerateHemisphereLevel(meshName, color, numStack, numSlice, radius);
+	for (int level = 1; level < LOD_LEVELS; ++level)
+	{
+		numSlice /= 2;
+		numStack /= 2;
+		if (numSlice < LOD_MIN_SLICES || numStack < LOD_MIN_STACKS)
+			break;
+		float angleStep = glm::max(glm::two_pi<float>() / numSlice, glm::half_pi<float>() / numStack);
+		mesh->AddLod(GenerateHemisphereLevel(meshName, color, numStack, numSlice, radius), LodScreenRadius(angleStep));
+	}
+	return mesh;
+}
+
 /******************************************************************************/
 Mesh* MeshBuilder::GenerateCube(const std::string& meshName, glm::vec3 color, float length)
 {
@@ -769,21 +1017,16 @@ Mesh* MeshBuilder::GenerateCube(const std::string& meshName, glm::vec3 color, fl
 
     Mesh* mesh = new Mesh(meshName);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
 
-    mesh->indexSize = index_buffer_data.size();
     mesh->mode = Mesh::DRAW_TRIANGLES;
 
     return mesh;
 }
 
 /******************************************************************************/
-Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color,
+static Mesh* GenerateCylinderLevel(const std::string& meshName, glm::vec3 color,
     unsigned numSlice, float radius, float height)
 {
     Vertex v;
@@ -869,19 +1112,43 @@ Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color
 
     Mesh* mesh = new Mesh(meshName);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
 
-    mesh->indexSize = index_buffer_data.size();
     mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
     return mesh;
 }
 
+/******************************************************************************/
+/*!
+\brief
+Generate a capped cylinder with its levels of detail
+
+\param meshName - name of mesh
+\param color - vertex color
+\param numSlice - slices of the finest level
+\param radius - radius of the caps
+\param height - distance between the caps
+
+\return Pointer to mesh of the finest level, holding the coarser ones
+*/
+/******************************************************************************/
+Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color,
+    unsigned numSlice, float radius, float height)
+{
+    Mesh* mesh = GenerateCylinderLevel(meshName, color, numSlice, radius, height);
+    for (int level = 1; level < LOD_LEVELS; ++level)
+    {
+        numSlice /= 2;
+        if (numSlice < LOD_MIN_SLICES)
+            break;
+        mesh->AddLod(GenerateCylinderLevel(meshName, color, numSlice, radius, height),
+            LodScreenRadius(glm::two_pi<float>() / numSlice));
+    }
+    return mesh;
+}
+
 /******************************************************************************/
 Mesh* MeshBuilder::GenerateTrapezoidalPrism(const std::string& meshName, glm::vec3 color, float bottomWidth, float topWidth, float height, float depth)
 {
@@ -1038,21 +1305,16 @@ Mesh* MeshBuilder::GenerateTrapezoidalPrism(const std::string& meshName, glm::ve
 
     Mesh* mesh = new Mesh(meshName);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
 
-    mesh->indexSize = index_buffer_data.size();
     mesh->mode = Mesh::DRAW_TRIANGLES;
 
     return mesh;
 }
 
 /******************************************************************************/
-Mesh* MeshBuilder::GenerateHalfHemisphere(const std::string& meshName, glm::vec3 color,
+static Mesh* GenerateHalfHemisphereLevel(const std::string& meshName, glm::vec3 color,
     unsigned numStack, unsigned numSlice, float radius)
 {
     Vertex v;
@@ -1197,17 +1459,42 @@ Mesh* MeshBuilder::GenerateHalfHemisphere(const std::string& meshName, glm::vec3
     }
 
     Mesh* mesh = new Mesh(meshName);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex),
-        &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0], GL_STATIC_DRAW);
-    mesh->indexSize = index_buffer_data.size();
+    UploadMesh(mesh, VERTEX_LIT_TEXTURED, vertex_buffer_data, index_buffer_data);
+    mesh->color = color;
     mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
     return mesh;
 }
 
+/******************************************************************************/
+/*!
+\brief
+Generate a quarter sphere, closed by two flat faces, with its levels of detail
+
+\param meshName - name of mesh
+\param color - vertex color
+\param numStack - stacks of the finest level
+\param numSlice - slices of the finest level
+\param radius - radius of the shape
+
+\return Pointer to mesh of the finest level, holding the coarser ones
+*/
+/******************************************************************************/
+Mesh* MeshBuilder::GenerateHalfHemisphere(const std::string& meshName, glm::vec3 color,
+    unsigned numStack, unsigned numSlice, float radius)
+{
+    Mesh* mesh = GenerateHalfHemisphereLevel(meshName, color, numStack, numSlice, radius);
+    for (int level = 1; level < LOD_LEVELS; ++level)
+    {
+        numSlice /= 2;
+        numStack /= 2;
+        if (numSlice < LOD_MIN_SLICES || numStack < LOD_MIN_STACKS)
+            break;
+        float angleStep = glm::max(glm::pi<float>() / numSlice, glm::half_pi<float>() / numStack);
+        mesh->AddLod(GenerateHalfHemisphereLevel(meshName, color, numStack, numSlice, radius), LodScreenRadius(angleStep));
+    }
+    return mesh;
+}
+
 
 
 
@@ -1216,93 +1503,178 @@ Mesh* MeshBuilder::GenerateHalfHemisphere(const std::string& meshName, glm::vec3
 Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const
     std::string& file_path)
 {
-    // Read vertices, texcoords & normals from OBJ
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
-    bool success = LoadOBJ(file_path.c_str(), vertices, uvs, normals);
-
-    if (!success) { return NULL; }
-
-    // Index the vertices, texcoords & normals properly
-    std::vector<Vertex> vertex_buffer_data;
-    std::vector<GLuint> index_buffer_data;
-    IndexVBO(vertices, uvs, normals, index_buffer_data,
-        vertex_buffer_data);
-
+    MeshData data;
+    if (!LoadOBJData(file_path, data)) { return NULL; }
 
     Mesh* mesh = new Mesh(meshName);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() *
-        sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() *
-        sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
-    mesh->indexSize = index_buffer_data.size();
-    mesh->mode = Mesh::DRAW_TRIANGLES;
+    UploadMeshData(mesh, data);
     return mesh;
 }
 /******************************************************************************/
 
 Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path)
 {
-    //Read vertices, texcoords & normals from OBJ
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
-    std::vector<Material> materials;
-    bool success = LoadOBJMTL(file_path.c_str(), mtl_path.c_str(), vertices, uvs, normals, materials);
-    if (!success) return NULL;
-    //Index the vertices, texcoords & normals properly
-    std::vector<Vertex> vertex_buffer_data;
-    std::vector<GLuint> index_buffer_data;
-    IndexVBO(vertices, uvs, normals, index_buffer_data, vertex_buffer_data);
+    MeshData data;
+    if (!LoadOBJMTLData(file_path, mtl_path, data)) return NULL;
+
     Mesh* mesh = new Mesh(meshName);
-    for (Material& material : materials)
-        mesh->materials.push_back(material);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0],
-        GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0],
-        GL_STATIC_DRAW);
-    mesh->indexSize = index_buffer_data.size();
-    mesh->mode = Mesh::DRAW_TRIANGLES;
+    UploadMeshData(mesh, data);
     return mesh;
 }
 
+/******************************************************************************/
+/*!
+\brief
+Read and index an OBJ file without touching GL, so it can run on a loader
+thread; pass the result to UploadMeshData on the GL thread.
+The result is cached beside the OBJ as a .meshbin, which later loads map
+instead of parsing the OBJ again.
+
+\param file_path - path of the OBJ file
+\param data - receives the indexed vertices
+
+\return false if the file could not be read
+*/
+/******************************************************************************/
+bool MeshBuilder::LoadOBJData(const std::string& file_path, MeshData& data)
+{
+    // A .meshbin from the same OBJ skips the parse
+    std::string bin_path = MeshBin::GetPath(file_path);
+    unsigned long long hash = MeshBin::HashFiles(std::vector<std::string>(1, file_path)) ^ OptimizeSalt(optimizeOBJ);
+    if (MeshBin::Load(bin_path, hash, data)) { return true; }
+
+    // Read and index the vertices, texcoords & normals from OBJ
+    bool success = LoadOBJIndexed(file_path.c_str(), nullptr, data.indices, data.vertices, data.materials);
+
+    if (!success) { return false; }
+
+    data.mode = Mesh::DRAW_TRIANGLES;
+    if (optimizeOBJ)
+        MeshOptimizer::Optimize(data, file_path);
+    ComputeBounds(data);
+    if (optimizeOBJ)
+        BuildLods(data, file_path);
+    MeshBin::Save(bin_path, hash, data);
+    return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+LoadOBJData for an OBJ file with a material library
+
+\param file_path - path of the OBJ file
+\param mtl_path - path of the MTL file
+\param data - receives the indexed vertices and the materials
+
+\return false if either file could not be read
+*/
+/******************************************************************************/
+bool MeshBuilder::LoadOBJMTLData(const std::string& file_path, const std::string& mtl_path, MeshData& data)
+{
+    std::vector<std::string> sources;
+    sources.push_back(file_path);
+    sources.push_back(mtl_path);
+    std::string bin_path = MeshBin::GetPath(file_path);
+    unsigned long long hash = MeshBin::HashFiles(sources) ^ OptimizeSalt(optimizeOBJ);
+    if (MeshBin::Load(bin_path, hash, data)) return true;
+
+    //Read and index the vertices, texcoords & normals from OBJ
+    bool success = LoadOBJIndexed(file_path.c_str(), mtl_path.c_str(), data.indices, data.vertices, data.materials);
+    if (!success) return false;
+    data.mode = Mesh::DRAW_TRIANGLES;
+    if (optimizeOBJ)
+        MeshOptimizer::Optimize(data, file_path);
+    ComputeBounds(data);
+    if (optimizeOBJ)
+        BuildLods(data, file_path);
+    MeshBin::Save(bin_path, hash, data);
+    return true;
+}
+
+void MeshBuilder::SetOptimizeOBJ(bool optimize)
+{
+    optimizeOBJ = optimize;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Upload data from LoadOBJData or LoadOBJMTLData into a mesh; GL thread only
+
+\param mesh - mesh whose VAO/VBO/IBO receive the data
+\param data - indexed vertices and materials
+*/
+/******************************************************************************/
+void MeshBuilder::UploadMeshData(Mesh* mesh, const MeshData& data)
+{
+    for (const Material& material : data.materials)
+        mesh->materials.push_back(material);
+    if (data.file)
+        UploadPackedMesh(mesh, data.vertexFormat, data.fileVertices, data.fileVertexCount, data.fileIndices, data.fileIndexCount);
+    else
+        UploadMesh(mesh, data.vertexFormat, data.vertices, data.indices);
+    mesh->bounds = data.bounds;
+    mesh->mode = data.mode;
+    for (const MeshData& lod : data.lods)
+    {
+        Mesh* lodMesh = new Mesh(mesh->name);
+        UploadMeshData(lodMesh, lod);
+        lodMesh->bounds = mesh->bounds;
+        mesh->AddLod(lodMesh, lod.maxScreenRadius);
+    }
+}
+
+/******************************************************************************/
+/*!
+\brief
+Append the quad of one glyph of a numRow x numCol font texture, centred on
+the origin with unit size and a white vertex color
+
+\param vertex_buffer_data - vertices to append the 4 corners to
+\param row - row of the glyph in the font texture, counted from the top
+\param col - column of the glyph in the font texture
+\param numRow - number of rows in the font texture
+\param numCol - number of columns in the font texture
+*/
+/******************************************************************************/
+void MeshBuilder::GenerateGlyph(std::vector<Vertex>& vertex_buffer_data,
+    unsigned row, unsigned col, unsigned numRow, unsigned numCol)
+{
+    Vertex v;
+    float width = 1.f / numCol;
+    float height = 1.f / numRow;
+    v.color = glm::vec3(1.f, 1.f, 1.f);
+    v.normal = glm::vec3(0, 0, 1);
+
+    v.pos = glm::vec3(0.5f, 0.5f, 0.f);
+    v.texCoord = glm::vec2(width * (col + 1), height * (numRow - row));
+    vertex_buffer_data.push_back(v);
+
+    v.pos = glm::vec3(-0.5f, 0.5f, 0.f);
+    v.texCoord = glm::vec2(width * (col + 0), height * (numRow - row));
+    vertex_buffer_data.push_back(v);
+
+    v.pos = glm::vec3(-0.5f, -0.5f, 0.f);
+    v.texCoord = glm::vec2(width * (col + 0), height * (numRow - 1 - row));
+    vertex_buffer_data.push_back(v);
+
+    v.pos = glm::vec3(0.5f, -0.5f, 0.f);
+    v.texCoord = glm::vec2(width * (col + 1), height * (numRow - 1 - row));
+    vertex_buffer_data.push_back(v);
+}
+
 Mesh* MeshBuilder::GenerateText(const std::string& meshName,
     unsigned numRow, unsigned numCol)
 {
-    Vertex v;
     std::vector<Vertex> vertex_buffer_data;
     std::vector<unsigned> index_buffer_data;
-    float width = 1.f / numCol;
-    float height = 1.f / numRow;
     unsigned offset = 0;
     for (unsigned row = 0; row < numRow; ++row)
     {
         for (unsigned col = 0; col < numCol; ++col)
         {
-            v.pos = glm::vec3(0.5f, 0.5f, 0.f);
-            v.normal = glm::vec3(0, 0, 1);
-            v.texCoord = glm::vec2(width * (col + 1), height * (numRow - row));
-            vertex_buffer_data.push_back(v);
-           
-            v.pos = glm::vec3(-0.5f, 0.5f, 0.f);
-            v.normal = glm::vec3(0, 0, 1);
-            v.texCoord = glm::vec2(width * (col + 0), height * (numRow - row));
-            vertex_buffer_data.push_back(v);
-            
-            v.pos = glm::vec3(-0.5f, -0.5f, 0.f);
-            v.normal = glm::vec3(0, 0, 1);
-            v.texCoord = glm::vec2(width * (col + 0), height * (numRow - 1 - row));
-            vertex_buffer_data.push_back(v);
-           
-            v.pos = glm::vec3(0.5f, -0.5f, 0.f);
-            v.normal = glm::vec3(0, 0, 1);
-            v.texCoord = glm::vec2(width * (col + 1), height * (numRow - 1 - row));
-            vertex_buffer_data.push_back(v);
+            GenerateGlyph(vertex_buffer_data, row, col, numRow, numCol);
 
             index_buffer_data.push_back(0 + offset);
             index_buffer_data.push_back(1 + offset);
@@ -1316,16 +1688,7 @@ Mesh* MeshBuilder::GenerateText(const std::string& meshName,
         }
     }
     Mesh* mesh = new Mesh(meshName);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() *
-        sizeof(Vertex), &vertex_buffer_data[0],
-        GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        index_buffer_data.size() * sizeof(GLuint),
-        &index_buffer_data[0],
-        GL_STATIC_DRAW);
+    UploadMesh(mesh, VERTEX_TEXCOORD, vertex_buffer_data, index_buffer_data);
     mesh->mode = Mesh::DRAW_TRIANGLES;
-    mesh->indexSize = index_buffer_data.size();
     return mesh;
 }
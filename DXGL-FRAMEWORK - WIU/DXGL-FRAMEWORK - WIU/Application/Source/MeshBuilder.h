@@ -3,7 +3,45 @@
 
 #include "Mesh.h"
 #include "Vertex.h"
+#include "VertexFormat.h"
 #include "LoadOBJ.h"
+#include "MappedFile.h"
+
+#include <memory>
+
+/******************************************************************************/
+/*!
+		Struct MeshData:
+\brief	Vertices, indices and materials of a mesh before they are uploaded.
+		When it came from a .meshbin there are no vertices and indices:
+		fileVertices and fileIndices point at the packed buffers in the
+		mapped file, which stays open as long as the data.
+		OBJ meshes carry their simplified levels of detail in lods.
+*/
+/******************************************************************************/
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned> indices;
+	std::vector<Material> materials;
+	Mesh::DRAW_MODE mode;
+	unsigned vertexFormat; // VERTEX_FORMAT bits the mesh is uploaded with
+	Bounds bounds; // of all vertices; the materials carry their own
+	std::vector<MeshData> lods; // coarser levels, finest first
+	float maxScreenRadius;      // of a level, see Mesh::LodLevel
+
+	std::shared_ptr<MappedFile> file; // set by MeshBin::Load
+	const unsigned char* fileVertices; // GetVertexStride(vertexFormat) bytes each
+	const unsigned char* fileIndices;  // GetIndexSize(fileVertexCount) bytes each
+	unsigned fileVertexCount;
+	unsigned fileIndexCount;
+
+	MeshData() : mode(Mesh::DRAW_TRIANGLES), vertexFormat(VERTEX_LIT_TEXTURED), maxScreenRadius(0.f),
+		fileVertices(nullptr), fileIndices(nullptr), fileVertexCount(0), fileIndexCount(0) {}
+
+	unsigned GetVertexCount() const { return file ? fileVertexCount : static_cast<unsigned>(vertices.size()); }
+	unsigned GetIndexCount() const { return file ? fileIndexCount : static_cast<unsigned>(indices.size()); }
+};
 
 /******************************************************************************/
 /*!
@@ -31,11 +69,23 @@ public:
 	static Mesh* GenerateOBJ(const std::string& meshName, const std::string& file_path);
 	static Mesh* GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path);
 
+	// Loading split in a GL free part and the upload, for AsyncLoader
+	static bool LoadOBJData(const std::string& file_path, MeshData& data);
+	static bool LoadOBJMTLData(const std::string& file_path, const std::string& mtl_path, MeshData& data);
+	static void UploadMeshData(Mesh* mesh, const MeshData& data);
 
-	static Mesh* GenerateText(const std::string& meshName, unsigned numRow, unsigned numCol);
-	
+	// GenerateQuad cut into divisions x divisions cells, kept on the CPU, e.g. for LightBaker
+	static void GenerateGridData(glm::vec3 color, float length, unsigned divisions, MeshData& data);
+
+	// Weld, reorder and build levels of detail of OBJ meshes when they are parsed; on by default
+	static void SetOptimizeOBJ(bool optimize);
 
 
+	static Mesh* GenerateText(const std::string& meshName, unsigned numRow, unsigned numCol);
+	static void GenerateGlyph(std::vector<Vertex>& vertex_buffer_data, unsigned row, unsigned col, unsigned numRow, unsigned numCol);
+	
+private:
+	static bool optimizeOBJ;
 };
 
 #endif
\ No newline at end of file
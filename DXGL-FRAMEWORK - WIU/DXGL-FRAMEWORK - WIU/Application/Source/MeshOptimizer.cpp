@@ -0,0 +1,435 @@
+#include "MeshOptimizer.h"
+#include "MeshBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+	// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	const int FORSYTH_CACHE_SIZE = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	float VertexScore(int cachePosition, unsigned valence)
+	{
+		if (valence == 0)
+			return -1.f; // no triangle left to use it
+
+		float score = 0.f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+				score = LAST_TRIANGLE_SCORE; // used by the last triangle
+			else
+				score = std::pow(1.f - (cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		return score + VALENCE_BOOST_SCALE * std::pow(float(valence), -VALENCE_BOOST_POWER);
+	}
+
+	// Bitwise hash and compare of vertices stored in a vector, keyed by index
+	struct VertexHash
+	{
+		const std::vector<Vertex>* vertices;
+
+		size_t operator()(unsigned index) const
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&(*vertices)[index]);
+			unsigned long long hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < sizeof(Vertex); ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	struct VertexEqual
+	{
+		const std::vector<Vertex>* vertices;
+
+		bool operator()(unsigned a, unsigned b) const
+		{
+			return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+		}
+	};
+
+	struct Cluster
+	{
+		unsigned begin; // first index
+		unsigned end;
+		float sortKey;
+	};
+}
+
+/******************************************************************************/
+/*!
+\brief
+Weld, reorder for the vertex cache and for overdraw, then for vertex fetch,
+and print the cache miss ratio before and after. Meshes mapped from a
+.meshbin are already optimized and left alone.
+
+\param data - triangle list from the OBJ loader
+\param name - name printed in the report
+*/
+/******************************************************************************/
+void MeshOptimizer::Optimize(MeshData& data, const std::string& name)
+{
+	if (data.file || data.indices.empty() || data.mode != Mesh::DRAW_TRIANGLES)
+		return;
+
+	unsigned vertexCountBefore = static_cast<unsigned>(data.vertices.size());
+	CacheStats before = AnalyzeVertexCache(data.indices.data(), static_cast<unsigned>(data.indices.size()), vertexCountBefore);
+
+	WeldVertices(data.vertices, data.indices);
+
+	// Mesh::Draw walks the materials from index 0; whatever they do not cover
+	// is one more range
+	std::vector<unsigned> rangeEnds;
+	unsigned total = 0;
+	for (const Material& material : data.materials)
+	{
+		total = std::min(total + static_cast<unsigned>(material.size), static_cast<unsigned>(data.indices.size()));
+		rangeEnds.push_back(total);
+	}
+	rangeEnds.push_back(static_cast<unsigned>(data.indices.size()));
+
+	unsigned begin = 0;
+	for (unsigned end : rangeEnds)
+	{
+		unsigned count = (end - begin) / 3 * 3;
+		if (count > 0)
+		{
+			OptimizeVertexCache(&data.indices[begin], count, static_cast<unsigned>(data.vertices.size()));
+			OptimizeOverdraw(&data.indices[begin], count, data.vertices, 1.05f);
+		}
+		begin = end;
+	}
+
+	OptimizeVertexFetch(data.vertices, data.indices);
+
+	CacheStats after = AnalyzeVertexCache(data.indices.data(), static_cast<unsigned>(data.indices.size()),
+		static_cast<unsigned>(data.vertices.size()));
+	std::cout << "Optimized " << name << ": " << vertexCountBefore << " -> " << data.vertices.size()
+		<< " vertices, ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+}
+
+/******************************************************************************/
+/*!
+\brief
+Merge vertices that are equal bit for bit, in one pass through a hash map.
+Vertices keep the order in which they first appear.
+
+\param vertices - vertices; the duplicates are removed
+\param indices - indices; remapped to the welded vertices
+*/
+/******************************************************************************/
+void MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned>& indices)
+{
+	VertexHash hash = { &vertices };
+	VertexEqual equal = { &vertices };
+	std::unordered_map<unsigned, unsigned, VertexHash, VertexEqual> firstOf(vertices.size() * 2, hash, equal);
+
+	std::vector<unsigned> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (unsigned i = 0; i < vertices.size(); ++i)
+	{
+		std::pair<std::unordered_map<unsigned, unsigned, VertexHash, VertexEqual>::iterator, bool> inserted =
+			firstOf.insert(std::make_pair(i, static_cast<unsigned>(welded.size())));
+		if (inserted.second)
+			welded.push_back(vertices[i]);
+		remap[i] = inserted.first->second;
+	}
+
+	if (welded.size() == vertices.size())
+		return;
+
+	for (unsigned& index : indices)
+		index = remap[index];
+	vertices.swap(welded);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Reorder triangles so their vertices are still in the post-transform cache
+when they are used again, greedily taking the best scored triangle next
+
+\param indices - triangle list to reorder in place
+\param indexCount - number of indices, a multiple of 3
+\param vertexCount - number of vertices the indices refer to
+*/
+/******************************************************************************/
+void MeshOptimizer::OptimizeVertexCache(unsigned* indices, unsigned indexCount, unsigned vertexCount)
+{
+	unsigned triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Triangles of each vertex, packed; valence counts those not yet emitted
+	std::vector<unsigned> valence(vertexCount, 0);
+	for (unsigned i = 0; i < indexCount; ++i)
+		++valence[indices[i]];
+
+	std::vector<unsigned> offsets(vertexCount + 1, 0);
+	for (unsigned v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + valence[v];
+
+	std::vector<unsigned> adjacency(indexCount);
+	std::vector<unsigned> filled(offsets.begin(), offsets.end() - 1);
+	for (unsigned i = 0; i < indexCount; ++i)
+		adjacency[filled[indices[i]]++] = i / 3;
+
+	std::vector<float> vertexScore(vertexCount);
+	for (unsigned v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(-1, valence[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (unsigned t = 0; t < triangleCount; ++t)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	int best = static_cast<int>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	std::vector<unsigned> output;
+	output.reserve(indexCount);
+	std::vector<unsigned> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	unsigned cursor = 0;
+
+	for (unsigned emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		if (best < 0)
+		{
+			// Nothing in the cache has triangles left; continue in input order
+			while (emitted[cursor])
+				++cursor;
+			best = static_cast<int>(cursor);
+		}
+
+		const unsigned* triangle = indices + best * 3;
+		emitted[best] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned v = triangle[k];
+			unsigned* first = &adjacency[offsets[v]];
+			unsigned* last = first + valence[v] - 1;
+			*std::find(first, last + 1, static_cast<unsigned>(best)) = *last;
+			--valence[v];
+		}
+
+		// The triangle's vertices move to the front of the cache
+		nextCache.assign(triangle, triangle + 3);
+		for (unsigned v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+		}
+
+		for (unsigned i = 0; i < nextCache.size(); ++i)
+		{
+			unsigned v = nextCache[i];
+			int position = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+			float score = VertexScore(position, valence[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+			for (unsigned j = offsets[v]; j < offsets[v] + valence[v]; ++j)
+				triangleScore[adjacency[j]] += delta;
+		}
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+
+		// Only triangles of cached vertices changed score enough to matter
+		best = -1;
+		float bestScore = -1.f;
+		for (unsigned v : cache)
+		{
+			for (unsigned j = offsets[v]; j < offsets[v] + valence[v]; ++j)
+			{
+				unsigned t = adjacency[j];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = static_cast<int>(t);
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Cut the cache ordered triangles into clusters where the cache starts over and
+draw the clusters facing out from the mesh first, so the depth test rejects
+more of what is behind them. The order is kept if it costs more than
+threshold times the cache misses.
+
+\param indices - cache optimized triangle list to reorder in place
+\param indexCount - number of indices, a multiple of 3
+\param vertices - vertices the indices refer to
+\param threshold - allowed growth of the ACMR, e.g. 1.05
+*/
+/******************************************************************************/
+void MeshOptimizer::OptimizeOverdraw(unsigned* indices, unsigned indexCount, const std::vector<Vertex>& vertices, float threshold)
+{
+	unsigned triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// A triangle whose three vertices all miss the cache starts a cluster
+	std::vector<Cluster> clusters;
+	std::vector<unsigned> timestamp(vertices.size(), 0);
+	unsigned time = CACHE_SIZE + 1;
+	for (unsigned t = 0; t < triangleCount; ++t)
+	{
+		unsigned misses = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned v = indices[t * 3 + k];
+			if (time - timestamp[v] > CACHE_SIZE)
+			{
+				timestamp[v] = time++;
+				++misses;
+			}
+		}
+		if (t == 0 || misses == 3)
+		{
+			Cluster cluster = { t * 3, t * 3, 0.f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().end = t * 3 + 3;
+	}
+	if (clusters.size() < 2)
+		return;
+
+	// Area weighted centroid and normal of each cluster and of the mesh
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+	std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+	for (unsigned c = 0; c < clusters.size(); ++c)
+	{
+		glm::vec3 centroid(0.f), normal(0.f);
+		float area = 0.f;
+		for (unsigned i = clusters[c].begin; i < clusters[c].end; i += 3)
+		{
+			const glm::vec3& a = vertices[indices[i]].pos;
+			const glm::vec3& b = vertices[indices[i + 1]].pos;
+			const glm::vec3& d = vertices[indices[i + 2]].pos;
+			glm::vec3 cross = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + d) * (triangleArea / 3.f);
+			normal += cross;
+			area += triangleArea;
+		}
+		centroids[c] = area > 0.f ? centroid / area : centroid;
+		float length = glm::length(normal);
+		normals[c] = length > 0.f ? normal / length : normal;
+		meshCentroid += centroid;
+		meshArea += area;
+	}
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	for (unsigned c = 0; c < clusters.size(); ++c)
+		clusters[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned> sorted;
+	sorted.reserve(indexCount);
+	for (const Cluster& cluster : clusters)
+		sorted.insert(sorted.end(), indices + cluster.begin, indices + cluster.end);
+
+	unsigned vertexCount = static_cast<unsigned>(vertices.size());
+	float before = AnalyzeVertexCache(indices, indexCount, vertexCount).acmr;
+	float after = AnalyzeVertexCache(sorted.data(), indexCount, vertexCount).acmr;
+	if (after <= before * threshold)
+		std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Renumber the vertices in the order the indices first use them, so the vertex
+fetch reads the buffer front to back. Unused vertices are dropped.
+
+\param vertices - vertices to reorder
+\param indices - indices; remapped to the new order
+*/
+/******************************************************************************/
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned>& indices)
+{
+	const unsigned UNUSED = ~0u;
+	std::vector<unsigned> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (unsigned& index : indices)
+	{
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = static_cast<unsigned>(ordered.size());
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Simulate a FIFO post-transform cache of CACHE_SIZE entries over a triangle
+list
+
+\param indices - triangle list
+\param indexCount - number of indices
+\param vertexCount - number of vertices the indices refer to
+\return ACMR and ATVR of the list
+*/
+/******************************************************************************/
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned* indices, unsigned indexCount, unsigned vertexCount)
+{
+	CacheStats stats = { 0.f, 0.f };
+	if (indexCount < 3)
+		return stats;
+
+	std::vector<unsigned> timestamp(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned time = CACHE_SIZE + 1;
+	unsigned misses = 0, unique = 0;
+	for (unsigned i = 0; i < indexCount; ++i)
+	{
+		unsigned v = indices[i];
+		if (time - timestamp[v] > CACHE_SIZE)
+		{
+			timestamp[v] = time++;
+			++misses;
+		}
+		if (!used[v])
+		{
+			used[v] = true;
+			++unique;
+		}
+	}
+
+	stats.acmr = float(misses) / (indexCount / 3);
+	stats.atvr = unique > 0 ? float(misses) / unique : 0.f;
+	return stats;
+}
@@ -0,0 +1,41 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+struct MeshData;
+
+/******************************************************************************/
+/*!
+		Class MeshOptimizer:
+\brief	Import time clean up of indexed triangle lists. Welding merges equal
+		vertices; the reorder passes change the order of triangles and
+		vertices but never which triangles there are, and keep every
+		material's triangles inside its own index range.
+*/
+/******************************************************************************/
+class MeshOptimizer
+{
+public:
+	// Post-transform cache statistics of an index range, for a FIFO cache
+	struct CacheStats
+	{
+		float acmr; // vertices transformed per triangle, 0.5 at best and 3 at worst
+		float atvr; // vertices transformed per unique vertex, 1 at best
+	};
+
+	static const unsigned CACHE_SIZE = 16;
+
+	static void Optimize(MeshData& data, const std::string& name);
+
+	static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned>& indices);
+	static void OptimizeVertexCache(unsigned* indices, unsigned indexCount, unsigned vertexCount);
+	static void OptimizeOverdraw(unsigned* indices, unsigned indexCount, const std::vector<Vertex>& vertices, float threshold);
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned>& indices);
+	static CacheStats AnalyzeVertexCache(const unsigned* indices, unsigned indexCount, unsigned vertexCount);
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "MeshSimplifier.h"
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const int MAX_PASSES = 100;
+	// Error a pass accepts grows as THRESHOLD_SCALE * (pass + 3) ^ THRESHOLD_POWER,
+	// for a mesh scaled to a unit bounding sphere
+	const double THRESHOLD_SCALE = 1e-9;
+	const double THRESHOLD_POWER = 7.0;
+	// A moved triangle may shrink to this fraction of its area before it counts as degenerate
+	const float MIN_AREA_RATIO = 1e-3f;
+
+	// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+	// a2 ab ac ad / b2 bc bd / c2 cd / d2
+	struct Quadric
+	{
+		double q[10];
+
+		Quadric() { std::fill(q, q + 10, 0.0); }
+
+		void AddPlane(double a, double b, double c, double d)
+		{
+			q[0] += a * a; q[1] += a * b; q[2] += a * c; q[3] += a * d;
+			q[4] += b * b; q[5] += b * c; q[6] += b * d;
+			q[7] += c * c; q[8] += c * d;
+			q[9] += d * d;
+		}
+
+		void Add(const Quadric& other)
+		{
+			for (int i = 0; i < 10; ++i)
+				q[i] += other.q[i];
+		}
+
+		double Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+				+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+				+ q[7] * z * z + 2.0 * q[8] * z
+				+ q[9];
+		}
+	};
+
+	struct Triangle
+	{
+		unsigned v[3];
+		unsigned range; // material the triangle belongs to
+		bool removed;
+	};
+
+	bool Contains(const Triangle& triangle, unsigned vertex)
+	{
+		return triangle.v[0] == vertex || triangle.v[1] == vertex || triangle.v[2] == vertex;
+	}
+
+	class Collapser
+	{
+	public:
+		Collapser(const std::vector<glm::vec3>& positions, std::vector<Triangle>& triangles)
+			: positions(positions)
+			, triangles(triangles)
+			, quadrics(positions.size())
+			, locked(positions.size(), 0)
+			, dirty(positions.size(), 0)
+		{
+		}
+
+		void BuildQuadrics()
+		{
+			for (const Triangle& triangle : triangles)
+			{
+				const glm::vec3& p0 = positions[triangle.v[0]];
+				glm::vec3 normal = glm::cross(positions[triangle.v[1]] - p0, positions[triangle.v[2]] - p0);
+				float length = glm::length(normal);
+				if (length <= 0.f)
+					continue;
+				normal /= length;
+				double d = -glm::dot(normal, p0);
+				for (unsigned corner = 0; corner < 3; ++corner)
+					quadrics[triangle.v[corner]].AddPlane(normal.x, normal.y, normal.z, d);
+			}
+		}
+
+		// Seams, open borders and material boundaries stay where they are
+		void LockVertices()
+		{
+			// Vertices split at a seam share their position
+			std::vector<unsigned> byPosition(positions.size());
+			for (unsigned i = 0; i < byPosition.size(); ++i)
+				byPosition[i] = i;
+			const std::vector<glm::vec3>& p = positions;
+			std::sort(byPosition.begin(), byPosition.end(), [&p](unsigned a, unsigned b) {
+				if (p[a].x != p[b].x) return p[a].x < p[b].x;
+				if (p[a].y != p[b].y) return p[a].y < p[b].y;
+				return p[a].z < p[b].z;
+			});
+			for (unsigned i = 1; i < byPosition.size(); ++i)
+			{
+				if (p[byPosition[i]] == p[byPosition[i - 1]])
+					locked[byPosition[i]] = locked[byPosition[i - 1]] = 1;
+			}
+
+			// An edge only one triangle uses is on a border
+			std::vector<unsigned long long> edges;
+			edges.reserve(triangles.size() * 3);
+			const unsigned NO_RANGE = ~0u;
+			std::vector<unsigned> rangeOf(positions.size(), NO_RANGE);
+			for (const Triangle& triangle : triangles)
+			{
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					unsigned a = triangle.v[corner], b = triangle.v[(corner + 1) % 3];
+					edges.push_back((static_cast<unsigned long long>(std::min(a, b)) << 32) | std::max(a, b));
+					if (rangeOf[a] == NO_RANGE)
+						rangeOf[a] = triangle.range;
+					else if (rangeOf[a] != triangle.range)
+						locked[a] = 1;
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			for (unsigned i = 0; i < edges.size();)
+			{
+				unsigned end = i + 1;
+				while (end < edges.size() && edges[end] == edges[i])
+					++end;
+				if (end - i == 1)
+				{
+					locked[static_cast<unsigned>(edges[i] >> 32)] = 1;
+					locked[static_cast<unsigned>(edges[i] & 0xFFFFFFFF)] = 1;
+				}
+				i = end;
+			}
+		}
+
+		// Largest error of a collapse, squared, in the units of the positions
+		double Run(unsigned targetTriangles)
+		{
+			unsigned live = static_cast<unsigned>(triangles.size());
+			double maxCost = 0.0;
+			for (int pass = 0; pass < MAX_PASSES && live > targetTriangles; ++pass)
+			{
+				BuildAdjacency();
+				std::fill(dirty.begin(), dirty.end(), 0);
+				double threshold = THRESHOLD_SCALE * std::pow(pass + 3.0, THRESHOLD_POWER);
+
+				for (unsigned t = 0; t < triangles.size() && live > targetTriangles; ++t)
+				{
+					const Triangle& triangle = triangles[t];
+					if (triangle.removed || dirty[triangle.v[0]] || dirty[triangle.v[1]] || dirty[triangle.v[2]])
+						continue;
+
+					for (unsigned edge = 0; edge < 6; ++edge)
+					{
+						// Each edge is tried in both directions
+						unsigned from = triangle.v[edge % 3];
+						unsigned to = triangle.v[(edge % 3 + (edge < 3 ? 1 : 2)) % 3];
+						if (locked[from])
+							continue;
+
+						Quadric combined = quadrics[from];
+						combined.Add(quadrics[to]);
+						double cost = std::max(combined.Evaluate(positions[to]), 0.0);
+						if (cost > threshold || Flips(from, to))
+							continue;
+
+						live -= Collapse(from, to);
+						quadrics[to] = combined;
+						maxCost = std::max(maxCost, cost);
+						break;
+					}
+				}
+			}
+			return maxCost;
+		}
+
+	private:
+		void BuildAdjacency()
+		{
+			offsets.assign(positions.size() + 1, 0);
+			for (const Triangle& triangle : triangles)
+			{
+				if (!triangle.removed)
+					for (unsigned corner = 0; corner < 3; ++corner)
+						++offsets[triangle.v[corner] + 1];
+			}
+			for (unsigned i = 0; i < positions.size(); ++i)
+				offsets[i + 1] += offsets[i];
+
+			adjacency.resize(offsets.back());
+			std::vector<unsigned> cursor(offsets.begin(), offsets.end() - 1);
+			for (unsigned t = 0; t < triangles.size(); ++t)
+			{
+				if (!triangles[t].removed)
+					for (unsigned corner = 0; corner < 3; ++corner)
+						adjacency[cursor[triangles[t].v[corner]]++] = t;
+			}
+		}
+
+		// Whether moving from onto to turns over or flattens a triangle that stays
+		bool Flips(unsigned from, unsigned to) const
+		{
+			for (unsigned i = offsets[from]; i < offsets[from + 1]; ++i)
+			{
+				const Triangle& triangle = triangles[adjacency[i]];
+				if (triangle.removed || Contains(triangle, to))
+					continue;
+
+				glm::vec3 before[3], after[3];
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					before[corner] = positions[triangle.v[corner]];
+					after[corner] = triangle.v[corner] == from ? positions[to] : before[corner];
+				}
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				if (glm::dot(normalBefore, normalAfter) <= 0.f
+					|| glm::length(normalAfter) < MIN_AREA_RATIO * glm::length(normalBefore))
+					return true;
+			}
+			return false;
+		}
+
+		// Move from onto to; returns the number of triangles that collapsed
+		unsigned Collapse(unsigned from, unsigned to)
+		{
+			unsigned removed = 0;
+			dirty[from] = dirty[to] = 1;
+			for (unsigned i = offsets[from]; i < offsets[from + 1]; ++i)
+			{
+				Triangle& triangle = triangles[adjacency[i]];
+				if (triangle.removed)
+					continue;
+				for (unsigned corner = 0; corner < 3; ++corner)
+					dirty[triangle.v[corner]] = 1;
+				if (Contains(triangle, to))
+				{
+					triangle.removed = true;
+					++removed;
+					continue;
+				}
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					if (triangle.v[corner] == from)
+						triangle.v[corner] = to;
+				}
+			}
+			return removed;
+		}
+
+		const std::vector<glm::vec3>& positions;
+		std::vector<Triangle>& triangles;
+		std::vector<Quadric> quadrics;
+		std::vector<unsigned char> locked;
+		std::vector<unsigned char> dirty; // touched this pass, so its adjacency is stale
+		std::vector<unsigned> offsets;    // triangles of vertex i are adjacency[offsets[i]..offsets[i + 1])
+		std::vector<unsigned> adjacency;
+	};
+}
+
+/******************************************************************************/
+/*!
+\brief
+Collapse edges, cheapest first in rounds of growing error, until about
+targetIndexCount indices are left or nothing more can go. Each material keeps
+its own index range; a range that loses every triangle is left empty.
+
+\param vertices - vertices the indices refer to; not changed
+\param indices - triangle list, replaced by the simplified one
+\param materials - index ranges of indices, resized to match
+\param targetIndexCount - number of indices to aim for
+\return largest distance a collapse moved the surface by, in model units
+*/
+/******************************************************************************/
+float MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, std::vector<unsigned>& indices,
+	std::vector<Material>& materials, unsigned targetIndexCount)
+{
+	if (vertices.empty() || indices.size() < 3)
+		return 0.f;
+
+	// Work on a unit sphere so the thresholds do not depend on the model's size
+	Bounds bounds = Bounds::Compute(vertices.data(), static_cast<unsigned>(vertices.size()), sizeof(Vertex));
+	float scale = bounds.radius > 0.f ? 1.f / bounds.radius : 1.f;
+	std::vector<glm::vec3> positions(vertices.size());
+	for (unsigned i = 0; i < vertices.size(); ++i)
+		positions[i] = (vertices[i].pos - bounds.center) * scale;
+
+	// Mesh::Draw walks the materials from index 0; whatever they do not cover
+	// is one more range
+	std::vector<unsigned> rangeEnds;
+	unsigned total = 0;
+	for (const Material& material : materials)
+	{
+		total = std::min(total + static_cast<unsigned>(material.size), static_cast<unsigned>(indices.size()));
+		rangeEnds.push_back(total);
+	}
+	rangeEnds.push_back(static_cast<unsigned>(indices.size()));
+
+	std::vector<Triangle> triangles;
+	triangles.reserve(indices.size() / 3);
+	unsigned begin = 0;
+	for (unsigned range = 0; range < rangeEnds.size(); ++range)
+	{
+		for (unsigned i = begin; i + 3 <= rangeEnds[range]; i += 3)
+		{
+			Triangle triangle = { { indices[i], indices[i + 1], indices[i + 2] }, range, false };
+			triangles.push_back(triangle);
+		}
+		begin = rangeEnds[range];
+	}
+
+	Collapser collapser(positions, triangles);
+	collapser.BuildQuadrics();
+	collapser.LockVertices();
+	double maxCost = collapser.Run(targetIndexCount / 3);
+
+	// Triangles stay in their range and in their order
+	std::vector<unsigned> simplified;
+	simplified.reserve(indices.size());
+	std::vector<unsigned> rangeSizes(rangeEnds.size(), 0);
+	for (const Triangle& triangle : triangles)
+	{
+		if (triangle.removed)
+			continue;
+		simplified.insert(simplified.end(), triangle.v, triangle.v + 3);
+		rangeSizes[triangle.range] += 3;
+	}
+	for (unsigned i = 0; i < materials.size(); ++i)
+		materials[i].size = rangeSizes[i];
+	indices.swap(simplified);
+
+	return static_cast<float>(std::sqrt(maxCost)) / scale;
+}
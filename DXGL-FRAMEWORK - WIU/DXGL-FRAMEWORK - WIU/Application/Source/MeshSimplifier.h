@@ -0,0 +1,27 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "Material.h"
+#include "Vertex.h"
+
+/******************************************************************************/
+/*!
+		Class MeshSimplifier:
+\brief	Import time decimation of indexed triangle lists by quadric error
+		edge collapse (Garland and Heckbert). A vertex only ever moves onto
+		a neighbour, so the result indexes the same vertices. Vertices on
+		a UV or normal seam, on an open border or shared by two materials
+		are never moved, which keeps the seams and the material ranges as
+		they were.
+*/
+/******************************************************************************/
+class MeshSimplifier
+{
+public:
+	static float Simplify(const std::vector<Vertex>& vertices, std::vector<unsigned>& indices,
+		std::vector<Material>& materials, unsigned targetIndexCount);
+};
+
+#endif
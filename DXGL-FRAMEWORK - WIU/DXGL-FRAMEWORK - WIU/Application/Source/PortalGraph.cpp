@@ -0,0 +1,226 @@
+#include "PortalGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Clip space w below which a corner counts as behind the camera
+	const float MIN_W = 1e-4f;
+}
+
+PortalGraph::PortalGraph()
+	: visibleCount(0)
+{
+}
+
+PortalGraph::~PortalGraph()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Add a cell
+
+\param boxMin - lower corner of the cell's box in world space
+\param boxMax - upper corner of the cell's box in world space
+\return index of the cell
+*/
+/******************************************************************************/
+unsigned PortalGraph::AddCell(const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	Cell cell;
+	cell.boxMin = boxMin;
+	cell.boxMax = boxMax;
+	cells.push_back(cell);
+	visible.push_back(0);
+	onPath.push_back(0);
+	return static_cast<unsigned>(cells.size() - 1);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Join two cells with a portal, closed until SetPortalOpen
+
+\param cellA - cell on one side
+\param cellB - cell on the other side
+\param corners - the portal's quad in world space, in order around it
+\return index of the portal
+*/
+/******************************************************************************/
+unsigned PortalGraph::AddPortal(unsigned cellA, unsigned cellB, const glm::vec3 corners[4])
+{
+	Portal portal;
+	portal.cells[0] = cellA;
+	portal.cells[1] = cellB;
+	std::copy(corners, corners + 4, portal.corners);
+	portal.open = false;
+	portals.push_back(portal);
+
+	unsigned index = static_cast<unsigned>(portals.size() - 1);
+	cells[cellA].portals.push_back(index);
+	cells[cellB].portals.push_back(index);
+	return index;
+}
+
+void PortalGraph::SetPortalOpen(unsigned portal, bool open)
+{
+	portals[portal].open = open;
+}
+
+void PortalGraph::Clear()
+{
+	cells.clear();
+	portals.clear();
+	visible.clear();
+	onPath.clear();
+	visibleCount = 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Find the visible cells for a camera. When the camera is in no cell there is
+nothing to look through, so every cell counts as visible.
+
+\param view - camera view matrix
+\param projection - camera projection matrix
+\param cameraPosition - camera position in world space
+*/
+/******************************************************************************/
+void PortalGraph::Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition)
+{
+	unsigned cameraCell = static_cast<unsigned>(cells.size());
+	for (unsigned i = 0; i < cells.size(); ++i)
+	{
+		if (glm::all(glm::greaterThanEqual(cameraPosition, cells[i].boxMin))
+			&& glm::all(glm::lessThanEqual(cameraPosition, cells[i].boxMax)))
+		{
+			cameraCell = i;
+			break;
+		}
+	}
+
+	if (cameraCell == cells.size())
+	{
+		std::fill(visible.begin(), visible.end(), 1);
+		visibleCount = static_cast<unsigned>(cells.size());
+		return;
+	}
+
+	std::fill(visible.begin(), visible.end(), 0);
+	visibleCount = 0;
+	Rect screen = { glm::vec2(-1.f), glm::vec2(1.f) };
+	Visit(cameraCell, screen, projection * view);
+}
+
+bool PortalGraph::IsCellVisible(unsigned cell) const
+{
+	return cell < visible.size() && visible[cell] != 0;
+}
+
+unsigned PortalGraph::GetCellCount() const
+{
+	return static_cast<unsigned>(cells.size());
+}
+
+unsigned PortalGraph::GetVisibleCellCount() const
+{
+	return visibleCount;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Mark a cell visible and look through each of its open portals, narrowed to
+the part of the screen the portal covers inside rect. A cell already on the
+chain is not entered again, so loops of cells end.
+
+\param cell - cell to enter
+\param rect - part of the screen the cell is seen through
+\param viewProjection - projection * view
+*/
+/******************************************************************************/
+void PortalGraph::Visit(unsigned cell, const Rect& rect, const glm::mat4& viewProjection)
+{
+	if (!visible[cell])
+	{
+		visible[cell] = 1;
+		++visibleCount;
+	}
+
+	onPath[cell] = 1;
+	for (unsigned portalIndex : cells[cell].portals)
+	{
+		const Portal& portal = portals[portalIndex];
+		unsigned next = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+		if (!portal.open || onPath[next])
+			continue;
+
+		Rect portalRect;
+		if (!ProjectPortal(portal, viewProjection, portalRect))
+			continue;
+		portalRect.min = glm::max(portalRect.min, rect.min);
+		portalRect.max = glm::min(portalRect.max, rect.max);
+		if (portalRect.min.x < portalRect.max.x && portalRect.min.y < portalRect.max.y)
+			Visit(next, portalRect, viewProjection);
+	}
+	onPath[cell] = 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Screen rectangle around a portal. A portal the camera stands in, with
+corners on both sides of the camera plane, covers the whole screen.
+
+\param portal - portal to project
+\param viewProjection - projection * view
+\param rect - receives the rectangle in normalised device coordinates
+\return false if the portal is off screen
+*/
+/******************************************************************************/
+bool PortalGraph::ProjectPortal(const Portal& portal, const glm::mat4& viewProjection, Rect& rect) const
+{
+	glm::vec4 clip[4];
+	unsigned behind = 0;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		clip[i] = viewProjection * glm::vec4(portal.corners[i], 1.f);
+		if (clip[i].w < MIN_W)
+			++behind;
+	}
+	if (behind == 4)
+		return false;
+
+	// Off screen when every corner is outside the same side of the frustum
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		bool allBelow = true, allAbove = true;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			allBelow = allBelow && clip[i][axis] < -clip[i].w;
+			allAbove = allAbove && clip[i][axis] > clip[i].w;
+		}
+		if (allBelow || allAbove)
+			return false;
+	}
+
+	if (behind > 0)
+	{
+		rect.min = glm::vec2(-1.f);
+		rect.max = glm::vec2(1.f);
+		return true;
+	}
+
+	rect.min = glm::vec2(1.f);
+	rect.max = glm::vec2(-1.f);
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		glm::vec2 ndc = glm::vec2(clip[i]) / clip[i].w;
+		rect.min = glm::min(rect.min, ndc);
+		rect.max = glm::max(rect.max, ndc);
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+#ifndef PORTAL_GRAPH_H
+#define PORTAL_GRAPH_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <vector>
+
+/******************************************************************************/
+/*!
+		Class PortalGraph:
+\brief	Cell-and-portal visibility. Cells are boxes, e.g. rooms; portals are
+		the quads that join two cells, e.g. doorways. Each frame the cell
+		holding the camera is visible, and from there every cell seen
+		through a chain of open portals, each portal narrowing the screen
+		rectangle the next one is looked through. A closed portal hides
+		everything behind it.
+*/
+/******************************************************************************/
+class PortalGraph
+{
+public:
+	PortalGraph();
+	~PortalGraph();
+
+	unsigned AddCell(const glm::vec3& boxMin, const glm::vec3& boxMax);
+	unsigned AddPortal(unsigned cellA, unsigned cellB, const glm::vec3 corners[4]);
+	void SetPortalOpen(unsigned portal, bool open);
+	void Clear();
+
+	void Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition);
+	bool IsCellVisible(unsigned cell) const;
+	unsigned GetCellCount() const;
+	unsigned GetVisibleCellCount() const;
+
+private:
+	// Part of the screen in normalised device coordinates
+	struct Rect
+	{
+		glm::vec2 min;
+		glm::vec2 max;
+	};
+
+	struct Cell
+	{
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		std::vector<unsigned> portals;
+	};
+
+	struct Portal
+	{
+		unsigned cells[2];
+		glm::vec3 corners[4];
+		bool open;
+	};
+
+	void Visit(unsigned cell, const Rect& rect, const glm::mat4& viewProjection);
+	bool ProjectPortal(const Portal& portal, const glm::mat4& viewProjection, Rect& rect) const;
+
+	std::vector<Cell> cells;
+	std::vector<Portal> portals;
+	std::vector<unsigned char> visible;
+	std::vector<unsigned char> onPath; // cells of the portal chain being walked
+	unsigned visibleCount;
+};
+
+#endif
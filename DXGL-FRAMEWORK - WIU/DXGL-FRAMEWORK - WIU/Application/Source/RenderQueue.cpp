@@ -0,0 +1,603 @@
+#include "RenderQueue.h"
+#include "GL\glew.h"
+#include "UniformCache.h"
+
+// GLM Headers
+#include <glm\gtc\type_ptr.hpp>
+#include <glm\gtc\matrix_inverse.hpp>
+
+#include <algorithm>
+
+namespace
+{
+	// Bit layout of the sort key, most significant first
+	//   opaque:      pass(1) | program(7) | texture(16) | material(16) | depth(24)
+	//   transparent: pass(1) | far-to-near depth(24) | program(7) | texture(16) | material(16)
+	const unsigned long long PROGRAM_MASK = 0x7F;
+	const unsigned long long TEXTURE_MASK = 0xFFFF;
+	const unsigned long long MATERIAL_MASK = 0xFFFF;
+	const unsigned long long DEPTH_MASK = 0xFFFFFF;
+
+	const unsigned char LOD_CULLED = 0xFF;
+
+	unsigned HashMaterial(const Material& material)
+	{
+		// FNV-1a over the shading terms; size only matters to multi-material meshes
+		const unsigned char* bytes[] = {
+			reinterpret_cast<const unsigned char*>(&material.kAmbient),
+			reinterpret_cast<const unsigned char*>(&material.kDiffuse),
+			reinterpret_cast<const unsigned char*>(&material.kSpecular),
+			reinterpret_cast<const unsigned char*>(&material.kShininess),
+		};
+		const unsigned sizes[] = { sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(float) };
+		unsigned hash = 2166136261u;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			for (unsigned j = 0; j < sizes[i]; ++j)
+			{
+				hash ^= bytes[i][j];
+				hash *= 16777619u;
+			}
+		}
+		return hash ^ (hash >> 16);
+	}
+
+	bool SameMaterial(const Material& lhs, const Material& rhs)
+	{
+		return lhs.kAmbient == rhs.kAmbient && lhs.kDiffuse == rhs.kDiffuse &&
+			lhs.kSpecular == rhs.kSpecular && lhs.kShininess == rhs.kShininess;
+	}
+}
+
+RenderQueue::RenderQueue()
+	: variants(nullptr)
+	, lightKey(0)
+	, useVariants(true)
+	, currentProgram(0)
+	, maxDepth(1000.f)
+	, cullingEnabled(false)
+	, cameraView(1.f)
+	, lodScale(0.f)
+{
+	stats = Stats();
+	cullStats = CullStats();
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Select the program used by subsequent Submit calls that have no shader
+variant
+
+\param programID - shader program returned by LoadShaders
+*/
+/******************************************************************************/
+void RenderQueue::SetProgram(unsigned programID)
+{
+	currentProgram = FindProgram(programID);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw with the variants of the program's shader pair where one is built
+
+\param variants - variants of the pair set with SetProgram, nullptr for none;
+	must outlive the queue's use of it
+*/
+/******************************************************************************/
+void RenderQueue::SetVariants(const ShaderVariants* variants)
+{
+	this->variants = variants;
+	variantPrograms.clear();
+}
+
+// Lights of the frame, which pick the lit variants; set before the submits
+void RenderQueue::SetLightKey(unsigned lightKey)
+{
+	this->lightKey = lightKey;
+}
+
+// Switch between the variants and the program of SetProgram, e.g. to compare them
+void RenderQueue::SetUseVariants(bool use)
+{
+	useVariants = use;
+}
+
+bool RenderQueue::IsUsingVariants() const
+{
+	return useVariants;
+}
+
+// Index of a program in programs, looking up its uniforms the first time it is seen
+unsigned RenderQueue::FindProgram(unsigned programID)
+{
+	for (unsigned i = 0; i < programs.size(); ++i)
+	{
+		if (programs[i].programID == programID)
+			return i;
+	}
+
+	Program program;
+	program.programID = programID;
+	program.parameters[U_MVP] = glGetUniformLocation(programID, "MVP");
+	program.parameters[U_MODELVIEW] = glGetUniformLocation(programID, "MV");
+	program.parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(programID, "MV_inverse_transpose");
+	program.parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(programID, "material.kAmbient");
+	program.parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(programID, "material.kDiffuse");
+	program.parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(programID, "material.kSpecular");
+	program.parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(programID, "material.kShininess");
+	program.parameters[U_LIGHTENABLED] = glGetUniformLocation(programID, "lightEnabled");
+	program.parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(programID, "colorTextureEnabled");
+	program.parameters[U_COLOR_TEXTURE] = glGetUniformLocation(programID, "colorTexture");
+	program.parameters[U_INSTANCING_ENABLED] = glGetUniformLocation(programID, "instancingEnabled");
+
+	programs.push_back(program);
+	return programs.size() - 1;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Program of a draw: the variant for its key if one is built, else the one set
+with SetProgram
+
+\param enableLight - whether the draw is lit
+\param textureID - its texture, 0 for none
+\param instanced - whether it is an instanced draw
+\return index into programs
+*/
+/******************************************************************************/
+unsigned RenderQueue::SelectProgram(bool enableLight, unsigned textureID, bool instanced)
+{
+	if (!variants || !useVariants)
+		return currentProgram;
+
+	unsigned features = (enableLight ? ShaderVariants::LIT : 0) | (textureID > 0 ? ShaderVariants::TEXTURED : 0)
+		| (instanced ? ShaderVariants::INSTANCED : 0);
+	unsigned key = ShaderVariants::MakeKey(features, lightKey);
+
+	std::map<unsigned, unsigned>::const_iterator it = variantPrograms.find(key);
+	if (it != variantPrograms.end())
+		return it->second;
+	unsigned programID = variants->Get(key);
+	if (programID == 0)
+		return currentProgram;
+
+	unsigned index = FindProgram(programID);
+	variantPrograms[key] = index;
+	return index;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set the view distance mapped to the far end of the depth bits in the sort
+key; should match the far plane of the projection
+
+\param depth - distance from the camera
+*/
+/******************************************************************************/
+void RenderQueue::SetMaxDepth(float depth)
+{
+	maxDepth = depth;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set the camera subsequent submits are culled against and pick their level
+of detail for
+
+\param view - camera view matrix
+\param projection - camera projection matrix
+\param viewportHeight - height of the viewport in pixels
+*/
+/******************************************************************************/
+void RenderQueue::SetCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+{
+	frustum.Set(projection * view);
+	cullingEnabled = true;
+	cameraView = view;
+	lodScale = projection[1][1] * viewportHeight * 0.5f;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Level of detail of a mesh for the projected radius of its bounding sphere
+
+\param mesh - mesh to draw
+\param model - world matrix
+\return level for Mesh::GetLod
+*/
+/******************************************************************************/
+unsigned RenderQueue::SelectLod(Mesh* mesh, const glm::mat4& model)
+{
+	if (mesh->lods.empty() || !cullingEnabled || !mesh->bounds.IsValid())
+		return 0;
+
+	float distance = -(cameraView * model * glm::vec4(mesh->bounds.center, 1.f)).z;
+	float radius = mesh->bounds.GetWorldRadius(model);
+	// The camera is inside the sphere, so it is as large as it gets
+	if (distance <= radius)
+		return 0;
+
+	unsigned level = mesh->SelectLod(radius * lodScale / distance);
+	if (level > 0)
+		++cullStats.coarserLods;
+	return level;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Test the material sub-ranges of a visible mesh on their own, so a large
+multi-material model only draws the parts in view
+
+\param mesh - mesh to test
+\param model - world matrix
+\param materialOffset - receives the index of the flags in visibleMaterials,
+	or ~0u when every material is drawn
+\return false if no sub-range is visible
+*/
+/******************************************************************************/
+bool RenderQueue::CullMaterials(Mesh* mesh, const glm::mat4& model, unsigned& materialOffset)
+{
+	materialOffset = ~0u;
+	if (!cullingEnabled || mesh->materials.size() < 2)
+		return true;
+
+	unsigned offset = visibleMaterials.size();
+	unsigned culled = 0;
+	for (const Material& material : mesh->materials)
+	{
+		bool visible = frustum.IsVisible(material.bounds, model);
+		visibleMaterials.push_back(visible ? 1 : 0);
+		if (!visible)
+			++culled;
+	}
+
+	if (culled == 0 || culled == mesh->materials.size())
+	{
+		visibleMaterials.resize(offset);
+		return culled == 0;
+	}
+	cullStats.culledMaterials += culled;
+	materialOffset = offset;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a mesh for drawing at the end of the frame. The mesh's material and
+texture are copied, so the caller may change them for the next submit.
+
+\param mesh - mesh to draw
+\param model - world matrix, usually modelStack.Top()
+\param enableLight - whether the mesh is lit
+\param pass - opaque or transparent
+*/
+/******************************************************************************/
+void RenderQueue::Submit(Mesh* mesh, const glm::mat4& model, bool enableLight, PASS pass)
+{
+	if (!mesh || programs.empty())
+		return;
+
+	if (cullingEnabled && !frustum.IsVisible(mesh->bounds, model))
+	{
+		++cullStats.culled;
+		return;
+	}
+
+	Mesh* lod = mesh->GetLod(SelectLod(mesh, model));
+	unsigned materialOffset = ~0u;
+	if (!CullMaterials(lod, model, materialOffset))
+	{
+		++cullStats.culled;
+		return;
+	}
+	++cullStats.visible;
+
+	AddItem(lod, mesh, model, enableLight, pass, 0, 0, materialOffset);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue count copies of a mesh to be drawn with a single instanced call. The
+instance data is copied, so the caller may reuse its buffer. Only the
+copies inside the frustum are kept.
+
+\param mesh - mesh to draw
+\param instanceData - model matrix and color of each copy, in world space
+\param count - number of copies
+\param enableLight - whether the mesh is lit
+\param pass - opaque or transparent
+*/
+/******************************************************************************/
+void RenderQueue::SubmitInstanced(Mesh* mesh, const InstanceData* instanceData, unsigned count,
+	bool enableLight, PASS pass)
+{
+	if (!mesh || count == 0 || programs.empty())
+		return;
+
+	instanceLods.resize(count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (cullingEnabled && !frustum.IsVisible(mesh->bounds, instanceData[i].model))
+		{
+			instanceLods[i] = LOD_CULLED;
+			++cullStats.culled;
+			continue;
+		}
+		instanceLods[i] = static_cast<unsigned char>(SelectLod(mesh, instanceData[i].model));
+		++cullStats.visible;
+	}
+
+	// One instanced draw per level that has copies. It sorts at the origin of
+	// its nearest copy, or of its farthest in the transparent pass, so it
+	// takes the place a draw of that copy alone would.
+	for (unsigned level = 0; level <= mesh->lods.size(); ++level)
+	{
+		unsigned instanceOffset = instances.size();
+		glm::mat4 sortModel(1.f);
+		float sortDistance = 0.f;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			if (instanceLods[i] != level)
+				continue;
+			float distance = -(cameraView * instanceData[i].model[3]).z;
+			bool first = instances.size() == instanceOffset;
+			if (first || (pass == PASS_OPAQUE ? distance < sortDistance : distance > sortDistance))
+			{
+				sortModel[3] = instanceData[i].model[3];
+				sortDistance = distance;
+			}
+			instances.push_back(instanceData[i]);
+		}
+		unsigned levelCount = instances.size() - instanceOffset;
+		if (levelCount > 0)
+			AddItem(mesh->GetLod(level), mesh, sortModel, enableLight, pass, instanceOffset, levelCount, ~0u);
+	}
+}
+
+// Queue a draw of mesh with the material and texture of source, the mesh it is a level of
+void RenderQueue::AddItem(Mesh* mesh, Mesh* source, const glm::mat4& model, bool enableLight, PASS pass,
+	unsigned instanceOffset, unsigned instanceCount, unsigned materialOffset)
+{
+	DrawItem item;
+	item.mesh = mesh;
+	item.material = source->material;
+	item.textureID = source->textureID;
+	item.program = SelectProgram(enableLight, item.textureID, instanceCount > 0);
+	item.model = model;
+	item.enableLight = enableLight;
+	item.pass = pass;
+	item.instanceOffset = instanceOffset;
+	item.instanceCount = instanceCount;
+	item.materialOffset = materialOffset;
+	items.push_back(item);
+}
+
+unsigned long long RenderQueue::BuildKey(const DrawItem& item, const glm::mat4& view) const
+{
+	// Distance of the object's origin in front of the camera, quantised to 24 bits
+	float distance = -(view * item.model[3]).z;
+	float normalised = glm::clamp(distance / maxDepth, 0.f, 1.f);
+	unsigned long long depth = static_cast<unsigned long long>(normalised * DEPTH_MASK);
+
+	unsigned long long program = item.program & PROGRAM_MASK;
+	unsigned long long texture = item.textureID & TEXTURE_MASK;
+	unsigned long long material = HashMaterial(item.material) & MATERIAL_MASK;
+
+	if (item.pass == PASS_OPAQUE)
+		return (program << 56) | (texture << 40) | (material << 24) | depth;
+
+	return (1ull << 63) | ((DEPTH_MASK - depth) << 39) | (program << 32) | (texture << 16) | material;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Sort and draw everything submitted since the last flush, then empty the queue.
+Instanced draws read the camera from the FrameData uniform block, so it must
+have been uploaded with the same matrices.
+
+\param view - camera view matrix
+\param projection - camera projection matrix
+\param afterOpaque - drawn between the opaque and the transparent items, e.g.
+	the skybox; it may change the program and the bound texture
+*/
+/******************************************************************************/
+void RenderQueue::Flush(const glm::mat4& view, const glm::mat4& projection,
+	const std::function<void()>& afterOpaque)
+{
+	stats = Stats();
+	if (items.empty())
+	{
+		if (afterOpaque)
+			afterOpaque();
+		return;
+	}
+
+	order.resize(items.size());
+	for (unsigned i = 0; i < items.size(); ++i)
+	{
+		order[i].key = BuildKey(items[i], view);
+		order[i].index = i;
+	}
+	std::sort(order.begin(), order.end());
+
+	const glm::mat4 viewProjection = projection * view;
+
+	// State of the last draw; ~0u forces the first item to set everything.
+	// Uniform values are filtered by UniformCache, across flushes as well.
+	UniformCache* uniforms = UniformCache::GetInstance();
+	unsigned boundProgram = ~0u;
+	unsigned boundTexture = ~0u;
+	bool materialValid = false;
+	Material lastMaterial;
+	PASS pass = PASS_OPAQUE;
+
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		const DrawItem& item = items[order[i].index];
+		const Program& program = programs[item.program];
+		const int* parameters = program.parameters;
+
+		if (item.pass != pass)
+		{
+			if (afterOpaque)
+			{
+				afterOpaque();
+				boundProgram = ~0u;
+			}
+
+			// Transparent items blend over the opaque ones without writing depth
+			pass = item.pass;
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+
+		if (item.program != boundProgram)
+		{
+			uniforms->UseProgram(program.programID);
+			uniforms->Uniform1i(parameters[U_COLOR_TEXTURE], 0);
+			Mesh::SetMaterialLoc(parameters[U_MATERIAL_AMBIENT], parameters[U_MATERIAL_DIFFUSE],
+				parameters[U_MATERIAL_SPECULAR], parameters[U_MATERIAL_SHININESS]);
+			boundProgram = item.program;
+			boundTexture = ~0u;
+			materialValid = false;
+			++stats.programBinds;
+		}
+
+		// Instanced draws take their matrices from the instance buffer
+		bool instancingEnabled = item.instanceCount > 0;
+		uniforms->Uniform1i(parameters[U_INSTANCING_ENABLED], instancingEnabled);
+
+		glm::mat4 modelView = view * item.model;
+		if (!instancingEnabled)
+		{
+			glm::mat4 MVP = viewProjection * item.model;
+			uniforms->UniformMatrix4fv(parameters[U_MVP], glm::value_ptr(MVP));
+			uniforms->UniformMatrix4fv(parameters[U_MODELVIEW], glm::value_ptr(modelView));
+		}
+
+		uniforms->Uniform1i(parameters[U_LIGHTENABLED], item.enableLight);
+
+		if (item.enableLight && !instancingEnabled)
+		{
+			glm::mat4 modelView_inverse_transpose = glm::inverseTranspose(modelView);
+			uniforms->UniformMatrix4fv(parameters[U_MODELVIEW_INVERSE_TRANSPOSE], glm::value_ptr(modelView_inverse_transpose));
+		}
+
+		if (item.enableLight)
+		{
+			if (!materialValid || !SameMaterial(lastMaterial, item.material))
+			{
+				uniforms->Uniform3fv(parameters[U_MATERIAL_AMBIENT], &item.material.kAmbient.r);
+				uniforms->Uniform3fv(parameters[U_MATERIAL_DIFFUSE], &item.material.kDiffuse.r);
+				uniforms->Uniform3fv(parameters[U_MATERIAL_SPECULAR], &item.material.kSpecular.r);
+				uniforms->Uniform1f(parameters[U_MATERIAL_SHININESS], item.material.kShininess);
+				lastMaterial = item.material;
+				materialValid = true;
+				++stats.materialUploads;
+			}
+		}
+
+		if (item.textureID != boundTexture)
+		{
+			if (item.textureID > 0)
+			{
+				uniforms->Uniform1i(parameters[U_COLOR_TEXTURE_ENABLED], 1);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, item.textureID);
+			}
+			else
+			{
+				uniforms->Uniform1i(parameters[U_COLOR_TEXTURE_ENABLED], 0);
+			}
+			boundTexture = item.textureID;
+			++stats.textureBinds;
+		}
+
+		if (instancingEnabled)
+			item.mesh->RenderInstanced(&instances[item.instanceOffset], item.instanceCount);
+		else if (item.materialOffset != ~0u)
+			item.mesh->Render(&visibleMaterials[item.materialOffset]);
+		else
+			item.mesh->Render();
+		++stats.drawCalls;
+
+		// Multi-material meshes upload their own materials while drawing
+		if (!item.mesh->materials.empty())
+			materialValid = false;
+	}
+
+	if (pass == PASS_TRANSPARENT)
+	{
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+	if (boundTexture > 0)
+		glBindTexture(GL_TEXTURE_2D, 0);
+	// Leave the program in its default state for the immediate-mode draws that follow
+	uniforms->Uniform1i(programs[boundProgram].parameters[U_INSTANCING_ENABLED], 0);
+	if (pass == PASS_OPAQUE && afterOpaque)
+		afterOpaque();
+
+	items.clear();
+	instances.clear();
+	visibleMaterials.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Drop everything submitted since the last flush without drawing it
+*/
+/******************************************************************************/
+void RenderQueue::Clear()
+{
+	items.clear();
+	instances.clear();
+	visibleMaterials.clear();
+}
+
+const RenderQueue::Stats& RenderQueue::GetStats() const
+{
+	return stats;
+}
+
+// Counted since the last ResetCullStats, over every flush in between
+const RenderQueue::CullStats& RenderQueue::GetCullStats() const
+{
+	return cullStats;
+}
+
+void RenderQueue::ResetCullStats()
+{
+	cullStats = CullStats();
+}
+
+// Cells are culled by the scene before it submits, so it reports them here
+void RenderQueue::CountCells(unsigned visible, unsigned culled)
+{
+	cullStats.visibleCells += visible;
+	cullStats.culledCells += culled;
+}
+
+// Binned by Renderer::BeginFrame, reported with the culling counts
+void RenderQueue::CountClusterLights(unsigned lights, unsigned references, unsigned maxPerCluster)
+{
+	cullStats.clusteredLights += lights;
+	cullStats.clusterLightRefs += references;
+	cullStats.maxClusterLights = std::max(cullStats.maxClusterLights, maxPerCluster);
+}
@@ -0,0 +1,160 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "Bounds.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "ShaderVariants.h"
+#include "Vertex.h"
+
+/******************************************************************************/
+/*!
+\brief
+Collects the draw calls of a frame, sorts them by a 64-bit key and submits
+them with redundant program/texture/material changes skipped. Uniforms go
+through UniformCache.
+Opaque items are drawn front-to-back, transparent items back-to-front.
+Submits outside the frustum are dropped, as are the instances and material
+sub-ranges outside it. Meshes with levels of detail are drawn with the level
+their projected size calls for. With shader variants set, each draw uses the
+variant built for its lighting, texture and instancing where there is one.
+*/
+/******************************************************************************/
+class RenderQueue
+{
+public:
+	enum PASS
+	{
+		PASS_OPAQUE = 0,
+		PASS_TRANSPARENT,
+		PASS_LAST,
+	};
+
+	struct Stats
+	{
+		unsigned drawCalls;
+		unsigned programBinds;
+		unsigned textureBinds;
+		unsigned materialUploads;
+	};
+
+	// Objects, instances and material sub-ranges the frustum kept and dropped,
+	// and how many of the visible ones were drawn with a coarser level of detail
+	struct CullStats
+	{
+		unsigned visible;
+		unsigned culled;
+		unsigned culledMaterials;
+		unsigned coarserLods;
+		unsigned visibleCells; // portal cells, as counted by the scene
+		unsigned culledCells;
+		unsigned clusteredLights;  // lights binned by LightClusters
+		unsigned clusterLightRefs; // entries over all cluster lists
+		unsigned maxClusterLights; // longest cluster list
+	};
+
+	RenderQueue();
+	~RenderQueue();
+
+	void SetProgram(unsigned programID);
+	void SetVariants(const ShaderVariants* variants);
+	void SetLightKey(unsigned lightKey);
+	void SetUseVariants(bool use);
+	bool IsUsingVariants() const;
+	void SetMaxDepth(float depth);
+	void SetCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+	void Submit(Mesh* mesh, const glm::mat4& model, bool enableLight, PASS pass = PASS_OPAQUE);
+	void SubmitInstanced(Mesh* mesh, const InstanceData* instanceData, unsigned count, bool enableLight,
+		PASS pass = PASS_OPAQUE);
+	void Flush(const glm::mat4& view, const glm::mat4& projection,
+		const std::function<void()>& afterOpaque = std::function<void()>());
+	void Clear();
+
+	const Stats& GetStats() const;
+	const CullStats& GetCullStats() const;
+	void ResetCullStats();
+	void CountCells(unsigned visible, unsigned culled);
+	void CountClusterLights(unsigned lights, unsigned references, unsigned maxPerCluster);
+
+private:
+	enum UNIFORM_TYPE
+	{
+		U_MVP = 0,
+		U_MODELVIEW,
+		U_MODELVIEW_INVERSE_TRANSPOSE,
+		U_MATERIAL_AMBIENT,
+		U_MATERIAL_DIFFUSE,
+		U_MATERIAL_SPECULAR,
+		U_MATERIAL_SHININESS,
+		U_LIGHTENABLED,
+		U_COLOR_TEXTURE_ENABLED,
+		U_COLOR_TEXTURE,
+		U_INSTANCING_ENABLED,
+
+		U_TOTAL,
+	};
+
+	struct Program
+	{
+		unsigned programID;
+		int parameters[U_TOTAL];
+	};
+
+	struct DrawItem
+	{
+		Mesh* mesh;
+		Material material;
+		unsigned textureID;
+		unsigned program; // index into programs
+		glm::mat4 model;  // of an instanced draw, only where it sorts
+		bool enableLight;
+		PASS pass;
+		unsigned instanceOffset; // into instances
+		unsigned instanceCount; // 0 for a regular draw
+		unsigned materialOffset; // into visibleMaterials, ~0u to draw every material
+	};
+
+	struct SortEntry
+	{
+		unsigned long long key;
+		unsigned index;
+
+		bool operator<(const SortEntry& rhs) const { return key < rhs.key; }
+	};
+
+	unsigned FindProgram(unsigned programID);
+	unsigned SelectProgram(bool enableLight, unsigned textureID, bool instanced);
+	unsigned long long BuildKey(const DrawItem& item, const glm::mat4& view) const;
+	bool CullMaterials(Mesh* mesh, const glm::mat4& model, unsigned& materialOffset);
+	unsigned SelectLod(Mesh* mesh, const glm::mat4& model);
+	void AddItem(Mesh* mesh, Mesh* source, const glm::mat4& model, bool enableLight, PASS pass,
+		unsigned instanceOffset, unsigned instanceCount, unsigned materialOffset);
+
+	std::vector<Program> programs;
+	const ShaderVariants* variants;
+	std::map<unsigned, unsigned> variantPrograms; // variant key -> index into programs
+	unsigned lightKey;   // ShaderVariants::GetLightKey of the frame's lights
+	bool useVariants;
+	std::vector<DrawItem> items;
+	std::vector<InstanceData> instances;
+	std::vector<unsigned char> visibleMaterials;
+	std::vector<unsigned char> instanceLods; // level of each copy in SubmitInstanced, LOD_CULLED if none
+	std::vector<SortEntry> order;
+	unsigned currentProgram;
+	float maxDepth;
+	Stats stats;
+	Frustum frustum;
+	bool cullingEnabled; // false until the first SetCamera
+	glm::mat4 cameraView;
+	float lodScale;      // projected radius in pixels of a unit sphere 1 unit in front of the camera
+	CullStats cullStats;
+};
+
+#endif
@@ -0,0 +1,582 @@
+#include "Renderer.h"
+#include "GL\glew.h"
+
+// GLM Headers
+#include <glm\gtc\matrix_transform.hpp>
+#include <glm\gtc\type_ptr.hpp>
+#include <glm\gtc\matrix_inverse.hpp>
+
+#include "ShaderCache.h"
+#include "UniformCache.h"
+#include "MeshBuilder.h"
+
+#include <cstdio>
+
+namespace
+{
+	// Texture and instancing combinations that get a variant for each light setup
+	const unsigned VARIANT_SURFACES[] = {
+		0,
+		ShaderVariants::TEXTURED,
+		ShaderVariants::INSTANCED,
+		ShaderVariants::TEXTURED | ShaderVariants::INSTANCED,
+	};
+}
+
+Renderer::Renderer()
+	: m_programID(0)
+	, loadingBack(nullptr)
+	, loadingFill(nullptr)
+	, view(1.f)
+	, projection(1.f)
+	, hasFont(false)
+	, skyboxProgramID(0)
+	, skyboxVP(-1)
+	, skyboxVAO(0)
+	, skyboxVBO(0)
+	, skyboxTexture(0)
+	, skyboxPending(false)
+	, lights(nullptr)
+	, lightCount(0)
+	, lightKey(0)
+{
+}
+
+Renderer::~Renderer()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Build the shader program and everything that draws with it; call once after
+the GL context exists
+*/
+/******************************************************************************/
+void Renderer::Init()
+{
+	// Start every shader program before waiting on any, so they can compile side by side
+	ShaderCache* shaders = ShaderCache::GetInstance();
+	m_programID = shaders->Load("Shader//Texture.vertexshader", "Shader//Text.fragmentshader");
+	skyboxProgramID = shaders->Load("Shader//Skybox.vertexshader", "Shader//Skybox.fragmentshader");
+
+	// Variants for unlit draws, text and one point light are built up front;
+	// other light setups when a frame first has them
+	variants.Init("Shader//Texture.vertexshader", "Shader//Text.fragmentshader");
+	for (unsigned surface : VARIANT_SURFACES)
+		variants.Request(surface);
+	variants.Request(ShaderVariants::TEXT | ShaderVariants::TEXTURED);
+	Light pointLight;
+	pointLight.type = Light::LIGHT_POINT;
+	lightKey = ShaderVariants::GetLightKey(&pointLight, 1);
+	RequestLitVariants(lightKey);
+	FinishVariants();
+	resolution.Init();
+
+	const ShaderCache::Stats& shaderStats = shaders->GetStats();
+	printf("Shaders: %u compiled, %u from binary in %.1f ms, about %.1f ms saved\n", shaderStats.compiled,
+		shaderStats.fromBinary, shaderStats.loadTime * 1000.0, shaderStats.savedTime * 1000.0);
+	UniformCache::GetInstance()->UseProgram(m_programID);
+
+	// Get a handle for our "MVP" uniform
+	m_parameters[U_MVP] = glGetUniformLocation(m_programID, "MVP");
+	m_parameters[U_MODELVIEW] = glGetUniformLocation(m_programID, "MV");
+	m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(m_programID, "MV_inverse_transpose");
+	m_parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(m_programID, "material.kAmbient");
+	m_parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(m_programID, "material.kDiffuse");
+	m_parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(m_programID, "material.kSpecular");
+	m_parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(m_programID, "material.kShininess");
+	m_parameters[U_LIGHTENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
+	m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(m_programID, "colorTextureEnabled");
+	m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(m_programID, "colorTexture");
+	m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(m_programID, "textEnabled");
+	m_parameters[U_TEXT_COLOR] = glGetUniformLocation(m_programID, "textColor");
+
+	renderQueue.SetProgram(m_programID);
+	renderQueue.SetVariants(&variants);
+	frameUniforms.Init();
+	if (!frameUniforms.BindProgram(m_programID))
+		printf("Program %u has no FrameData block\n", m_programID);
+	lightClusters.Init();
+	lightClusters.BindProgram(m_programID);
+	unsigned textProgramID = variants.Get(ShaderVariants::TEXT | ShaderVariants::TEXTURED);
+	textBatcher.Init(textProgramID ? textProgramID : m_programID, 0);
+	hasFont = false;
+
+	loadingBack = MeshBuilder::GenerateQuad("LoadingBack", glm::vec3(0.2f, 0.2f, 0.2f), 1.f);
+	loadingFill = MeshBuilder::GenerateQuad("LoadingFill", glm::vec3(1.f, 1.f, 1.f), 1.f);
+
+	// Skybox: a cube of 36 corners around the camera, sampled by direction
+	skyboxVP = glGetUniformLocation(skyboxProgramID, "VP");
+	UniformCache::GetInstance()->UseProgram(skyboxProgramID);
+	UniformCache::GetInstance()->Uniform1i(glGetUniformLocation(skyboxProgramID, "skybox"), 0);
+	UniformCache::GetInstance()->UseProgram(m_programID);
+
+	const float corners[8][3] = {
+		{ -1.f, -1.f, -1.f }, { 1.f, -1.f, -1.f }, { 1.f, 1.f, -1.f }, { -1.f, 1.f, -1.f },
+		{ -1.f, -1.f, 1.f }, { 1.f, -1.f, 1.f }, { 1.f, 1.f, 1.f }, { -1.f, 1.f, 1.f },
+	};
+	const unsigned faces[36] = {
+		0, 1, 2, 2, 3, 0, // -Z
+		5, 4, 7, 7, 6, 5, // +Z
+		4, 0, 3, 3, 7, 4, // -X
+		1, 5, 6, 6, 2, 1, // +X
+		3, 2, 6, 6, 7, 3, // +Y
+		4, 5, 1, 1, 0, 4, // -Y
+	};
+	float positions[36 * 3];
+	for (unsigned i = 0; i < 36; ++i)
+	{
+		for (unsigned c = 0; c < 3; ++c)
+			positions[i * 3 + c] = corners[faces[i]][c];
+	}
+	glGenVertexArrays(1, &skyboxVAO);
+	Mesh::BindVertexArray(skyboxVAO);
+	glGenBuffers(1, &skyboxVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	Mesh::BindVertexArray(0);
+
+	// Filter across cube map faces instead of showing seams at the edges
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+}
+
+void Renderer::Exit()
+{
+	delete loadingBack;
+	delete loadingFill;
+	loadingBack = loadingFill = nullptr;
+
+	renderQueue.Clear();
+	textBatcher.Exit();
+	frameUniforms.Exit();
+	lightClusters.Exit();
+	resolution.Exit();
+	renderQueue.SetVariants(nullptr);
+	variants.Exit();
+	ShaderCache::GetInstance()->Release(m_programID);
+	m_programID = 0;
+
+	glDeleteBuffers(1, &skyboxVBO);
+	glDeleteVertexArrays(1, &skyboxVAO);
+	ShaderCache::GetInstance()->Release(skyboxProgramID);
+	skyboxVAO = skyboxVBO = skyboxProgramID = 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Use a scene's lights until the next ClearScene
+
+\param lights - the scene's light array, must stay alive while it is used
+\param count - number of lights
+*/
+/******************************************************************************/
+void Renderer::SetLights(const Light* lights, unsigned count)
+{
+	frameUniforms.SetLights(lights, count);
+	this->lights = lights;
+	lightCount = count;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set the font texture and glyph spacing for RenderText and RenderTextOnScreen.
+Text is skipped while no font is set.
+
+\param textureID - 16x16 glyph texture such as Images//calibri.tga, 0 for none
+\param advance - distance from one glyph to the next, in units of the text size
+\param worldOrigin - centre of the first glyph for RenderText
+\param screenOrigin - centre of the first glyph for RenderTextOnScreen
+*/
+/******************************************************************************/
+void Renderer::SetFont(unsigned textureID, float advance, const glm::vec2& worldOrigin, const glm::vec2& screenOrigin)
+{
+	textBatcher.SetTexture(textureID);
+	textBatcher.SetLayout(advance, worldOrigin, screenOrigin);
+	hasFont = textureID > 0;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw a cube map behind everything else of the frame, once per frame between
+the opaque and the transparent draws
+
+\param cubemapID - cube map from AssetCache::LoadCubemap, 0 for no skybox
+*/
+/******************************************************************************/
+void Renderer::SetSkybox(unsigned cubemapID)
+{
+	skyboxTexture = cubemapID;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Forget the lights, font, skybox and queued draws of the scene being exited
+*/
+/******************************************************************************/
+void Renderer::ClearScene()
+{
+	frameUniforms.SetLights(nullptr, 0);
+	lights = nullptr;
+	lightCount = 0;
+	textBatcher.SetTexture(0);
+	hasFont = false;
+	skyboxTexture = 0;
+	renderQueue.Clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Send what the scene draws next to the dynamic resolution target, if it is on;
+call before the scene's Render
+*/
+/******************************************************************************/
+void Renderer::BeginScene()
+{
+	resolution.Begin();
+}
+
+// Put the scene on the window, for a scene that did not reach EndFrame
+void Renderer::EndScene()
+{
+	resolution.Present();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Start a frame: upload the camera and lights for every draw that follows, cull
+the submits against the camera's frustum and pick their levels of detail.
+With more lights than fit the FrameData block, the lights are binned into
+clusters for the shaders instead.
+
+\param view - camera view matrix
+\param projection - camera projection matrix
+*/
+/******************************************************************************/
+void Renderer::BeginFrame(const glm::mat4& view, const glm::mat4& projection)
+{
+	this->view = view;
+	this->projection = projection;
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	frameUniforms.SetCamera(view, projection);
+	if (lightCount > FrameUniforms::MAX_LIGHTS)
+	{
+		lightClusters.Build(lights, lightCount, view, projection,
+			static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+		lightClusters.Bind();
+		frameUniforms.SetClusters(lightClusters.GetScale(),
+			glm::ivec4(LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES, 1));
+		const LightClusters::Stats& clusterStats = lightClusters.GetStats();
+		renderQueue.CountClusterLights(clusterStats.lights, clusterStats.references, clusterStats.maxPerCluster);
+	}
+	else
+		frameUniforms.SetClusters(glm::vec4(0.f), glm::ivec4(1, 1, 1, 0));
+	frameUniforms.Upload();
+
+	// A scene may change its lights' types at any time, e.g. on a key press
+	unsigned frameLightKey = ShaderVariants::GetLightKey(lights, lightCount);
+	if (frameLightKey != lightKey)
+	{
+		lightKey = frameLightKey;
+		RequestLitVariants(lightKey);
+		FinishVariants();
+	}
+	renderQueue.SetLightKey(lightKey);
+
+	renderQueue.SetCamera(view, projection, static_cast<float>(viewport[3]));
+	skyboxPending = skyboxTexture > 0;
+}
+
+void Renderer::Submit(Mesh* mesh, const glm::mat4& model, bool enableLight, RenderQueue::PASS pass)
+{
+	renderQueue.Submit(mesh, model, enableLight, pass);
+}
+
+void Renderer::SubmitInstanced(Mesh* mesh, const InstanceData* instanceData, unsigned count, bool enableLight,
+	RenderQueue::PASS pass)
+{
+	renderQueue.SubmitInstanced(mesh, instanceData, count, enableLight, pass);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw everything submitted so far with the camera of BeginFrame
+*/
+/******************************************************************************/
+void Renderer::Flush()
+{
+	renderQueue.Flush(view, projection, [this]() { RenderSkybox(); });
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw what is left in the queue and the world text, put the scene on the
+window, then draw the screen text over it at the window's resolution
+*/
+/******************************************************************************/
+void Renderer::EndFrame()
+{
+	renderQueue.Flush(view, projection, [this]() { RenderSkybox(); });
+	textBatcher.FlushWorld(view, projection);
+	resolution.Present();
+	textBatcher.FlushScreen();
+}
+
+const RenderQueue::CullStats& Renderer::GetCullStats() const
+{
+	return renderQueue.GetCullStats();
+}
+
+void Renderer::ResetCullStats()
+{
+	renderQueue.ResetCullStats();
+}
+
+void Renderer::CountCells(unsigned visible, unsigned culled)
+{
+	renderQueue.CountCells(visible, culled);
+}
+
+void Renderer::SetUseShaderVariants(bool use)
+{
+	renderQueue.SetUseVariants(use);
+}
+
+bool Renderer::IsUsingShaderVariants() const
+{
+	return renderQueue.IsUsingVariants();
+}
+
+void Renderer::SetUseDynamicResolution(bool use)
+{
+	resolution.SetEnabled(use);
+}
+
+bool Renderer::IsUsingDynamicResolution() const
+{
+	return resolution.IsEnabled();
+}
+
+// Feed the GPU time of a scene render to the resolution scale
+void Renderer::UpdateResolution(double gpuTime)
+{
+	resolution.Update(gpuTime);
+}
+
+float Renderer::GetResolutionScale() const
+{
+	return resolution.GetScale();
+}
+
+void Renderer::SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing)
+{
+	resolution.SetAntiAliasing(antiAliasing);
+}
+
+DynamicResolution::ANTI_ALIASING Renderer::GetAntiAliasing() const
+{
+	return resolution.GetAntiAliasing();
+}
+
+// Bytes of video memory the scene is drawn into, besides the window's own buffers
+unsigned long long Renderer::GetSceneTargetMemory() const
+{
+	return resolution.GetTargetMemory();
+}
+
+// Start the lit variants, textured or not and instanced or not, for a light setup
+void Renderer::RequestLitVariants(unsigned lightKey)
+{
+	for (unsigned surface : VARIANT_SURFACES)
+		variants.Request(ShaderVariants::MakeKey(surface | ShaderVariants::LIT, lightKey));
+}
+
+// Wait for the requested variants and point them at the FrameData block and the cluster buffers
+void Renderer::FinishVariants()
+{
+	for (unsigned programID : variants.Finish())
+	{
+		frameUniforms.BindProgram(programID);
+		lightClusters.BindProgram(programID);
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw a mesh right away on the 1920x1080 screen UI, unlit and without depth
+test
+
+\param mesh - mesh to draw
+\param x - x position in UI units
+\param y - y position in UI units
+\param sizex - width in UI units
+\param sizey - height in UI units
+*/
+/******************************************************************************/
+void Renderer::RenderMeshOnScreen(Mesh* mesh, float x, float y, float sizex, float sizey)
+{
+	if (!mesh)
+		return;
+
+	glDisable(GL_DEPTH_TEST);
+	glm::mat4 ortho = glm::ortho(0.f, 1920.f, 0.f, 1080.f, -1000.f, 1000.f); // dimension of screen UI
+	glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(x, y, 0.f));
+	model = glm::scale(model, glm::vec3(sizex, sizey, 1.f));
+	RenderMesh(mesh, model, glm::mat4(1.f), ortho, false); //UI should not have light
+	glEnable(GL_DEPTH_TEST);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a string in world space, drawn by EndFrame
+
+\param text - string to draw
+\param model - world matrix of the string, usually modelStack.Top()
+\param color - text color
+*/
+/******************************************************************************/
+void Renderer::RenderText(const std::string& text, const glm::mat4& model, const glm::vec3& color)
+{
+	if (!hasFont)
+		return;
+	textBatcher.AddText(text, model, color);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a string on the 800x600 screen UI, drawn by EndFrame
+
+\param text - string to draw
+\param color - text color
+\param size - glyph size in UI units
+\param x - x position in UI units
+\param y - y position in UI units
+*/
+/******************************************************************************/
+void Renderer::RenderTextOnScreen(const std::string& text, const glm::vec3& color, float size, float x, float y)
+{
+	if (!hasFont)
+		return;
+	textBatcher.AddTextOnScreen(text, color, size, x, y);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Clear the screen and draw a progress bar, shown by SceneManager while a
+scene's assets are still loading
+
+\param progress - share of the loading that is done, from 0 to 1
+*/
+/******************************************************************************/
+void Renderer::RenderLoadingScreen(float progress)
+{
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	const float width = 800.f, height = 40.f, left = 560.f, y = 540.f;
+	RenderMeshOnScreen(loadingBack, left + width * 0.5f, y, width, height);
+	if (progress > 0.f)
+		RenderMeshOnScreen(loadingFill, left + width * progress * 0.5f, y, width * progress, height);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw the skybox cube at the far plane with depth test on and depth writes
+off, so only pixels nothing opaque has covered are shaded. Does nothing if
+there is no skybox or it was already drawn this frame.
+*/
+/******************************************************************************/
+void Renderer::RenderSkybox()
+{
+	if (!skyboxPending)
+		return;
+	skyboxPending = false;
+
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(skyboxProgramID);
+	glm::mat4 VP = projection * glm::mat4(glm::mat3(view));
+	uniforms->UniformMatrix4fv(skyboxVP, glm::value_ptr(VP));
+
+	GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+	glDisable(GL_CULL_FACE);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+	Mesh::BindVertexArray(skyboxVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 36);
+	Mesh::BindVertexArray(0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	if (cullFace)
+		glEnable(GL_CULL_FACE);
+}
+
+// Immediate draw that bypasses the queue, for UI drawn with its own camera
+void Renderer::RenderMesh(Mesh* mesh, const glm::mat4& model, const glm::mat4& view,
+	const glm::mat4& projection, bool enableLight)
+{
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(m_programID);
+
+	glm::mat4 MVP, modelView, modelView_inverse_transpose;
+
+	MVP = projection * view * model;
+	uniforms->UniformMatrix4fv(m_parameters[U_MVP], glm::value_ptr(MVP));
+	modelView = view * model;
+	uniforms->UniformMatrix4fv(m_parameters[U_MODELVIEW], glm::value_ptr(modelView));
+	if (enableLight)
+	{
+		uniforms->Uniform1i(m_parameters[U_LIGHTENABLED], 1);
+		modelView_inverse_transpose = glm::inverseTranspose(modelView);
+		uniforms->UniformMatrix4fv(m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE], glm::value_ptr(modelView_inverse_transpose));
+
+		//load material
+		uniforms->Uniform3fv(m_parameters[U_MATERIAL_AMBIENT], &mesh->material.kAmbient.r);
+		uniforms->Uniform3fv(m_parameters[U_MATERIAL_DIFFUSE], &mesh->material.kDiffuse.r);
+		uniforms->Uniform3fv(m_parameters[U_MATERIAL_SPECULAR], &mesh->material.kSpecular.r);
+		uniforms->Uniform1f(m_parameters[U_MATERIAL_SHININESS], mesh->material.kShininess);
+	}
+	else
+	{
+		uniforms->Uniform1i(m_parameters[U_LIGHTENABLED], 0);
+	}
+
+	if (mesh->textureID > 0)
+	{
+		uniforms->Uniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
+		uniforms->Uniform1i(m_parameters[U_COLOR_TEXTURE], 0);
+	}
+	else
+	{
+		uniforms->Uniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 0);
+	}
+
+	mesh->Render();
+
+	if (mesh->textureID > 0)
+	{
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
@@ -0,0 +1,132 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <string>
+
+#include "Mesh.h"
+#include "Light.h"
+#include "RenderQueue.h"
+#include "TextBatcher.h"
+#include "FrameUniforms.h"
+#include "LightClusters.h"
+#include "DynamicResolution.h"
+
+/******************************************************************************/
+/*!
+		Class Renderer:
+\brief	Drawing path shared by every scene. Owns the Texture/Text shader
+		program and its compile time variants, its uniform table, the
+		render queue, the text batcher, the per-frame uniform block, the
+		light clusters, the skybox and the dynamic resolution target.
+		Created once by SceneManager, so a scene switch does not rebuild
+		any of it.
+*/
+/******************************************************************************/
+class Renderer
+{
+public:
+	enum UNIFORM_TYPE
+	{
+		U_MVP = 0,
+		U_MODELVIEW,
+		U_MODELVIEW_INVERSE_TRANSPOSE,
+		U_MATERIAL_AMBIENT,
+		U_MATERIAL_DIFFUSE,
+		U_MATERIAL_SPECULAR,
+		U_MATERIAL_SHININESS,
+		U_LIGHTENABLED,
+		U_COLOR_TEXTURE_ENABLED,
+		U_COLOR_TEXTURE,
+		U_TEXT_ENABLED,
+		U_TEXT_COLOR,
+
+		U_TOTAL,
+	};
+
+	Renderer();
+	~Renderer();
+
+	void Init();
+	void Exit();
+
+	// Scene state, set in the scene's Init and dropped by ClearScene
+	void SetLights(const Light* lights, unsigned count);
+	void SetFont(unsigned textureID, float advance, const glm::vec2& worldOrigin, const glm::vec2& screenOrigin);
+	void SetSkybox(unsigned cubemapID);
+	void ClearScene();
+
+	// Scene render, drawn at the dynamic resolution up to EndFrame's screen text
+	void BeginScene();
+	void EndScene();
+
+	// Frame
+	void BeginFrame(const glm::mat4& view, const glm::mat4& projection);
+	void Submit(Mesh* mesh, const glm::mat4& model, bool enableLight,
+		RenderQueue::PASS pass = RenderQueue::PASS_OPAQUE);
+	void SubmitInstanced(Mesh* mesh, const InstanceData* instanceData, unsigned count, bool enableLight,
+		RenderQueue::PASS pass = RenderQueue::PASS_OPAQUE);
+	void Flush();
+	void EndFrame();
+
+	// Culling counts since the last ResetCullStats
+	const RenderQueue::CullStats& GetCullStats() const;
+	void ResetCullStats();
+	void CountCells(unsigned visible, unsigned culled);
+
+	// Draw with the compile time shader variants, or with the plain shaders' switch uniforms
+	void SetUseShaderVariants(bool use);
+	bool IsUsingShaderVariants() const;
+
+	// Scale the scene render with the GPU time, or draw it at window size
+	void SetUseDynamicResolution(bool use);
+	bool IsUsingDynamicResolution() const;
+	void UpdateResolution(double gpuTime);
+	float GetResolutionScale() const;
+
+	// Anti-aliasing of the scene render, done in the dynamic resolution target
+	void SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing);
+	DynamicResolution::ANTI_ALIASING GetAntiAliasing() const;
+	unsigned long long GetSceneTargetMemory() const;
+
+	void RenderMeshOnScreen(Mesh* mesh, float x, float y, float sizex, float sizey);
+	void RenderText(const std::string& text, const glm::mat4& model, const glm::vec3& color);
+	void RenderTextOnScreen(const std::string& text, const glm::vec3& color, float size, float x, float y);
+	void RenderLoadingScreen(float progress);
+
+private:
+	void RenderMesh(Mesh* mesh, const glm::mat4& model, const glm::mat4& view,
+		const glm::mat4& projection, bool enableLight);
+	void RenderSkybox();
+	void RequestLitVariants(unsigned lightKey);
+	void FinishVariants();
+
+	unsigned m_programID;
+	int m_parameters[U_TOTAL];
+
+	RenderQueue renderQueue;
+	TextBatcher textBatcher;
+	FrameUniforms frameUniforms;
+	LightClusters lightClusters; // built each frame with more lights than FrameUniforms::MAX_LIGHTS
+	DynamicResolution resolution;
+	Mesh* loadingBack; // progress bar of RenderLoadingScreen
+	Mesh* loadingFill;
+
+	glm::mat4 view, projection;
+	bool hasFont;
+
+	unsigned skyboxProgramID;
+	int skyboxVP;
+	unsigned skyboxVAO, skyboxVBO;
+	unsigned skyboxTexture; // cube map of the scene, 0 for none
+	bool skyboxPending;     // not drawn yet this frame
+
+	ShaderVariants variants; // of the Texture/Text pair
+	const Light* lights;     // of the scene, as given to SetLights
+	unsigned lightCount;
+	unsigned lightKey;       // ShaderVariants::GetLightKey of the lit variants last built
+};
+
+#endif
@@ -1,16 +1,28 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+class Renderer;
+
 class Scene
 {
 public:
-	Scene() {}
+	Scene() : renderer(nullptr) {}
 	~Scene() {}
 
 	virtual void Init() = 0;
 	virtual void Update(double dt) = 0;
 	virtual void Render() = 0;
 	virtual void Exit() = 0;
+
+	// Acquire and release the scene's meshes and textures; SceneManager may
+	// load them before the scene is entered
+	virtual void LoadAssets() = 0;
+	virtual void UnloadAssets() = 0;
+
+	void SetRenderer(Renderer* renderer) { this->renderer = renderer; }
+
+protected:
+	Renderer* renderer; // shared by all scenes, owned by SceneManager
 };
 
 #endif
\ No newline at end of file
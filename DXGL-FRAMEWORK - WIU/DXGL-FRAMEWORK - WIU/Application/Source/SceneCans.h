@@ -10,6 +10,8 @@
 #include "SceneManager.h"
 #include <iostream>
 #include "Door.h"
+#include "timer.h"
+#include <vector>
 
 class SceneCans : public Scene
 {
@@ -22,13 +24,6 @@ public:
 		GEO_PLANE,
 
 		
-		GEO_LEFT,
-		GEO_RIGHT,
-		GEO_TOP,
-		GEO_BOTTOM,
-		GEO_FRONT,
-		GEO_BACK,
-
 		GEO_DOOR_HOLE,
 		GEO_DOOR,
 
@@ -37,44 +32,13 @@ public:
 
 		GEO_GUI,
 
+		GEO_CAN,
+
 		GEO_TEXT,
 
 		NUM_GEOMETRY,
 	};
 
-	enum UNIFORM_TYPE
-	{
-		U_MVP = 0,
-		U_MODELVIEW,
-		U_MODELVIEW_INVERSE_TRANSPOSE,
-		U_MATERIAL_AMBIENT,
-		U_MATERIAL_DIFFUSE,
-		U_MATERIAL_SPECULAR,
-		U_MATERIAL_SHININESS,
-		U_LIGHT0_TYPE,
-		U_LIGHT0_POSITION,
-		U_LIGHT0_COLOR,
-		U_LIGHT0_POWER,
-		U_LIGHT0_KC,
-		U_LIGHT0_KL,
-		U_LIGHT0_KQ,
-		U_LIGHT0_SPOTDIRECTION,
-		U_LIGHT0_COSCUTOFF,
-		U_LIGHT0_COSINNER,
-		U_LIGHT0_EXPONENT,
-		U_NUMLIGHTS,
-		U_COLOR_TEXTURE_ENABLED,
-		U_COLOR_TEXTURE,
-		U_LIGHTENABLED,
-
-
-		U_TEXT_ENABLED,
-		U_TEXT_COLOR,
-
-		U_TOTAL,
-	};
-
-
 	enum GameState
 	{
 		GAME_NOT_STARTED = 0,
@@ -91,22 +55,16 @@ public:
 	virtual void Update(double dt);
 	virtual void Render();
 	virtual void Exit();
+	virtual void LoadAssets();
+	virtual void UnloadAssets();
 
 private:
 	void HandleKeyPress();
-	void RenderMesh(Mesh* mesh, bool enableLight);
-	void RenderSkybox();
-	void RenderMeshOnScreen(Mesh* mesh, float x, float y,float sizex, float sizey);
-	void RenderText(Mesh* mesh, std::string text, glm::vec3	color);
-	void RenderTextOnScreen(Mesh* mesh, std::string text, glm::vec3 color, float size, float x, float y);
 	void HandleMouseInput();
 
 	
-	unsigned m_vertexArrayID;
 	Mesh* meshList[NUM_GEOMETRY];
-
-	unsigned m_programID;
-	unsigned m_parameters[U_TOTAL];
+	unsigned skybox; // cube map from AssetCache, 0 while the sky is off or failed to load
 
 	//AltAzCamera camera;
 	int projType = 1; // fix to 0 for orthographic, 1 for projection
@@ -152,6 +110,15 @@ private:
 	glm::vec3 playerSize;
 	bool CheckWallCollision(const glm::vec3& pos);
 
+	// Instancing stress test (F1 on/off, F2 instanced/one draw per can)
+	static const int STRESS_GRID = 100; // STRESS_GRID x STRESS_GRID cans
+	bool stressTestEnabled;
+	bool stressTestInstanced;
+	std::vector<InstanceData> stressInstances;
+	StopWatch stressTimer;
+	double stressSubmitTime; // CPU time to submit and flush the cans, in ms
+	void RenderStressTest();
+
 	
 	float fps = 0;
 };
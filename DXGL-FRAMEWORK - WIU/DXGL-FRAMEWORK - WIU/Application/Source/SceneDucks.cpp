@@ -12,14 +12,17 @@
 
 #include <iostream>
 
-#include "shader.hpp"
 #include "Application.h"
 #include "MeshBuilder.h"
 #include "KeyboardController.h"
 #include "MouseController.h"
 #include "LoadTGA.h"
+#include "Renderer.h"
+#include "AssetCache.h"
 
 SceneDucks::SceneDucks()
+	: skybox(0)
+	, lampTime(0.f)
 {
 }
 
@@ -41,40 +44,6 @@ void SceneDucks::Init()
 	//Default to fill mode
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	// Generate a default VAO for now
-	glGenVertexArrays(1, &m_vertexArrayID);
-	glBindVertexArray(m_vertexArrayID);
-
-	// Load the shader programs
-	m_programID = LoadShaders("Shader//Texture.vertexshader", "Shader//Text.fragmentshader");
-	glUseProgram(m_programID);
-
-	// Get a handle for our "MVP" uniform
-	m_parameters[U_MVP] = glGetUniformLocation(m_programID, "MVP");
-	m_parameters[U_MODELVIEW] = glGetUniformLocation(m_programID, "MV");
-	m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(m_programID, "MV_inverse_transpose");
-	m_parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(m_programID, "material.kAmbient");
-	m_parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(m_programID, "material.kDiffuse");
-	m_parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(m_programID, "material.kSpecular");
-	m_parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(m_programID, "material.kShininess");
-	m_parameters[U_LIGHT0_TYPE] = glGetUniformLocation(m_programID, "lights[0].type");
-	m_parameters[U_LIGHT0_POSITION] = glGetUniformLocation(m_programID, "lights[0].position_cameraspace");
-	m_parameters[U_LIGHT0_COLOR] = glGetUniformLocation(m_programID, "lights[0].color");
-	m_parameters[U_LIGHT0_POWER] = glGetUniformLocation(m_programID, "lights[0].power");
-	m_parameters[U_LIGHT0_KC] = glGetUniformLocation(m_programID, "lights[0].kC");
-	m_parameters[U_LIGHT0_KL] = glGetUniformLocation(m_programID, "lights[0].kL");
-	m_parameters[U_LIGHT0_KQ] = glGetUniformLocation(m_programID, "lights[0].kQ");
-	m_parameters[U_LIGHT0_SPOTDIRECTION] = glGetUniformLocation(m_programID, "lights[0].spotDirection");
-	m_parameters[U_LIGHT0_COSCUTOFF] = glGetUniformLocation(m_programID, "lights[0].cosCutoff");
-	m_parameters[U_LIGHT0_COSINNER] = glGetUniformLocation(m_programID, "lights[0].cosInner");
-	m_parameters[U_LIGHT0_EXPONENT] = glGetUniformLocation(m_programID, "lights[0].exponent");
-	m_parameters[U_LIGHTENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
-	m_parameters[U_NUMLIGHTS] = glGetUniformLocation(m_programID, "numLights");
-	m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(m_programID, "colorTextureEnabled");
-	m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(m_programID, "colorTexture");
-	m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(m_programID, "textEnabled");
-	m_parameters[U_TEXT_COLOR] = glGetUniformLocation(m_programID, "textColor");
-
 	// Initialise camera properties
 	//camera.Init(45.f, 45.f, 10.f);
 	camera.Init(
@@ -83,40 +52,11 @@ void SceneDucks::Init()
 		glm::vec3(0, 1.0f, 0)		// up
 	);
 
-	// Init VBO here
-	for (int i = 0; i < NUM_GEOMETRY; ++i)
-	{
-		meshList[i] = nullptr;
-	}
+	// Text is drawn in one batch per frame, spaced like the old per-character draws
+	renderer->SetFont(meshList[GEO_TEXT] ? meshList[GEO_TEXT]->textureID : 0,
+		1.f, glm::vec2(0.f, 0.f), glm::vec2(0.5f, 0.5f));
 
-	meshList[GEO_AXES] = MeshBuilder::GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
-	meshList[GEO_SPHERE] = MeshBuilder::GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
-	//meshList[GEO_CUBE] = MeshBuilder::GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
-	meshList[GEO_PLANE] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
-	//meshList[GEO_PLANE]->textureID = LoadTGA("Images//met4.tga");
-
-	// OBJ Models
-	meshList[GEO_WALL] = MeshBuilder::GenerateOBJMTL("Wall", "OBJ//Cube.obj", "OBJ//Cube.mtl");
-
-
-	// Skybox NIGHT
-	/*meshList[GEO_LEFT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_LEFT]->textureID = LoadTGA("Images//nightsky_lf.tga");
-
-	meshList[GEO_RIGHT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_RIGHT]->textureID = LoadTGA("Images//nightsky_rt.tga");
-
-	meshList[GEO_TOP] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_TOP]->textureID = LoadTGA("Images//nightsky_up.tga");
-
-	meshList[GEO_BOTTOM] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BOTTOM]->textureID = LoadTGA("Images//nightsky_dn.tga");
-
-	meshList[GEO_FRONT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_FRONT]->textureID = LoadTGA("Images//nightsky_bk.tga");
-
-	meshList[GEO_BACK] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BACK]->textureID = LoadTGA("Images//nightsky_ft.tga ");*/
+	renderer->SetSkybox(skybox);
 
 
 
@@ -134,8 +74,6 @@ void SceneDucks::Init()
 
 
 
-	glUniform1i(m_parameters[U_NUMLIGHTS], 2);
-
 	light[0].position = glm::vec3(0, 5, 0);
 	light[0].color = glm::vec3(1, 1, 1);
 	light[0].type = Light::LIGHT_POINT;
@@ -148,21 +86,67 @@ void SceneDucks::Init()
 	light[0].exponent = 3.f;
 	light[0].spotDirection = glm::vec3(0.f, 1.f, 0.f);
 
-	glUniform3fv(m_parameters[U_LIGHT0_COLOR], 1, &light[0].color.r);
-	glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
-	glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
-	glUniform1f(m_parameters[U_LIGHT0_KC], light[0].kC);
-	glUniform1f(m_parameters[U_LIGHT0_KL], light[0].kL);
-	glUniform1f(m_parameters[U_LIGHT0_KQ], light[0].kQ);
-	glUniform1f(m_parameters[U_LIGHT0_COSCUTOFF], cosf(glm::radians<float>(light[0].cosCutoff)));
-	glUniform1f(m_parameters[U_LIGHT0_COSINNER], cosf(glm::radians<float>(light[0].cosInner)));
-	glUniform1f(m_parameters[U_LIGHT0_EXPONENT], light[0].exponent);
+	// Small colored lamps in a grid over the floor, fading out about 4 units away
+	for (int i = 0; i < NUM_LAMPS; ++i)
+	{
+		int row = i / LAMP_COLUMNS, column = i % LAMP_COLUMNS;
+		lampCenters[i] = glm::vec3((column - (LAMP_COLUMNS - 1) * 0.5f) * 4.f, 0.3f, (row - (LAMP_ROWS - 1) * 0.5f) * 4.f);
+		float hue = static_cast<float>(i) / NUM_LAMPS * 6.f;
+		Light& lamp = light[1 + i];
+		lamp.type = Light::LIGHT_POINT;
+		lamp.position = lampCenters[i];
+		lamp.color = glm::clamp(glm::vec3(fabsf(hue - 3.f) - 1.f, 2.f - fabsf(hue - 2.f), 2.f - fabsf(hue - 4.f)), 0.f, 1.f);
+		lamp.power = 1.f;
+		lamp.kC = 1.f;
+		lamp.kL = 0.f;
+		lamp.kQ = 16.f;
+	}
+	lampTime = 0.f;
+
+	// Lights are moved to camera space and uploaded with the frame data
+	renderer->SetLights(light, NUM_LIGHTS);
 
 	enableLight = true;
 
 
 }
 
+/******************************************************************************/
+/*!
+\brief
+Get this scene's meshes and textures from AssetCache. Called by SceneManager
+before Init, or earlier as a prefetch while the player heads for the scene.
+*/
+/******************************************************************************/
+void SceneDucks::LoadAssets()
+{
+	for (int i = 0; i < NUM_GEOMETRY; ++i)
+	{
+		meshList[i] = nullptr;
+	}
+
+	// Meshes and textures stay resident across scene switches
+	AssetCache* assets = AssetCache::GetInstance();
+	meshList[GEO_AXES] = assets->GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
+	meshList[GEO_SPHERE] = assets->GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
+	//meshList[GEO_CUBE] = assets->GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
+	meshList[GEO_PLANE] = assets->GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
+	//meshList[GEO_PLANE]->textureID = assets->LoadTGA("Images//met4.tga");
+	meshList[GEO_FLOOR] = assets->GenerateQuad("LampFloor", glm::vec3(0.6f, 0.6f, 0.6f), 40.f);
+	meshList[GEO_FLOOR]->material.kAmbient = glm::vec3(0.05f, 0.05f, 0.05f);
+	meshList[GEO_FLOOR]->material.kDiffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+	meshList[GEO_FLOOR]->material.kSpecular = glm::vec3(0.2f, 0.2f, 0.2f);
+	meshList[GEO_FLOOR]->material.kShininess = 8.f;
+
+	// OBJ Models
+	meshList[GEO_WALL] = assets->GenerateOBJMTL("Wall", "OBJ//Cube.obj", "OBJ//Cube.mtl");
+
+
+	// Skybox NIGHT
+	/*skybox = assets->LoadCubemap("Images//nightsky_rt.tga", "Images//nightsky_lf.tga", "Images//nightsky_up.tga",
+		"Images//nightsky_dn.tga", "Images//nightsky_ft.tga", "Images//nightsky_bk.tga");*/
+}
+
 
 
 
@@ -185,6 +169,14 @@ void SceneDucks::Update(double dt)
 	if (KeyboardController::GetInstance()->IsKeyDown('P'))
 		light[0].position.y += static_cast<float>(dt) * 5.f;
 
+	// The lamps drift so their clusters change from frame to frame
+	lampTime += static_cast<float>(dt);
+	for (int i = 0; i < NUM_LAMPS; ++i)
+	{
+		float angle = lampTime + i * 0.7f;
+		light[1 + i].position = lampCenters[i] + glm::vec3(cosf(angle), 0.f, sinf(angle));
+	}
+
 
 	// Store position before camera update
 	glm::vec3 oldPos = camera.position;
@@ -226,197 +218,71 @@ void SceneDucks::Render()
 	// Load identity matrix into the model stack
 	modelStack.LoadIdentity();
 
-	if (light[0].type == Light::LIGHT_DIRECTIONAL)
-	{
-		glm::vec3 lightDir(light[0].position.x, light[0].position.y, light[0].position.z);
-		glm::vec3 lightDirection_cameraspace = viewStack.Top() * glm::vec4(lightDir, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightDirection_cameraspace));
-	}
-	else if (light[0].type == Light::LIGHT_SPOT)
-	{
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-		glm::vec3 spotDirection_cameraspace = viewStack.Top() * glm::vec4(light[0].spotDirection, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_SPOTDIRECTION], 1, glm::value_ptr(spotDirection_cameraspace));
-	}
-	else {
-		// Calculate the light position in camera space
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-	}
+	// Camera and lights are the same for every draw of the frame
+	renderer->BeginFrame(viewStack.Top(), projectionStack.Top());
 
 	modelStack.PushMatrix();
 	// Render objects
-	RenderMesh(meshList[GEO_AXES], false);
+	renderer->Submit(meshList[GEO_AXES], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
 	modelStack.PushMatrix();
 	// Render light
 	modelStack.Translate(light[0].position.x, light[0].position.y, light[0].position.z);
 	modelStack.Scale(0.1f, 0.1f, 0.1f);
-	RenderMesh(meshList[GEO_SPHERE], false);
+	renderer->Submit(meshList[GEO_SPHERE], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
+	modelStack.PushMatrix();
+	modelStack.Rotate(-90.f, 1, 0, 0);
+	renderer->Submit(meshList[GEO_FLOOR], modelStack.Top(), true);
+	modelStack.PopMatrix();
 
-	// render tests
-
-
-	// Skybox NIGHT
-	//RenderSkybox();
-
-
-
-}
-
-void SceneDucks::RenderMesh(Mesh* mesh, bool enableLight)
-{
-	glm::mat4 MVP, modelView, modelView_inverse_transpose;
-
-	MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
-	modelView = viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MODELVIEW], 1, GL_FALSE, glm::value_ptr(modelView));
-	if (enableLight)
-	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 1);
-		modelView_inverse_transpose = glm::inverseTranspose(modelView);
-		glUniformMatrix4fv(m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE], 1, GL_FALSE, glm::value_ptr(modelView_inverse_transpose));
-
-		//load material
-		glUniform3fv(m_parameters[U_MATERIAL_AMBIENT], 1, &mesh->material.kAmbient.r);
-		glUniform3fv(m_parameters[U_MATERIAL_DIFFUSE], 1, &mesh->material.kDiffuse.r);
-		glUniform3fv(m_parameters[U_MATERIAL_SPECULAR], 1, &mesh->material.kSpecular.r);
-		glUniform1f(m_parameters[U_MATERIAL_SHININESS], mesh->material.kShininess);
-	}
-	else
-	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	}
-
-
-	if (mesh->textureID > 0)
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-	}
-	else
+	// Every lamp's bulb in one draw, in the lamp's color
+	InstanceData lampInstances[NUM_LAMPS];
+	for (int i = 0; i < NUM_LAMPS; ++i)
 	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 0);
+		modelStack.PushMatrix();
+		modelStack.Translate(light[1 + i].position.x, light[1 + i].position.y, light[1 + i].position.z);
+		modelStack.Scale(0.05f, 0.05f, 0.05f);
+		lampInstances[i].model = modelStack.Top();
+		lampInstances[i].color = glm::vec4(light[1 + i].color, 1.f);
+		modelStack.PopMatrix();
 	}
-
-	mesh->Render();
+	renderer->SubmitInstanced(meshList[GEO_SPHERE], lampInstances, NUM_LAMPS, false);
 
 
+	// render tests
 
-	if (mesh->textureID > 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
 
+	renderer->EndFrame();
 }
 
 
-void SceneDucks::RenderSkybox() {
-	modelStack.PushMatrix();
-
-	// Offset in Z direction by -50 units
-	modelStack.Translate(0.f, 0.f, -50.f);
 
-	// Skybox should be rendered without light
-	RenderMesh(meshList[GEO_FRONT], false);
-	modelStack.PopMatrix();
 
-	// Do the rest of the quads with
-	// appropriate positions and rotations
-	// so that the camera is inside the skybox
-
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 0.f, -50.f);
-	RenderMesh(meshList[GEO_FRONT], false);
-	modelStack.PopMatrix();
-
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 0.f, 50.f);
-	modelStack.Rotate(-180.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_BACK], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(-50.f, 0.f, 0.f);
-	modelStack.Rotate(90.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_LEFT], false);
-	modelStack.PopMatrix();
-
-	modelStack.PushMatrix();
-	modelStack.Translate(50.f, 0.f, 0.f);
-	modelStack.Rotate(-90.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_RIGHT], false);
-	modelStack.PopMatrix();
-
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 50.f, 0.f);
-	modelStack.Rotate(90.f, 1.f, 0.f, 0.f);
-	modelStack.Rotate(90.f, 0.f, 0.f, 1.f);
-	RenderMesh(meshList[GEO_TOP], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, -50.f, 0.f);
-	modelStack.Rotate(-90.f, 1.f, 0.f, 0.f);
-	RenderMesh(meshList[GEO_BOTTOM], false);
-	modelStack.PopMatrix();
-
-}
-
-
-
-void SceneDucks::RenderMeshOnScreen(Mesh* mesh, float x, float
-	y, float sizex, float sizey)
+void SceneDucks::Exit()
 {
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 1920.f, 0.f, 1080.f, -1000.f, 1000.f); // dimension of screen UI
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity();
-
-	// To do: Use modelStack to position GUI on screen
-	modelStack.Translate(x, y, 0);
-
-	// To do: Use modelStack to scale the GUI
-	modelStack.Scale(sizex, sizey, 1);
-
-	RenderMesh(mesh, false); //UI should not have light
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-
-	glEnable(GL_DEPTH_TEST);
+	// Meshes and textures are handed back in UnloadAssets, called by SceneManager
 }
 
-
-
-
-
-
-void SceneDucks::Exit()
+void SceneDucks::UnloadAssets()
 {
-	// Cleanup VBO here
+	// Hand meshes and textures back to the cache, which keeps them for the next scene
+	AssetCache* assets = AssetCache::GetInstance();
 	for (int i = 0; i < NUM_GEOMETRY; ++i)
 	{
 		if (meshList[i])
 		{
-			delete meshList[i];
+			assets->ReleaseTexture(meshList[i]->textureID);
+			assets->ReleaseMesh(meshList[i]);
+			meshList[i] = nullptr;
 		}
 	}
-	glDeleteVertexArrays(1, &m_vertexArrayID);
-	glDeleteProgram(m_programID);
+	assets->ReleaseTexture(skybox);
+	skybox = 0;
 }
 
 void SceneDucks::HandleKeyPress()
@@ -457,7 +323,6 @@ void SceneDucks::HandleKeyPress()
 			light[0].power = 1.f;
 		else
 			light[0].power = 0.1f;
-		glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
 	}
 
 	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_TAB))
@@ -471,8 +336,6 @@ void SceneDucks::HandleKeyPress()
 		else {
 			light[0].type = Light::LIGHT_POINT;
 		}
-
-		glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
 	}
 
 }
@@ -506,96 +369,3 @@ void SceneDucks::HandleMouseInput() {
 
 	// Continue to do for right button
 }
-
-
-
-void SceneDucks::RenderText(Mesh* mesh, std::string text, glm::vec3
-	color)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	// Disable back face culling
-	glDisable(GL_CULL_FACE);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(i * 1.0f, 0, 0));
-		glm::mat4 MVP = projectionStack.Top() * viewStack.Top() *
-			modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	glEnable(GL_CULL_FACE);
-	glDisable(GL_BLEND);
-}
-
-
-
-void SceneDucks::RenderTextOnScreen(Mesh* mesh, std::string
-	text, glm::vec3 color, float size, float x, float y)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 800.f, 0.f, 600.f, -100.f, 100.f); // dimension of screen UI
-
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode 
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity(); //Reset modelStack
-	modelStack.Translate(x, y, 0);
-	modelStack.Scale(size, size, size);
-
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(0.5f + i * 1.0f, 0.5f, 0)
-		);
-		glm::mat4 MVP = projectionStack.Top() *
-			viewStack.Top() * modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-	glEnable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
-}
\ No newline at end of file
@@ -17,6 +17,7 @@ public:
 		GEO_SPHERE,
 		GEO_CUBE,
 		GEO_PLANE,
+		GEO_FLOOR,
 		GEO_WALL,
 
 		OBJ_CASH_REGISTER,
@@ -28,13 +29,6 @@ public:
 
 		GEO_SHUTTER,
 
-		GEO_LEFT,
-		GEO_RIGHT,
-		GEO_TOP,
-		GEO_BOTTOM,
-		GEO_FRONT,
-		GEO_BACK,
-
 		GEO_KIOSK_FLOOR,
 		GEO_KIOSK_WALL,
 		GEO_KIOSK_COUNTER,
@@ -56,39 +50,6 @@ public:
 		NUM_GEOMETRY,
 	};
 
-	enum UNIFORM_TYPE
-	{
-		U_MVP = 0,
-		U_MODELVIEW,
-		U_MODELVIEW_INVERSE_TRANSPOSE,
-		U_MATERIAL_AMBIENT,
-		U_MATERIAL_DIFFUSE,
-		U_MATERIAL_SPECULAR,
-		U_MATERIAL_SHININESS,
-		U_LIGHT0_TYPE,
-		U_LIGHT0_POSITION,
-		U_LIGHT0_COLOR,
-		U_LIGHT0_POWER,
-		U_LIGHT0_KC,
-		U_LIGHT0_KL,
-		U_LIGHT0_KQ,
-		U_LIGHT0_SPOTDIRECTION,
-		U_LIGHT0_COSCUTOFF,
-		U_LIGHT0_COSINNER,
-		U_LIGHT0_EXPONENT,
-		U_NUMLIGHTS,
-		U_COLOR_TEXTURE_ENABLED,
-		U_COLOR_TEXTURE,
-		U_LIGHTENABLED,
-
-
-		U_TEXT_ENABLED,
-		U_TEXT_COLOR,
-
-		U_TOTAL,
-	};
-
-
 	enum GameState
 	{
 		GAME_NOT_STARTED = 0,
@@ -113,16 +74,14 @@ public:
 	virtual void Update(double dt);
 	virtual void Render();
 	virtual void Exit();
+	virtual void LoadAssets();
+	virtual void UnloadAssets();
 
 private:
 	void HandleKeyPress();
-	void RenderMesh(Mesh* mesh, bool enableLight);
 
-	unsigned m_vertexArrayID;
 	Mesh* meshList[NUM_GEOMETRY];
-
-	unsigned m_programID;
-	unsigned m_parameters[U_TOTAL];
+	unsigned skybox; // cube map from AssetCache, 0 while the sky is off or failed to load
 
 	//AltAzCamera camera;
 	int projType = 1; // fix to 0 for orthographic, 1 for projection
@@ -131,8 +90,15 @@ private:
 
 	MatrixStack modelStack, viewStack, projectionStack;
 
-	static const int NUM_LIGHTS = 1;
+	// light[0] is moved by the keyboard, the rest are lamps over the floor.
+	// More lights than the shaders' MAX_LIGHTS are clustered by the renderer.
+	static const int LAMP_ROWS = 4;
+	static const int LAMP_COLUMNS = 8;
+	static const int NUM_LAMPS = LAMP_ROWS * LAMP_COLUMNS;
+	static const int NUM_LIGHTS = 1 + NUM_LAMPS;
 	Light light[NUM_LIGHTS];
+	glm::vec3 lampCenters[NUM_LAMPS]; // each lamp circles its center
+	float lampTime;
 	bool enableLight;
 
 
@@ -186,16 +152,9 @@ private:
 	glm::vec3 playerSize;
 	bool CheckWallCollision(const glm::vec3& pos);
 
-	void RenderSkybox();
-	void RenderMeshOnScreen(Mesh* mesh, float x, float y,
-		float sizex, float sizey);
 
 	void HandleMouseInput();
 
-	void RenderText(Mesh* mesh, std::string text, glm::vec3
-		color);
-	void RenderTextOnScreen(Mesh* mesh, std::string text,
-		glm::vec3 color, float size, float x, float y);
 
 	float fps = 0;
 };
@@ -12,15 +12,40 @@
 
 #include <iostream>
 
-#include "shader.hpp"
 #include "Application.h"
 #include "MeshBuilder.h"
 #include "KeyboardController.h"
 #include "MouseController.h"
 #include "LoadTGA.h"
+#include "Renderer.h"
+#include "AssetCache.h"
+#include "LightBaker.h"
+
+namespace
+{
+	// Tint of each door and of the floor behind it
+	const glm::vec3 DOOR_COLORS[] = {
+		glm::vec3(0.2f, 0.2f, 0.2f),
+		glm::vec3(1.0f, 0.2f, 0.2f),
+		glm::vec3(0.2f, 1.0f, 0.2f),
+		glm::vec3(0.2f, 0.2f, 1.0f),
+	};
+
+	// The door's panel as Render draws it, swung rotation degrees about its
+	// middle; closed, it is also the door's portal and its occluder in the bake
+	glm::mat4 DoorModel(const Door& door, float rotation)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.f), door.position);
+		model = glm::rotate(model, glm::radians(rotation), glm::vec3(0.f, 1.f, 0.f));
+		return glm::scale(model, glm::vec3(door.width, door.height, 0.2f));
+	}
+}
 
 SceneLobby::SceneLobby()
+	: skybox(0)
 {
+	for (Mesh*& floor : bakedFloors)
+		floor = nullptr;
 }
 
 SceneLobby::~SceneLobby()
@@ -41,40 +66,6 @@ void SceneLobby::Init()
 	//Default to fill mode
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	// Generate a default VAO for now
-	glGenVertexArrays(1, &m_vertexArrayID);
-	glBindVertexArray(m_vertexArrayID);
-
-	// Load the shader programs
-	m_programID = LoadShaders("Shader//Texture.vertexshader", "Shader//Text.fragmentshader");
-	glUseProgram(m_programID);
-
-	// Get a handle for our "MVP" uniform
-	m_parameters[U_MVP] = glGetUniformLocation(m_programID, "MVP");
-	m_parameters[U_MODELVIEW] = glGetUniformLocation(m_programID, "MV");
-	m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(m_programID, "MV_inverse_transpose");
-	m_parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(m_programID, "material.kAmbient");
-	m_parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(m_programID, "material.kDiffuse");
-	m_parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(m_programID, "material.kSpecular");
-	m_parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(m_programID, "material.kShininess");
-	m_parameters[U_LIGHT0_TYPE] = glGetUniformLocation(m_programID, "lights[0].type");
-	m_parameters[U_LIGHT0_POSITION] = glGetUniformLocation(m_programID, "lights[0].position_cameraspace");
-	m_parameters[U_LIGHT0_COLOR] = glGetUniformLocation(m_programID, "lights[0].color");
-	m_parameters[U_LIGHT0_POWER] = glGetUniformLocation(m_programID, "lights[0].power");
-	m_parameters[U_LIGHT0_KC] = glGetUniformLocation(m_programID, "lights[0].kC");
-	m_parameters[U_LIGHT0_KL] = glGetUniformLocation(m_programID, "lights[0].kL");
-	m_parameters[U_LIGHT0_KQ] = glGetUniformLocation(m_programID, "lights[0].kQ");
-	m_parameters[U_LIGHT0_SPOTDIRECTION] = glGetUniformLocation(m_programID, "lights[0].spotDirection");
-	m_parameters[U_LIGHT0_COSCUTOFF] = glGetUniformLocation(m_programID, "lights[0].cosCutoff");
-	m_parameters[U_LIGHT0_COSINNER] = glGetUniformLocation(m_programID, "lights[0].cosInner");
-	m_parameters[U_LIGHT0_EXPONENT] = glGetUniformLocation(m_programID, "lights[0].exponent");
-	m_parameters[U_LIGHTENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
-	m_parameters[U_NUMLIGHTS] = glGetUniformLocation(m_programID, "numLights");
-	m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(m_programID, "colorTextureEnabled");
-	m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(m_programID, "colorTexture");
-	m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(m_programID, "textEnabled");
-	m_parameters[U_TEXT_COLOR] = glGetUniformLocation(m_programID, "textColor");
-
 	// Initialise camera properties
 	//camera.Init(45.f, 45.f, 10.f);
 	camera.Init(
@@ -83,44 +74,11 @@ void SceneLobby::Init()
 		glm::vec3(0, 1.0f, 0)		// up
 	);
 
-	// Init VBO here
-	for (int i = 0; i < NUM_GEOMETRY; ++i)
-	{
-		meshList[i] = nullptr;
-	}
-
-	meshList[GEO_AXES] = MeshBuilder::GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
-	meshList[GEO_SPHERE] = MeshBuilder::GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
-	meshList[GEO_CUBE] = MeshBuilder::GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
-	meshList[GEO_PLANE] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
-	//meshList[GEO_PLANE]->textureID = LoadTGA("Images//met4.tga");
-
-	meshList[GEO_DOOR] = MeshBuilder::GenerateCube("Door", glm::vec3(1.f, 1.f, 1.f), 1.f);
-
-	meshList[GEO_TEXT] = MeshBuilder::GenerateText("text", 16, 16);
-	meshList[GEO_TEXT]->textureID = LoadTGA("Images//calibri.tga");
-
-	// OBJ Models
-
-
-	// Skybox NIGHT
-	/*meshList[GEO_LEFT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_LEFT]->textureID = LoadTGA("Images//nightsky_lf.tga");
-
-	meshList[GEO_RIGHT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_RIGHT]->textureID = LoadTGA("Images//nightsky_rt.tga");
-
-	meshList[GEO_TOP] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_TOP]->textureID = LoadTGA("Images//nightsky_up.tga");
-
-	meshList[GEO_BOTTOM] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BOTTOM]->textureID = LoadTGA("Images//nightsky_dn.tga");
+	// Text is drawn in one batch per frame, spaced like the old per-character draws
+	renderer->SetFont(meshList[GEO_TEXT] ? meshList[GEO_TEXT]->textureID : 0,
+		0.6f, glm::vec2(0.2f, 0.f), glm::vec2(0.2f, 0.f));
 
-	meshList[GEO_FRONT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_FRONT]->textureID = LoadTGA("Images//nightsky_bk.tga");
-
-	meshList[GEO_BACK] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BACK]->textureID = LoadTGA("Images//nightsky_ft.tga ");*/
+	renderer->SetSkybox(skybox);
 
 
 
@@ -138,8 +96,6 @@ void SceneLobby::Init()
 
 
 
-	glUniform1i(m_parameters[U_NUMLIGHTS], 2);
-
 	light[0].position = glm::vec3(0, 5, 0);
 	light[0].color = glm::vec3(1, 1, 1);
 	light[0].type = Light::LIGHT_POINT;
@@ -152,15 +108,8 @@ void SceneLobby::Init()
 	light[0].exponent = 3.f;
 	light[0].spotDirection = glm::vec3(0.f, 1.f, 0.f);
 
-	glUniform3fv(m_parameters[U_LIGHT0_COLOR], 1, &light[0].color.r);
-	glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
-	glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
-	glUniform1f(m_parameters[U_LIGHT0_KC], light[0].kC);
-	glUniform1f(m_parameters[U_LIGHT0_KL], light[0].kL);
-	glUniform1f(m_parameters[U_LIGHT0_KQ], light[0].kQ);
-	glUniform1f(m_parameters[U_LIGHT0_COSCUTOFF], cosf(glm::radians<float>(light[0].cosCutoff)));
-	glUniform1f(m_parameters[U_LIGHT0_COSINNER], cosf(glm::radians<float>(light[0].cosInner)));
-	glUniform1f(m_parameters[U_LIGHT0_EXPONENT], light[0].exponent);
+	// Lights are moved to camera space and uploaded with the frame data
+	renderer->SetLights(light, NUM_LIGHTS);
 
 	enableLight = true;
 
@@ -170,6 +119,136 @@ void SceneLobby::Init()
 	doors[2] = { glm::vec3(0.0f, 0.0f, 8.0f), 1.5f, 2.5f, SceneManager::SCENE_CANS };  
 	doors[3] = { glm::vec3(0.0f, 0.0f, -8.0f), 1.5f, 2.5f, SceneManager::SCENE_TANK };  
 
+	// Demo floors, baked the first time F1 shows them
+	floorsEnabled = false;
+
+	BuildPortalGraph();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Make the lobby a cell, add one cell for the room behind each door, reaching
+ROOM_DEPTH outwards, and join each room to the lobby with its door's closed
+panel
+*/
+/******************************************************************************/
+void SceneLobby::BuildPortalGraph()
+{
+	const float LOBBY_HALF_SIZE = 8.f;
+	const float ROOM_DEPTH = 10.f;
+	const float FLOOR = -2.f, CEILING = 10.f;
+
+	portalGraph.Clear();
+	lobbyCell = portalGraph.AddCell(glm::vec3(-LOBBY_HALF_SIZE, FLOOR, -LOBBY_HALF_SIZE),
+		glm::vec3(LOBBY_HALF_SIZE, CEILING, LOBBY_HALF_SIZE));
+
+	const glm::vec3 up(0.f, 1.f, 0.f);
+	for (int i = 0; i < NUM_DOORS; ++i)
+	{
+		glm::vec3 outward = glm::normalize(glm::vec3(doors[i].position.x, 0.f, doors[i].position.z));
+		glm::vec3 side = glm::cross(up, outward);
+
+		glm::vec3 center = doors[i].position + outward * (ROOM_DEPTH * 0.5f);
+		glm::vec3 extent = glm::abs(outward) * (ROOM_DEPTH * 0.5f) + glm::abs(side) * LOBBY_HALF_SIZE;
+		roomCells[i] = portalGraph.AddCell(glm::vec3(center.x - extent.x, FLOOR, center.z - extent.z),
+			glm::vec3(center.x + extent.x, CEILING, center.z + extent.z));
+
+		// The middle of the closed panel, so portal, panel and occluder match
+		glm::mat4 model = DoorModel(doors[i], 0.f);
+		glm::vec3 corners[4] = {
+			glm::vec3(model * glm::vec4(-0.5f, -0.5f, 0.f, 1.f)),
+			glm::vec3(model * glm::vec4(0.5f, -0.5f, 0.f, 1.f)),
+			glm::vec3(model * glm::vec4(0.5f, 0.5f, 0.f, 1.f)),
+			glm::vec3(model * glm::vec4(-0.5f, 0.5f, 0.f, 1.f)),
+		};
+		doorPortals[i] = portalGraph.AddPortal(lobbyCell, roomCells[i], corners);
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Light the lobby floor and each room's floor with the lights as they are the
+first time F1 shows them, the closed doors casting shadows and occluding
+ambient light. Moving a light later leaves the floors as baked. The result is kept in Models// and
+only baked again when the floors, doors or lights change.
+*/
+/******************************************************************************/
+void SceneLobby::BakeFloors()
+{
+	const float LOBBY_SIZE = 16.f, ROOM_SIZE = 10.f;
+	const unsigned LOBBY_DIVISIONS = 64, ROOM_DIVISIONS = 40;
+
+	Material material;
+	material.kAmbient = glm::vec3(0.3f, 0.3f, 0.3f);
+	material.kDiffuse = glm::vec3(0.7f, 0.7f, 0.7f);
+
+	LightBaker baker;
+	for (int i = 0; i < NUM_DOORS; ++i)
+	{
+		baker.AddOccluderBox(DoorModel(doors[i], 0.f));
+	}
+
+	// The floors lie at the bottom of the doors, turned from facing +z to facing up
+	const glm::mat4 faceUp = glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
+	float floorY = doors[0].position.y - doors[0].height * 0.5f;
+	MeshData floors[1 + NUM_DOORS];
+	floorModels[0] = glm::translate(glm::mat4(1.f), glm::vec3(0.f, floorY, 0.f)) * faceUp;
+	MeshBuilder::GenerateGridData(glm::vec3(0.8f, 0.8f, 0.8f), LOBBY_SIZE, LOBBY_DIVISIONS, floors[0]);
+	baker.AddReceiver(floors[0], floorModels[0], material, "Models//LobbyFloor.meshbin");
+	for (int i = 0; i < NUM_DOORS; ++i)
+	{
+		glm::vec3 outward = glm::normalize(glm::vec3(doors[i].position.x, 0.f, doors[i].position.z));
+		glm::vec3 center = doors[i].position + outward * (ROOM_SIZE * 0.5f);
+		floorModels[1 + i] = glm::translate(glm::mat4(1.f), glm::vec3(center.x, floorY, center.z)) * faceUp;
+		MeshBuilder::GenerateGridData(DOOR_COLORS[i], ROOM_SIZE, ROOM_DIVISIONS, floors[1 + i]);
+		baker.AddReceiver(floors[1 + i], floorModels[1 + i], material,
+			"Models//LobbyRoom" + std::to_string(i) + ".meshbin");
+	}
+	baker.Bake(light, NUM_LIGHTS);
+
+	for (int i = 0; i < 1 + NUM_DOORS; ++i)
+	{
+		delete bakedFloors[i];
+		bakedFloors[i] = new Mesh(i == 0 ? "LobbyFloor" : "LobbyRoom");
+		MeshBuilder::UploadMeshData(bakedFloors[i], floors[i]);
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Get this scene's meshes and textures from AssetCache. Called by SceneManager
+before Init, or earlier as a prefetch while the player heads for the scene.
+*/
+/******************************************************************************/
+void SceneLobby::LoadAssets()
+{
+	for (int i = 0; i < NUM_GEOMETRY; ++i)
+	{
+		meshList[i] = nullptr;
+	}
+
+	// Meshes and textures stay resident across scene switches
+	AssetCache* assets = AssetCache::GetInstance();
+	meshList[GEO_AXES] = assets->GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
+	meshList[GEO_SPHERE] = assets->GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
+	meshList[GEO_CUBE] = assets->GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
+	meshList[GEO_PLANE] = assets->GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
+	//meshList[GEO_PLANE]->textureID = assets->LoadTGA("Images//met4.tga");
+
+	meshList[GEO_DOOR] = assets->GenerateCube("Door", glm::vec3(1.f, 1.f, 1.f), 1.f);
+
+	meshList[GEO_TEXT] = assets->GenerateText("text", 16, 16);
+	meshList[GEO_TEXT]->textureID = assets->LoadTGA("Images//calibri.tga", false);
+
+	// OBJ Models
+
+
+	// Skybox NIGHT
+	/*skybox = assets->LoadCubemap("Images//nightsky_rt.tga", "Images//nightsky_lf.tga", "Images//nightsky_up.tga",
+		"Images//nightsky_dn.tga", "Images//nightsky_ft.tga", "Images//nightsky_bk.tga");*/
 }
 
 
@@ -218,6 +297,22 @@ void SceneLobby::Update(double dt)
 		}
 	}
 
+	// Start loading the scene behind the nearest door, so walking through it
+	// finds everything resident; drop the hint once the player walks away
+	bool anyDoorOpen = false;
+	for (int i = 0; i < NUM_DOORS; ++i)
+	{
+		anyDoorOpen = anyDoorOpen || doors[i].isOpen;
+	}
+	if (activeDoorIndex >= 0)
+	{
+		SceneManager::GetInstance()->PrefetchScene(doors[activeDoorIndex].leadsTo);
+	}
+	else if (!anyDoorOpen)
+	{
+		SceneManager::GetInstance()->CancelPrefetch();
+	}
+
 	// E to open the nearest door
 	if (showInteractPrompt && activeDoorIndex >= 0 &&
 		KeyboardController::GetInstance()->IsKeyPressed('E'))
@@ -264,223 +359,113 @@ void SceneLobby::Render()
 	// Load identity matrix into the model stack
 	modelStack.LoadIdentity();
 
-	if (light[0].type == Light::LIGHT_DIRECTIONAL)
-	{
-		glm::vec3 lightDir(light[0].position.x, light[0].position.y, light[0].position.z);
-		glm::vec3 lightDirection_cameraspace = viewStack.Top() * glm::vec4(lightDir, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightDirection_cameraspace));
-	}
-	else if (light[0].type == Light::LIGHT_SPOT)
-	{
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-		glm::vec3 spotDirection_cameraspace = viewStack.Top() * glm::vec4(light[0].spotDirection, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_SPOTDIRECTION], 1, glm::value_ptr(spotDirection_cameraspace));
-	}
-	else {
-		// Calculate the light position in camera space
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-	}
+	// Camera and lights are the same for every draw of the frame
+	renderer->BeginFrame(viewStack.Top(), projectionStack.Top());
 
 	modelStack.PushMatrix();
 	// Render objects
-	RenderMesh(meshList[GEO_AXES], false);
+	renderer->Submit(meshList[GEO_AXES], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
 	modelStack.PushMatrix();
 	// Render light
 	modelStack.Translate(light[0].position.x, light[0].position.y, light[0].position.z);
 	modelStack.Scale(0.1f, 0.1f, 0.1f);
-	RenderMesh(meshList[GEO_SPHERE], false);
+	renderer->Submit(meshList[GEO_SPHERE], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
 
 
-	// Skybox NIGHT
-	//RenderSkybox();
-
-	//render doors
-	for (int i = 0; i < 4; i++)
-	{
-		modelStack.PushMatrix();
-		modelStack.Translate(doors[i].position.x, doors[i].position.y, doors[i].position.z);
-		modelStack.Rotate(doors[i].rotation, 0, 1, 0);   // use Door's own rotation
-		modelStack.Scale(doors[i].width, doors[i].height, 0.2f);
-
-		if(i == 0)
-			meshList[GEO_DOOR]->material.kAmbient = glm::vec3(0.1f, 0.1f, 0.1f);
-		else if (i==1)
-			meshList[GEO_DOOR]->material.kAmbient = glm::vec3(0.5f, 0.1f, 0.1f);
-		else if (i==2)
-			meshList[GEO_DOOR]->material.kAmbient = glm::vec3(0.1f, 0.5f, 0.1f);
-		else if (i==3)
-			meshList[GEO_DOOR]->material.kAmbient = glm::vec3(0.1f, 0.1f, 0.5f);
-
-		meshList[GEO_DOOR]->material.kDiffuse = glm::vec3(0.5f, 0.5f, 0.5f);
-		meshList[GEO_DOOR]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
-		RenderMesh(meshList[GEO_DOOR], true);
-		modelStack.PopMatrix();
-
-		if (showInteractPrompt)
-			RenderTextOnScreen(meshList[GEO_TEXT], "Press E to enter", glm::vec3(1.f, 1.f, 0.f), 40, 50, 50);
-	}
-
-}
-
-void SceneLobby::RenderMesh(Mesh* mesh, bool enableLight)
-{
-	glm::mat4 MVP, modelView, modelView_inverse_transpose;
 
-	MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
-	modelView = viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MODELVIEW], 1, GL_FALSE, glm::value_ptr(modelView));
-	if (enableLight)
+	// A door lets the view through from the moment it starts to swing open
+	for (int i = 0; i < NUM_DOORS; ++i)
 	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 1);
-		modelView_inverse_transpose = glm::inverseTranspose(modelView);
-		glUniformMatrix4fv(m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE], 1, GL_FALSE, glm::value_ptr(modelView_inverse_transpose));
-
-		//load material
-		glUniform3fv(m_parameters[U_MATERIAL_AMBIENT], 1, &mesh->material.kAmbient.r);
-		glUniform3fv(m_parameters[U_MATERIAL_DIFFUSE], 1, &mesh->material.kDiffuse.r);
-		glUniform3fv(m_parameters[U_MATERIAL_SPECULAR], 1, &mesh->material.kSpecular.r);
-		glUniform1f(m_parameters[U_MATERIAL_SHININESS], mesh->material.kShininess);
+		portalGraph.SetPortalOpen(doorPortals[i], doors[i].isOpen || doors[i].rotation != 0.f);
 	}
-	else
+	portalGraph.Update(viewStack.Top(), projectionStack.Top(), camera.position);
+	renderer->CountCells(portalGraph.GetVisibleCellCount(),
+		portalGraph.GetCellCount() - portalGraph.GetVisibleCellCount());
+
+	// The rooms themselves are their own scenes. With F1 the lobby shows a
+	// floor of its own and one behind each door, in the door's color, only
+	// where its cell is visible; nothing walls them in, so a closed door
+	// hides its floor even where it is in plain view, which shows what the
+	// portals cull. The floors carry their light in their vertex colors.
+	if (floorsEnabled)
 	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 0);
+		renderer->Submit(bakedFloors[0], floorModels[0], false);
+		for (int i = 0; i < NUM_DOORS; i++)
+		{
+			if (portalGraph.IsCellVisible(roomCells[i]))
+				renderer->Submit(bakedFloors[1 + i], floorModels[1 + i], false);
+		}
 	}
 
-
-	if (mesh->textureID > 0)
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-	}
-	else
+	//render doors as one instanced draw; each door's color comes from its instance tint
+	InstanceData doorInstances[NUM_DOORS];
+	for (int i = 0; i < NUM_DOORS; i++)
 	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 0);
+		modelStack.PushMatrix();
+		modelStack.MultMatrix(DoorModel(doors[i], doors[i].rotation));   // use Door's own rotation
+		doorInstances[i].model = modelStack.Top();
+		doorInstances[i].color = glm::vec4(DOOR_COLORS[i], 1.f);
+		modelStack.PopMatrix();
 	}
 
-	mesh->Render();
+	meshList[GEO_DOOR]->material.kAmbient = glm::vec3(0.5f, 0.5f, 0.5f);
+	meshList[GEO_DOOR]->material.kDiffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+	meshList[GEO_DOOR]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
+	renderer->SubmitInstanced(meshList[GEO_DOOR], doorInstances, NUM_DOORS, true);
 
+	renderer->Flush();
 
+	if (showInteractPrompt)
+		renderer->RenderTextOnScreen("Press E to enter", glm::vec3(1.f, 1.f, 0.f), 40, 50, 50);
 
-	if (mesh->textureID > 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
-
+	renderer->EndFrame();
 }
 
 
-void SceneLobby::RenderSkybox() {
-	modelStack.PushMatrix();
-
-	// Offset in Z direction by -50 units
-	modelStack.Translate(0.f, 0.f, -50.f);
-
-	// Skybox should be rendered without light
-	RenderMesh(meshList[GEO_FRONT], false);
-	modelStack.PopMatrix();
-
-	// Do the rest of the quads with
-	// appropriate positions and rotations
-	// so that the camera is inside the skybox
-
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 0.f, -50.f);
-	RenderMesh(meshList[GEO_FRONT], false);
-	modelStack.PopMatrix();
-
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 0.f, 50.f);
-	modelStack.Rotate(-180.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_BACK], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(-50.f, 0.f, 0.f);
-	modelStack.Rotate(90.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_LEFT], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(50.f, 0.f, 0.f);
-	modelStack.Rotate(-90.f, 0.f, 1.f, 0.f);
-	RenderMesh(meshList[GEO_RIGHT], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, 50.f, 0.f);
-	modelStack.Rotate(90.f, 1.f, 0.f, 0.f);
-	modelStack.Rotate(90.f, 0.f, 0.f, 1.f);
-	RenderMesh(meshList[GEO_TOP], false);
-	modelStack.PopMatrix();
 
-	modelStack.PushMatrix();
-	modelStack.Translate(0.f, -50.f, 0.f);
-	modelStack.Rotate(-90.f, 1.f, 0.f, 0.f);
-	RenderMesh(meshList[GEO_BOTTOM], false);
-	modelStack.PopMatrix();
-
-}
-
-
-
-void SceneLobby::RenderMeshOnScreen(Mesh* mesh, float x, float
-	y, float sizex, float sizey)
+void SceneLobby::Exit()
 {
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 1920.f, 0.f, 1080.f, -1000.f, 1000.f); // dimension of screen UI
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity();
-
-	// To do: Use modelStack to position GUI on screen
-	modelStack.Translate(x, y, 0);
-
-	// To do: Use modelStack to scale the GUI
-	modelStack.Scale(sizex, sizey, 1);
-
-	RenderMesh(mesh, false); //UI should not have light
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-
-	glEnable(GL_DEPTH_TEST);
+	// Meshes and textures are handed back in UnloadAssets, called by SceneManager
+	for (Mesh*& floor : bakedFloors)
+	{
+		delete floor;
+		floor = nullptr;
+	}
 }
 
-
-
-
-
-
-void SceneLobby::Exit()
+void SceneLobby::UnloadAssets()
 {
-	// Cleanup VBO here
+	// Hand meshes and textures back to the cache, which keeps them for the next scene
+	AssetCache* assets = AssetCache::GetInstance();
 	for (int i = 0; i < NUM_GEOMETRY; ++i)
 	{
 		if (meshList[i])
 		{
-			delete meshList[i];
+			assets->ReleaseTexture(meshList[i]->textureID);
+			assets->ReleaseMesh(meshList[i]);
+			meshList[i] = nullptr;
 		}
 	}
-	glDeleteVertexArrays(1, &m_vertexArrayID);
-	glDeleteProgram(m_programID);
+	assets->ReleaseTexture(skybox);
+	skybox = 0;
 }
 
 void SceneLobby::HandleKeyPress()
 {
+	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_F1))
+	{
+		// Toggle the baked floors of the lobby and of the rooms behind the doors
+		floorsEnabled = !floorsEnabled;
+		if (floorsEnabled && !bakedFloors[0])
+			BakeFloors();
+	}
 	if (KeyboardController::GetInstance()->IsKeyPressed(0x31))
 	{
 		// Key press to enable culling
@@ -517,7 +502,6 @@ void SceneLobby::HandleKeyPress()
 			light[0].power = 1.f;
 		else
 			light[0].power = 0.1f;
-		glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
 	}
 
 	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_TAB))
@@ -531,8 +515,6 @@ void SceneLobby::HandleKeyPress()
 		else {
 			light[0].type = Light::LIGHT_POINT;
 		}
-
-		glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
 	}
 }
 
@@ -565,97 +547,3 @@ void SceneLobby::HandleMouseInput() {
 
 	// Continue to do for right button
 }
-
-
-
-void SceneLobby::RenderText(Mesh* mesh, std::string text, glm::vec3
-	color)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	// Disable back face culling
-	glDisable(GL_CULL_FACE);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(0.2f + i * 0.6f, 0.f, 0)
-		);
-		glm::mat4 MVP = projectionStack.Top() * viewStack.Top() *
-			modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	glEnable(GL_CULL_FACE);
-	glDisable(GL_BLEND);
-}
-
-
-
-void SceneLobby::RenderTextOnScreen(Mesh* mesh, std::string
-	text, glm::vec3 color, float size, float x, float y)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 800.f, 0.f, 600.f, -100.f, 100.f); // dimension of screen UI
-
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode 
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity(); //Reset modelStack
-	modelStack.Translate(x, y, 0);
-	modelStack.Scale(size, size, size);
-
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(0.2f + i * 0.6f, 0.f, 0)
-		);
-		glm::mat4 MVP = projectionStack.Top() *
-			viewStack.Top() * modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-	glEnable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
-}
\ No newline at end of file
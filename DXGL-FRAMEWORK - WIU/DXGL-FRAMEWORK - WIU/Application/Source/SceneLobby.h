@@ -9,6 +9,7 @@
 #include "Light.h"
 #include "SceneManager.h"
 #include "Door.h"
+#include "PortalGraph.h"
 #include <iostream>
 
 class SceneLobby : public Scene
@@ -21,13 +22,6 @@ public:
 		GEO_CUBE,
 		GEO_PLANE,
 
-		GEO_LEFT,
-		GEO_RIGHT,
-		GEO_TOP,
-		GEO_BOTTOM,
-		GEO_FRONT,
-		GEO_BACK,
-
 		GEO_DOOR_HOLE,
 		GEO_DOOR,
 
@@ -41,39 +35,6 @@ public:
 		NUM_GEOMETRY,
 	};
 
-	enum UNIFORM_TYPE
-	{
-		U_MVP = 0,
-		U_MODELVIEW,
-		U_MODELVIEW_INVERSE_TRANSPOSE,
-		U_MATERIAL_AMBIENT,
-		U_MATERIAL_DIFFUSE,
-		U_MATERIAL_SPECULAR,
-		U_MATERIAL_SHININESS,
-		U_LIGHT0_TYPE,
-		U_LIGHT0_POSITION,
-		U_LIGHT0_COLOR,
-		U_LIGHT0_POWER,
-		U_LIGHT0_KC,
-		U_LIGHT0_KL,
-		U_LIGHT0_KQ,
-		U_LIGHT0_SPOTDIRECTION,
-		U_LIGHT0_COSCUTOFF,
-		U_LIGHT0_COSINNER,
-		U_LIGHT0_EXPONENT,
-		U_NUMLIGHTS,
-		U_COLOR_TEXTURE_ENABLED,
-		U_COLOR_TEXTURE,
-		U_LIGHTENABLED,
-
-
-		U_TEXT_ENABLED,
-		U_TEXT_COLOR,
-
-		U_TOTAL,
-	};
-
-
 	enum GameState
 	{
 		GAME_NOT_STARTED = 0,
@@ -90,22 +51,16 @@ public:
 	virtual void Update(double dt);
 	virtual void Render();
 	virtual void Exit();
+	virtual void LoadAssets();
+	virtual void UnloadAssets();
 
 private:
 	void HandleKeyPress();
-	void RenderMesh(Mesh* mesh, bool enableLight);
-	void RenderSkybox();
-	void RenderMeshOnScreen(Mesh* mesh, float x, float y, float sizex, float sizey);
-	void RenderText(Mesh* mesh, std::string text, glm::vec3	color);
-	void RenderTextOnScreen(Mesh* mesh, std::string text, glm::vec3 color, float size, float x, float y);
 
 	void HandleMouseInput();
 
-	unsigned m_vertexArrayID;
 	Mesh* meshList[NUM_GEOMETRY];
-
-	unsigned m_programID;
-	unsigned m_parameters[U_TOTAL];
+	unsigned skybox; // cube map from AssetCache, 0 while the sky is off or failed to load
 
 	//AltAzCamera camera;
 	int projType = 1; // fix to 0 for orthographic, 1 for projection
@@ -127,6 +82,21 @@ private:
 	int activeDoorIndex;
 	bool showInteractPrompt;
 
+	// The lobby and the room behind each door are cells, the doors portals
+	PortalGraph portalGraph;
+	unsigned lobbyCell;
+	unsigned roomCells[NUM_DOORS];
+	unsigned doorPortals[NUM_DOORS];
+	void BuildPortalGraph();
+
+	// Lobby floor, then the floor behind each door, to see the portals cull;
+	// shown with F1, off by default. Lit once by BakeFloors and drawn unlit;
+	// owned by the scene, not AssetCache
+	bool floorsEnabled;
+	Mesh* bakedFloors[1 + NUM_DOORS];
+	glm::mat4 floorModels[1 + NUM_DOORS];
+	void BakeFloors();
+
 
 
 	// light 
@@ -4,6 +4,17 @@
 #include "SceneShooting.h"
 #include "SceneCans.h"
 #include "SceneTank.h"
+#include "UniformCache.h"
+#include "AssetCache.h"
+#include <GL\glew.h>
+
+#include <iostream>
+
+namespace
+{
+    // Seconds per frame the GL thread may spend uploading loaded assets
+    const double UPLOAD_BUDGET = 0.004;
+}
 
 SceneManager* SceneManager::m_instance = nullptr;
 
@@ -12,6 +23,15 @@ SceneManager::SceneManager(void)
 	, currentSceneType(SCENE_LOBBY) //switch to lobby first since menu is not implemented yet
     , nextSceneType(SCENE_LOBBY)
     , needsSwitch(false)
+    , loading(false)
+    , measuringSwitch(false)
+    , longestSwitchFrame(0.0)
+    , prefetchedSceneType(SCENE_TOTAL)
+    , prefetchHits(0)
+    , wastedPrefetches(0)
+    , renderFrame(0)
+    , lastRenderTime(0.0)
+    , lastCullStats()
 {
     // Initialize all scene pointers to nullptr
     for (int i = 0; i < SCENE_TOTAL; i++)
@@ -44,6 +64,10 @@ void SceneManager::DestroyInstance(void)
 
 void SceneManager::Init(void)
 {
+    // The shader program and draw path are built once and shared by every scene
+    renderer.Init();
+    glGenQueries(2, renderQueries);
+
     // Create all scenes
     //scenes[SCENE_MENU] = new SceneMenu();
 	scenes[SCENE_LOBBY] = new SceneLobby();
@@ -51,35 +75,96 @@ void SceneManager::Init(void)
     scenes[SCENE_SHOOTING] = new SceneShooting();
     scenes[SCENE_CANS] = new SceneCans();
     scenes[SCENE_TANK] = new SceneTank();
+    for (int i = 0; i < SCENE_TOTAL; i++)
+    {
+        if (scenes[i])
+        {
+            scenes[i]->SetRenderer(&renderer);
+        }
+    }
 
     // Initialize the first scene
     currentSceneType = SCENE_SHOOTING;
     currentScene = scenes[currentSceneType];
+    LoadSceneAssets(currentSceneType);
     currentScene->Init();
+    loading = AssetCache::GetInstance()->IsLoading(currentSceneType);
 }
 
 void SceneManager::Update(double dt)
 {
+    AssetCache* assets = AssetCache::GetInstance();
+
+    // dt is the length of the last frame, so a switch shows up one frame later
+    if (measuringSwitch)
+    {
+        if (dt > longestSwitchFrame)
+        {
+            longestSwitchFrame = dt;
+        }
+        if (!loading)
+        {
+            const AssetCache::Stats& stats = assets->GetStats();
+            std::cout << "Scene switch (" << (assets->IsAsync() ? "threaded" : "synchronous") << " loading): "
+                << stats.hits << " assets reused, " << stats.misses << " loaded in " << stats.loadTime * 1000.0
+                << " ms, " << stats.savedTime * 1000.0 << " ms saved, longest frame "
+                << longestSwitchFrame * 1000.0 << " ms (prefetch hits " << prefetchHits << ", wasted "
+                << wastedPrefetches << ")" << std::endl;
+            Mesh::MemoryStats memory = assets->GetBatchMemory(currentSceneType);
+            std::cout << "Scene vertex/index memory: " << memory.bytes / 1024 << " KB (unpacked "
+                << memory.unpackedBytes / 1024 << " KB)" << std::endl;
+            memory = assets->GetBatchTextureMemory(currentSceneType);
+            std::cout << "Scene texture memory: " << memory.bytes / 1024 << " KB (uncompressed, no mipmaps "
+                << memory.unpackedBytes / 1024 << " KB)" << std::endl;
+            measuringSwitch = false;
+        }
+    }
+
     // Handle scene switching if needed
     if (needsSwitch)
     {
+        assets->ResetStats();
+
         // Exit current scene
         if (currentScene)
         {
             currentScene->Exit();
+            currentScene->UnloadAssets();
         }
+        renderer.ClearScene();
 
         // Switch to next scene
         currentSceneType = nextSceneType;
         currentScene = scenes[currentSceneType];
 
-        // Initialize new scene
+        // Initialize new scene; unless it was prefetched, its OBJ and TGA files
+        // keep loading after this
         if (currentScene)
         {
+            if (prefetchedSceneType == currentSceneType)
+            {
+                ++prefetchHits;
+                prefetchedSceneType = SCENE_TOTAL;
+            }
+            else
+            {
+                CancelPrefetch();
+                LoadSceneAssets(currentSceneType);
+            }
             currentScene->Init();
         }
 
         needsSwitch = false;
+        measuringSwitch = true;
+        longestSwitchFrame = 0.0;
+    }
+
+    // The scene only runs once everything it loads is uploaded
+    assets->Update(UPLOAD_BUDGET);
+    loading = assets->IsLoading(currentSceneType);
+    if (loading)
+    {
+        return;
     }
 
     // Update current scene
@@ -91,10 +176,37 @@ void SceneManager::Update(double dt)
 
 void SceneManager::Render(void)
 {
-    if (currentScene)
+    glBeginQuery(GL_TIME_ELAPSED, renderQueries[renderFrame % 2]);
+    if (loading)
+    {
+        renderer.RenderLoadingScreen(AssetCache::GetInstance()->GetLoadProgress(currentSceneType));
+    }
+    else if (currentScene)
     {
+        renderer.BeginScene();
         currentScene->Render();
+        renderer.EndScene();
     }
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Read last frame's query, which is normally done by now, so the CPU never waits
+    ++renderFrame;
+    GLuint previous = renderQueries[renderFrame % 2];
+    GLint available = 0;
+    if (renderFrame > 1)
+        glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed);
+        lastRenderTime = elapsed * 1e-9;
+        if (!loading)
+            renderer.UpdateResolution(lastRenderTime);
+    }
+    UniformCache::GetInstance()->EndFrame();
+    Mesh::EndFrame();
+    lastCullStats = renderer.GetCullStats();
+    renderer.ResetCullStats();
 }
 
 void SceneManager::Exit(void)
@@ -103,7 +215,13 @@ void SceneManager::Exit(void)
     if (currentScene)
     {
         currentScene->Exit();
+        currentScene->UnloadAssets();
     }
+    CancelPrefetch();
+    renderer.ClearScene();
+    renderer.Exit();
+    glDeleteQueries(2, renderQueries);
+    AssetCache::GetInstance()->Clear();
 
     // Delete all scenes
     for (int i = 0; i < SCENE_TOTAL; i++)
@@ -116,6 +234,57 @@ void SceneManager::Exit(void)
     }
 }
 
+/******************************************************************************/
+/*!
+\brief
+Hint that the player is likely to enter a scene soon, e.g. because they are
+near the door leading to it. Its assets start loading in the background, so
+the switch itself finds them resident. A different earlier hint is dropped.
+
+\param sceneType - scene that is likely next
+*/
+/******************************************************************************/
+void SceneManager::PrefetchScene(SCENE_TYPE sceneType)
+{
+    if (sceneType == prefetchedSceneType || sceneType == currentSceneType ||
+        sceneType >= SCENE_TOTAL || !scenes[sceneType])
+    {
+        return;
+    }
+
+    CancelPrefetch();
+    LoadSceneAssets(sceneType);
+    prefetchedSceneType = sceneType;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Drop the last prefetch hint, e.g. when the player walks away from the door.
+Its assets stay resident in AssetCache, but count as a wasted prefetch.
+*/
+/******************************************************************************/
+void SceneManager::CancelPrefetch(void)
+{
+    if (prefetchedSceneType == SCENE_TOTAL)
+    {
+        return;
+    }
+
+    scenes[prefetchedSceneType]->UnloadAssets();
+    prefetchedSceneType = SCENE_TOTAL;
+    ++wastedPrefetches;
+}
+
+// Load a scene's assets as one AssetCache batch, so IsLoading can track them
+void SceneManager::LoadSceneAssets(SCENE_TYPE sceneType)
+{
+    AssetCache* assets = AssetCache::GetInstance();
+    assets->BeginBatch(sceneType);
+    scenes[sceneType]->LoadAssets();
+    assets->EndBatch();
+}
+
 void SceneManager::SwitchScene(SCENE_TYPE sceneType)
 {
     nextSceneType = sceneType;
@@ -125,4 +294,61 @@ void SceneManager::SwitchScene(SCENE_TYPE sceneType)
 SceneManager::SCENE_TYPE SceneManager::GetCurrentSceneType(void)
 {
     return currentSceneType;
+}
+
+double SceneManager::GetLastRenderTime(void) const
+{
+    return lastRenderTime;
+}
+
+const RenderQueue::CullStats& SceneManager::GetLastCullStats(void) const
+{
+    return lastCullStats;
+}
+
+void SceneManager::SetUseShaderVariants(bool use)
+{
+    renderer.SetUseShaderVariants(use);
+}
+
+bool SceneManager::IsUsingShaderVariants(void) const
+{
+    return renderer.IsUsingShaderVariants();
+}
+
+void SceneManager::SetUseDynamicResolution(bool use)
+{
+    renderer.SetUseDynamicResolution(use);
+}
+
+bool SceneManager::IsUsingDynamicResolution(void) const
+{
+    return renderer.IsUsingDynamicResolution();
+}
+
+// Share of the window's width and height the scene is drawn at
+float SceneManager::GetResolutionScale(void) const
+{
+    return renderer.GetResolutionScale();
+}
+
+void SceneManager::SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing)
+{
+    renderer.SetAntiAliasing(antiAliasing);
+}
+
+DynamicResolution::ANTI_ALIASING SceneManager::GetAntiAliasing(void) const
+{
+    return renderer.GetAntiAliasing();
+}
+
+unsigned long long SceneManager::GetSceneTargetMemory(void) const
+{
+    return renderer.GetSceneTargetMemory();
+}
+
+// True while the current scene's assets are still loading and the loading screen shows
+bool SceneManager::IsLoading(void) const
+{
+    return loading;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <bitset>
 #include "Scene.h"
+#include "Renderer.h"
 
 
 class SceneLobby;
@@ -32,14 +33,27 @@ private:
 
     Scene* scenes[SCENE_TOTAL];
     Scene* currentScene;
+    Renderer renderer;
     SCENE_TYPE prevSceneType;
     SCENE_TYPE currentSceneType;
     SCENE_TYPE nextSceneType;
     bool needsSwitch;
+    bool loading;             // scene assets still on the loader threads
+    bool measuringSwitch;     // tracking the frames of the last switch
+    double longestSwitchFrame;
+    SCENE_TYPE prefetchedSceneType; // SCENE_TOTAL when nothing is prefetched
+    unsigned prefetchHits;          // switches that found their scene prefetched
+    unsigned wastedPrefetches;      // prefetches dropped without a switch
+    unsigned renderQueries[2];      // GL_TIME_ELAPSED of the last two frames
+    unsigned renderFrame;
+    double lastRenderTime;          // GPU seconds of the scene render, a frame or two old
+    RenderQueue::CullStats lastCullStats; // of the last rendered frame
 
     SceneManager(void);
     ~SceneManager(void);
 
+    void LoadSceneAssets(SCENE_TYPE sceneType);
+
 public:
     static SceneManager* GetInstance(void);
     static void DestroyInstance(void);
@@ -50,7 +64,20 @@ public:
     void Exit(void);
 
     void SwitchScene(SCENE_TYPE sceneType);
+    void PrefetchScene(SCENE_TYPE sceneType);
+    void CancelPrefetch(void);
     SCENE_TYPE GetCurrentSceneType(void);
+    double GetLastRenderTime(void) const;
+    const RenderQueue::CullStats& GetLastCullStats(void) const;
+    void SetUseShaderVariants(bool use);
+    bool IsUsingShaderVariants(void) const;
+    void SetUseDynamicResolution(bool use);
+    bool IsUsingDynamicResolution(void) const;
+    float GetResolutionScale(void) const;
+    void SetAntiAliasing(DynamicResolution::ANTI_ALIASING antiAliasing);
+    DynamicResolution::ANTI_ALIASING GetAntiAliasing(void) const;
+    unsigned long long GetSceneTargetMemory(void) const;
+    bool IsLoading(void) const;
     SCENE_TYPE leadsTo;
     bool gameCompleted[4] = { false, false, false, false };    // track which games are done
     bool getIsGameCompleted(int index) { return gameCompleted[index]; }
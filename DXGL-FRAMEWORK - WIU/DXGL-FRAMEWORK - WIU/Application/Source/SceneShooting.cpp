@@ -12,14 +12,16 @@
 
 #include <iostream>
 
-#include "shader.hpp"
 #include "Application.h"
 #include "MeshBuilder.h"
 #include "KeyboardController.h"
 #include "MouseController.h"
 #include "LoadTGA.h"
+#include "Renderer.h"
+#include "AssetCache.h"
 
 SceneShooting::SceneShooting()
+	: skybox(0)
 {
 }
 
@@ -41,40 +43,6 @@ void SceneShooting::Init()
 	//Default to fill mode
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	// Generate a default VAO for now
-	glGenVertexArrays(1, &m_vertexArrayID);
-	glBindVertexArray(m_vertexArrayID);
-
-	// Load the shader programs
-	m_programID = LoadShaders("Shader//Texture.vertexshader", "Shader//Text.fragmentshader");
-	glUseProgram(m_programID);
-
-	// Get a handle for our "MVP" uniform
-	m_parameters[U_MVP] = glGetUniformLocation(m_programID, "MVP");
-	m_parameters[U_MODELVIEW] = glGetUniformLocation(m_programID, "MV");
-	m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(m_programID, "MV_inverse_transpose");
-	m_parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(m_programID, "material.kAmbient");
-	m_parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(m_programID, "material.kDiffuse");
-	m_parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(m_programID, "material.kSpecular");
-	m_parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(m_programID, "material.kShininess");
-	m_parameters[U_LIGHT0_TYPE] = glGetUniformLocation(m_programID, "lights[0].type");
-	m_parameters[U_LIGHT0_POSITION] = glGetUniformLocation(m_programID, "lights[0].position_cameraspace");
-	m_parameters[U_LIGHT0_COLOR] = glGetUniformLocation(m_programID, "lights[0].color");
-	m_parameters[U_LIGHT0_POWER] = glGetUniformLocation(m_programID, "lights[0].power");
-	m_parameters[U_LIGHT0_KC] = glGetUniformLocation(m_programID, "lights[0].kC");
-	m_parameters[U_LIGHT0_KL] = glGetUniformLocation(m_programID, "lights[0].kL");
-	m_parameters[U_LIGHT0_KQ] = glGetUniformLocation(m_programID, "lights[0].kQ");
-	m_parameters[U_LIGHT0_SPOTDIRECTION] = glGetUniformLocation(m_programID, "lights[0].spotDirection");
-	m_parameters[U_LIGHT0_COSCUTOFF] = glGetUniformLocation(m_programID, "lights[0].cosCutoff");
-	m_parameters[U_LIGHT0_COSINNER] = glGetUniformLocation(m_programID, "lights[0].cosInner");
-	m_parameters[U_LIGHT0_EXPONENT] = glGetUniformLocation(m_programID, "lights[0].exponent");
-	m_parameters[U_LIGHTENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
-	m_parameters[U_NUMLIGHTS] = glGetUniformLocation(m_programID, "numLights");
-	m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(m_programID, "colorTextureEnabled");
-	m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(m_programID, "colorTexture");
-	m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(m_programID, "textEnabled");
-	m_parameters[U_TEXT_COLOR] = glGetUniformLocation(m_programID, "textColor");
-
 	// Initialise camera properties
 	//camera.Init(45.f, 45.f, 10.f);
 	camera.Init(
@@ -83,69 +51,11 @@ void SceneShooting::Init()
 		glm::vec3(0, 1.0f, 0)		// up
 	);
 
-	// Init VBO here
-	for (int i = 0; i < NUM_GEOMETRY; ++i)
-	{
-		meshList[i] = nullptr;
-	}
-
-	meshList[GEO_AXES] = MeshBuilder::GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
-	meshList[GEO_SPHERE] = MeshBuilder::GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
-	meshList[GEO_CUBE] = MeshBuilder::GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
-	meshList[GEO_PLANE] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
-	//meshList[GEO_PLANE]->textureID = LoadTGA("Images//met4.tga");
-
-	// OBJ Models
-
-	// props
-	//meshList[GEO_COUNTER] = MeshBuilder::GenerateRectangularPrism("Counter", glm::vec3(1.f, 1.f, 1.f), 10.f, 1.f, 2.f);
-	//meshList[GEO_TARGET_RAIL] = MeshBuilder::GenerateRectangularPrism("Target Rail", glm::vec3(1.f, 1.f, 1.f), 10.f, 0.5f, 0.5f);
-	
-	/*meshList[GEO_TARGET] = MeshBuilder::GenerateOBJMTL("Target", "Models//Target.obj", "Models//Target.mtl");
-	meshList[GEO_TARGET]->textureID = LoadTGA("Images//TargetMat_baseColor.tga");*/
-
-	meshList[GEO_TARGET] = MeshBuilder::GenerateOBJMTL("Target", "Models//target.obj", "Models//target.mtl");
-	meshList[GEO_TARGET]->textureID = LoadTGA("Images//target_baseColor.tga");
-	
-	//meshList[GEO_BOMB] = MeshBuilder::GenerateSphere("Bomb", glm::vec3(0.f, 0.f, 0.f), 0.5f, 16, 16);
-	
-	//meshList[GEO_GUN] = MeshBuilder::GenerateOBJ("Gun", "Models//GunToy.obj");
-	meshList[GEO_GUN] = MeshBuilder::GenerateOBJMTL("Gun", "Models//GunToy.obj", "Models//GunToy.mtl");
-	meshList[GEO_GUN]->textureID = LoadTGA("Images//Toy_Gun_body1_BaseColor.tga");
-	
-
+	// Text is drawn in one batch per frame, spaced like the old per-character draws
+	renderer->SetFont(meshList[GEO_TEXT] ? meshList[GEO_TEXT]->textureID : 0,
+		1.f, glm::vec2(0.f, 0.f), glm::vec2(0.5f, 0.5f));
 
-
-
-
-
-	// Environment
-	//meshList[GEO_FLOOR] = MeshBuilder::GenerateQuad("Floor", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	//meshList[GEO_FLOOR]->textureID = LoadTGA("Images//floor.tga");
-
-	meshList[GEO_WALL] = MeshBuilder::GenerateRectangularPrism("Wall", glm::vec3(0.9f, 0.9f, 0.9f), 1.f, 1.f, 1.f);
-	//meshList[GEO_WALL]->textureID = LoadTGA("Images//wall.tga");
-
-
-
-	// Skybox NIGHT
-	/*meshList[GEO_LEFT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_LEFT]->textureID = LoadTGA("Images//nightsky_lf.tga");
-
-	meshList[GEO_RIGHT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_RIGHT]->textureID = LoadTGA("Images//nightsky_rt.tga");
-
-	meshList[GEO_TOP] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_TOP]->textureID = LoadTGA("Images//nightsky_up.tga");
-
-	meshList[GEO_BOTTOM] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BOTTOM]->textureID = LoadTGA("Images//nightsky_dn.tga");
-
-	meshList[GEO_FRONT] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_FRONT]->textureID = LoadTGA("Images//nightsky_bk.tga");
-
-	meshList[GEO_BACK] = MeshBuilder::GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 100.f);
-	meshList[GEO_BACK]->textureID = LoadTGA("Images//nightsky_ft.tga ");*/
+	renderer->SetSkybox(skybox);
 
 
 
@@ -163,8 +73,6 @@ void SceneShooting::Init()
 
 
 
-	glUniform1i(m_parameters[U_NUMLIGHTS], 2);
-
 	light[0].position = glm::vec3(0, 5, 0);
 	light[0].color = glm::vec3(1, 1, 1);
 	light[0].type = Light::LIGHT_POINT;
@@ -177,21 +85,74 @@ void SceneShooting::Init()
 	light[0].exponent = 3.f;
 	light[0].spotDirection = glm::vec3(0.f, 1.f, 0.f);
 
-	glUniform3fv(m_parameters[U_LIGHT0_COLOR], 1, &light[0].color.r);
-	glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
-	glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
-	glUniform1f(m_parameters[U_LIGHT0_KC], light[0].kC);
-	glUniform1f(m_parameters[U_LIGHT0_KL], light[0].kL);
-	glUniform1f(m_parameters[U_LIGHT0_KQ], light[0].kQ);
-	glUniform1f(m_parameters[U_LIGHT0_COSCUTOFF], cosf(glm::radians<float>(light[0].cosCutoff)));
-	glUniform1f(m_parameters[U_LIGHT0_COSINNER], cosf(glm::radians<float>(light[0].cosInner)));
-	glUniform1f(m_parameters[U_LIGHT0_EXPONENT], light[0].exponent);
+	// Lights are moved to camera space and uploaded with the frame data
+	renderer->SetLights(light, NUM_LIGHTS);
 
 	enableLight = true;
 
 
 }
 
+/******************************************************************************/
+/*!
+\brief
+Get this scene's meshes and textures from AssetCache. Called by SceneManager
+before Init, or earlier as a prefetch while the player heads for the scene.
+*/
+/******************************************************************************/
+void SceneShooting::LoadAssets()
+{
+	for (int i = 0; i < NUM_GEOMETRY; ++i)
+	{
+		meshList[i] = nullptr;
+	}
+
+	// Meshes and textures stay resident across scene switches
+	AssetCache* assets = AssetCache::GetInstance();
+	meshList[GEO_AXES] = assets->GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
+	meshList[GEO_SPHERE] = assets->GenerateSphere("Sun", glm::vec3(1.f, 1.f, 1.f), 1.f, 16, 16);
+	meshList[GEO_CUBE] = assets->GenerateCube("Arm", glm::vec3(0.5f, 0.5f, 0.5f), 1.f);
+	meshList[GEO_PLANE] = assets->GenerateQuad("Plane", glm::vec3(1.f, 1.f, 1.f), 10.f);
+	//meshList[GEO_PLANE]->textureID = assets->LoadTGA("Images//met4.tga");
+
+	// OBJ Models
+
+	// props
+	//meshList[GEO_COUNTER] = assets->GenerateRectangularPrism("Counter", glm::vec3(1.f, 1.f, 1.f), 10.f, 1.f, 2.f);
+	//meshList[GEO_TARGET_RAIL] = assets->GenerateRectangularPrism("Target Rail", glm::vec3(1.f, 1.f, 1.f), 10.f, 0.5f, 0.5f);
+	
+	/*meshList[GEO_TARGET] = assets->GenerateOBJMTL("Target", "Models//Target.obj", "Models//Target.mtl");
+	meshList[GEO_TARGET]->textureID = assets->LoadTGA("Images//TargetMat_baseColor.tga");*/
+
+	meshList[GEO_TARGET] = assets->GenerateOBJMTL("Target", "Models//target.obj", "Models//target.mtl");
+	meshList[GEO_TARGET]->textureID = assets->LoadTGA("Images//target_baseColor.tga");
+	
+	//meshList[GEO_BOMB] = assets->GenerateSphere("Bomb", glm::vec3(0.f, 0.f, 0.f), 0.5f, 16, 16);
+	
+	//meshList[GEO_GUN] = assets->GenerateOBJ("Gun", "Models//GunToy.obj");
+	meshList[GEO_GUN] = assets->GenerateOBJMTL("Gun", "Models//GunToy.obj", "Models//GunToy.mtl");
+	meshList[GEO_GUN]->textureID = assets->LoadTGA("Images//Toy_Gun_body1_BaseColor.tga");
+	
+
+
+
+
+
+
+	// Environment
+	//meshList[GEO_FLOOR] = assets->GenerateQuad("Floor", glm::vec3(1.f, 1.f, 1.f), 100.f);
+	//meshList[GEO_FLOOR]->textureID = assets->LoadTGA("Images//floor.tga");
+
+	meshList[GEO_WALL] = assets->GenerateRectangularPrism("Wall", glm::vec3(0.9f, 0.9f, 0.9f), 1.f, 1.f, 1.f);
+	//meshList[GEO_WALL]->textureID = assets->LoadTGA("Images//wall.tga");
+
+
+
+	// Skybox NIGHT
+	/*skybox = assets->LoadCubemap("Images//nightsky_rt.tga", "Images//nightsky_lf.tga", "Images//nightsky_up.tga",
+		"Images//nightsky_dn.tga", "Images//nightsky_ft.tga", "Images//nightsky_bk.tga");*/
+}
+
 
 
 
@@ -255,35 +216,19 @@ void SceneShooting::Render()
 	// Load identity matrix into the model stack
 	modelStack.LoadIdentity();
 
-	if (light[0].type == Light::LIGHT_DIRECTIONAL)
-	{
-		glm::vec3 lightDir(light[0].position.x, light[0].position.y, light[0].position.z);
-		glm::vec3 lightDirection_cameraspace = viewStack.Top() * glm::vec4(lightDir, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightDirection_cameraspace));
-	}
-	else if (light[0].type == Light::LIGHT_SPOT)
-	{
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-		glm::vec3 spotDirection_cameraspace = viewStack.Top() * glm::vec4(light[0].spotDirection, 0);
-		glUniform3fv(m_parameters[U_LIGHT0_SPOTDIRECTION], 1, glm::value_ptr(spotDirection_cameraspace));
-	}
-	else {
-		// Calculate the light position in camera space
-		glm::vec3 lightPosition_cameraspace = viewStack.Top() * glm::vec4(light[0].position, 1);
-		glUniform3fv(m_parameters[U_LIGHT0_POSITION], 1, glm::value_ptr(lightPosition_cameraspace));
-	}
+	// Camera and lights are the same for every draw of the frame
+	renderer->BeginFrame(viewStack.Top(), projectionStack.Top());
 
 	modelStack.PushMatrix();
 	// Render objects
-	RenderMesh(meshList[GEO_AXES], false);
+	renderer->Submit(meshList[GEO_AXES], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
 	modelStack.PushMatrix();
 	// Render light
 	modelStack.Translate(light[0].position.x, light[0].position.y, light[0].position.z);
 	modelStack.Scale(0.1f, 0.1f, 0.1f);
-	RenderMesh(meshList[GEO_SPHERE], false);
+	renderer->Submit(meshList[GEO_SPHERE], modelStack.Top(), false);
 	modelStack.PopMatrix();
 
 
@@ -298,7 +243,7 @@ void SceneShooting::Render()
 	meshList[GEO_WALL]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
 	meshList[GEO_WALL]->material.kShininess = 5.0f;
 
-	RenderMesh(meshList[GEO_WALL], true);
+	renderer->Submit(meshList[GEO_WALL], modelStack.Top(), true);
 	modelStack.PopMatrix();*/
 
 
@@ -312,7 +257,7 @@ void SceneShooting::Render()
 	meshList[GEO_CUBE]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
 	meshList[GEO_CUBE]->material.kShininess = 5.0f;
 
-	RenderMesh(meshList[GEO_CUBE], true);
+	renderer->Submit(meshList[GEO_CUBE], modelStack.Top(), true);
 	modelStack.PopMatrix();*/
 
 
@@ -325,7 +270,7 @@ void SceneShooting::Render()
 	meshList[GEO_OBJ]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
 	meshList[GEO_OBJ]->material.kShininess = 5.0f;
 
-	RenderMesh(meshList[GEO_OBJ], true);
+	renderer->Submit(meshList[GEO_OBJ], modelStack.Top(), true);
 	modelStack.PopMatrix();*/
 
 
@@ -344,7 +289,7 @@ void SceneShooting::Render()
 	meshList[GEO_GUN]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
 	meshList[GEO_GUN]->material.kShininess = 5.0f;
 
-	RenderMesh(meshList[GEO_GUN], true);
+	renderer->Submit(meshList[GEO_GUN], modelStack.Top(), true);
 	modelStack.PopMatrix(); 
 
 
@@ -359,7 +304,7 @@ void SceneShooting::Render()
 	meshList[GEO_TARGET]->material.kSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
 	meshList[GEO_TARGET]->material.kShininess = 5.0f;
 
-	RenderMesh(meshList[GEO_TARGET], true);
+	renderer->Submit(meshList[GEO_TARGET], modelStack.Top(), true);
 	modelStack.PopMatrix();
 
 
@@ -367,162 +312,34 @@ void SceneShooting::Render()
 
 
 
-	// Skybox NIGHT
-	//RenderSkybox();
-
-
-
+	renderer->EndFrame();
 }
 
-void SceneShooting::RenderMesh(Mesh* mesh, bool enableLight)
-{
-	glm::mat4 MVP, modelView, modelView_inverse_transpose;
-
-	MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
-	modelView = viewStack.Top() * modelStack.Top();
-	glUniformMatrix4fv(m_parameters[U_MODELVIEW], 1, GL_FALSE, glm::value_ptr(modelView));
-	if (enableLight)
-	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 1);
-		modelView_inverse_transpose = glm::inverseTranspose(modelView);
-		glUniformMatrix4fv(m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE], 1, GL_FALSE, glm::value_ptr(modelView_inverse_transpose));
-
-		//load material
-		glUniform3fv(m_parameters[U_MATERIAL_AMBIENT], 1, &mesh->material.kAmbient.r);
-		glUniform3fv(m_parameters[U_MATERIAL_DIFFUSE], 1, &mesh->material.kDiffuse.r);
-		glUniform3fv(m_parameters[U_MATERIAL_SPECULAR], 1, &mesh->material.kSpecular.r);
-		glUniform1f(m_parameters[U_MATERIAL_SHININESS], mesh->material.kShininess);
-	}
-	else
-	{
-		glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	}
-
-
-	if (mesh->textureID > 0)
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-	}
-	else
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 0);
-	}
-
-	mesh->Render();
-
 
 
-	if (mesh->textureID > 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
 
-}
 
 
-//void SceneShooting::RenderSkybox() {
-//	modelStack.PushMatrix();
-//
-//	// Offset in Z direction by -50 units
-//	modelStack.Translate(0.f, 0.f, -50.f);
-//
-//	// Skybox should be rendered without light
-//	RenderMesh(meshList[GEO_FRONT], false);
-//	modelStack.PopMatrix();
-//
-//	// Do the rest of the quads with
-//	// appropriate positions and rotations
-//	// so that the camera is inside the skybox
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(0.f, 0.f, -50.f);
-//	RenderMesh(meshList[GEO_FRONT], false);
-//	modelStack.PopMatrix();
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(0.f, 0.f, 50.f);
-//	modelStack.Rotate(-180.f, 0.f, 1.f, 0.f);
-//	RenderMesh(meshList[GEO_BACK], false);
-//	modelStack.PopMatrix();
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(-50.f, 0.f, 0.f);
-//	modelStack.Rotate(90.f, 0.f, 1.f, 0.f);
-//	RenderMesh(meshList[GEO_LEFT], false);
-//	modelStack.PopMatrix();
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(50.f, 0.f, 0.f);
-//	modelStack.Rotate(-90.f, 0.f, 1.f, 0.f);
-//	RenderMesh(meshList[GEO_RIGHT], false);
-//	modelStack.PopMatrix();
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(0.f, 50.f, 0.f);
-//	modelStack.Rotate(90.f, 1.f, 0.f, 0.f);
-//	modelStack.Rotate(90.f, 0.f, 0.f, 1.f);
-//	RenderMesh(meshList[GEO_TOP], false);
-//	modelStack.PopMatrix();
-//
-//	modelStack.PushMatrix();
-//	modelStack.Translate(0.f, -50.f, 0.f);
-//	modelStack.Rotate(-90.f, 1.f, 0.f, 0.f);
-//	RenderMesh(meshList[GEO_BOTTOM], false);
-//	modelStack.PopMatrix();
-//
-//}
-
-
-
-void SceneShooting::RenderMeshOnScreen(Mesh* mesh, float x, float
-	y, float sizex, float sizey)
+void SceneShooting::Exit()
 {
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 1920.f, 0.f, 1080.f, -1000.f, 1000.f); // dimension of screen UI
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity();
-
-	// To do: Use modelStack to position GUI on screen
-	modelStack.Translate(x, y, 0);
-
-	// To do: Use modelStack to scale the GUI
-	modelStack.Scale(sizex, sizey, 1);
-
-	RenderMesh(mesh, false); //UI should not have light
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-
-	glEnable(GL_DEPTH_TEST);
+	// Meshes and textures are handed back in UnloadAssets, called by SceneManager
 }
 
-
-
-
-
-
-void SceneShooting::Exit()
+void SceneShooting::UnloadAssets()
 {
-	// Cleanup VBO here
+	// Hand meshes and textures back to the cache, which keeps them for the next scene
+	AssetCache* assets = AssetCache::GetInstance();
 	for (int i = 0; i < NUM_GEOMETRY; ++i)
 	{
 		if (meshList[i])
 		{
-			delete meshList[i];
+			assets->ReleaseTexture(meshList[i]->textureID);
+			assets->ReleaseMesh(meshList[i]);
+			meshList[i] = nullptr;
 		}
 	}
-	glDeleteVertexArrays(1, &m_vertexArrayID);
-	glDeleteProgram(m_programID);
+	assets->ReleaseTexture(skybox);
+	skybox = 0;
 }
 
 void SceneShooting::HandleKeyPress()
@@ -563,7 +380,6 @@ void SceneShooting::HandleKeyPress()
 			light[0].power = 1.f;
 		else
 			light[0].power = 0.1f;
-		glUniform1f(m_parameters[U_LIGHT0_POWER], light[0].power);
 	}
 
 	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_TAB))
@@ -577,8 +393,6 @@ void SceneShooting::HandleKeyPress()
 		else {
 			light[0].type = Light::LIGHT_POINT;
 		}
-
-		glUniform1i(m_parameters[U_LIGHT0_TYPE], light[0].type);
 	}
 
 }
@@ -612,96 +426,3 @@ void SceneShooting::HandleMouseInput() {
 
 	// Continue to do for right button
 }
-
-
-
-void SceneShooting::RenderText(Mesh* mesh, std::string text, glm::vec3
-	color)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	// Disable back face culling
-	glDisable(GL_CULL_FACE);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(i * 1.0f, 0, 0));
-		glm::mat4 MVP = projectionStack.Top() * viewStack.Top() *
-			modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	glEnable(GL_CULL_FACE);
-	glDisable(GL_BLEND);
-}
-
-
-
-void SceneShooting::RenderTextOnScreen(Mesh* mesh, std::string
-	text, glm::vec3 color, float size, float x, float y)
-{
-	if (!mesh || mesh->textureID <= 0) //Proper error check
-		return;
-
-	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-	glm::mat4 ortho = glm::ortho(0.f, 800.f, 0.f, 600.f, -100.f, 100.f); // dimension of screen UI
-
-	projectionStack.PushMatrix();
-	projectionStack.LoadMatrix(ortho);
-	viewStack.PushMatrix();
-	viewStack.LoadIdentity(); //No need camera for ortho mode 
-
-	modelStack.PushMatrix();
-	modelStack.LoadIdentity(); //Reset modelStack
-	modelStack.Translate(x, y, 0);
-	modelStack.Scale(size, size, size);
-
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
-	glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &color.r);
-	glUniform1i(m_parameters[U_LIGHTENABLED], 0);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-	glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-
-
-	for (unsigned i = 0; i < text.length(); ++i)
-	{
-		glm::mat4 characterSpacing = glm::translate(
-			glm::mat4(1.f),
-			glm::vec3(0.5f + i * 1.0f, 0.5f, 0)
-		);
-		glm::mat4 MVP = projectionStack.Top() *
-			viewStack.Top() * modelStack.Top() * characterSpacing;
-		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE,
-			glm::value_ptr(MVP));
-		mesh->Render((unsigned)text[i] * 6, 6);
-	}
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-	projectionStack.PopMatrix();
-	viewStack.PopMatrix();
-	modelStack.PopMatrix();
-	glEnable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
-}
\ No newline at end of file
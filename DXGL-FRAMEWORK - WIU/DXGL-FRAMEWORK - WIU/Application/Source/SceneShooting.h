@@ -19,13 +19,6 @@ public:
 		GEO_CUBE,
 		GEO_PLANE,
 
-		/*GEO_LEFT,
-		GEO_RIGHT,
-		GEO_TOP,
-		GEO_BOTTOM,
-		GEO_FRONT,
-		GEO_BACK,*/
-
 		GEO_OBJ,
 		
 		// Environment
@@ -47,39 +40,6 @@ public:
 		NUM_GEOMETRY,
 	};
 
-	enum UNIFORM_TYPE
-	{
-		U_MVP = 0,
-		U_MODELVIEW,
-		U_MODELVIEW_INVERSE_TRANSPOSE,
-		U_MATERIAL_AMBIENT,
-		U_MATERIAL_DIFFUSE,
-		U_MATERIAL_SPECULAR,
-		U_MATERIAL_SHININESS,
-		U_LIGHT0_TYPE,
-		U_LIGHT0_POSITION,
-		U_LIGHT0_COLOR,
-		U_LIGHT0_POWER,
-		U_LIGHT0_KC,
-		U_LIGHT0_KL,
-		U_LIGHT0_KQ,
-		U_LIGHT0_SPOTDIRECTION,
-		U_LIGHT0_COSCUTOFF,
-		U_LIGHT0_COSINNER,
-		U_LIGHT0_EXPONENT,
-		U_NUMLIGHTS,
-		U_COLOR_TEXTURE_ENABLED,
-		U_COLOR_TEXTURE,
-		U_LIGHTENABLED,
-
-
-		U_TEXT_ENABLED,
-		U_TEXT_COLOR,
-
-		U_TOTAL,
-	};
-
-
 	enum GameState
 	{
 		STATE_FIND_GUN = 0,  // player must locate and pick up the gun first
@@ -114,6 +74,8 @@ public:
 	virtual void Update(double dt);
 	virtual void Render();
 	virtual void Exit();
+	virtual void LoadAssets();
+	virtual void UnloadAssets();
 
 private:
 	// ----- input helpers ----------------------------------
@@ -121,10 +83,6 @@ private:
 	void HandleMouseInput();
 
 	// ----- rendering helpers (same signatures as SceneWIU) 
-	void RenderMesh(Mesh* mesh, bool enableLight);
-	void RenderMeshOnScreen(Mesh* mesh, float x, float y, float sizex, float sizey);
-	void RenderText(Mesh* mesh, std::string text, glm::vec3 color);
-	void RenderTextOnScreen(Mesh* mesh, std::string text, glm::vec3 color, float size, float x, float y);
 
 	// ----- game logic helpers -----------------------------
 	void Shoot();
@@ -133,10 +91,8 @@ private:
 	bool IsPlayerNearGun(float radius);
 
 	// ----- GL handles -------------------------------------
-	unsigned m_vertexArrayID;
-	unsigned m_programID;
-	unsigned m_parameters[U_TOTAL];
 	Mesh* meshList[NUM_GEOMETRY];
+	unsigned skybox; // cube map from AssetCache, 0 while the sky is off or failed to load
 
 	// ----- camera & matrices (same as SceneWIU) ----------
 	FPCamera    camera;
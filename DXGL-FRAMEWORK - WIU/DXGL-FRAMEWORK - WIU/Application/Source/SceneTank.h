@@ -27,13 +27,6 @@ public:
 
 		GEO_SHUTTER,
 
-		GEO_LEFT,
-		GEO_RIGHT,
-		GEO_TOP,
-		GEO_BOTTOM,
-		GEO_FRONT,
-		GEO_BACK,
-
 		GEO_KIOSK_FLOOR,
 		GEO_KIOSK_WALL,
 		GEO_KIOSK_COUNTER,
@@ -55,39 +48,6 @@ public:
 		NUM_GEOMETRY,
 	};
 
-	enum UNIFORM_TYPE
-	{
-		U_MVP = 0,
-		U_MODELVIEW,
-		U_MODELVIEW_INVERSE_TRANSPOSE,
-		U_MATERIAL_AMBIENT,
-		U_MATERIAL_DIFFUSE,
-		U_MATERIAL_SPECULAR,
-		U_MATERIAL_SHININESS,
-		U_LIGHT0_TYPE,
-		U_LIGHT0_POSITION,
-		U_LIGHT0_COLOR,
-		U_LIGHT0_POWER,
-		U_LIGHT0_KC,
-		U_LIGHT0_KL,
-		U_LIGHT0_KQ,
-		U_LIGHT0_SPOTDIRECTION,
-		U_LIGHT0_COSCUTOFF,
-		U_LIGHT0_COSINNER,
-		U_LIGHT0_EXPONENT,
-		U_NUMLIGHTS,
-		U_COLOR_TEXTURE_ENABLED,
-		U_COLOR_TEXTURE,
-		U_LIGHTENABLED,
-
-
-		U_TEXT_ENABLED,
-		U_TEXT_COLOR,
-
-		U_TOTAL,
-	};
-
-
 	enum GameState
 	{
 		GAME_NOT_STARTED = 0,
@@ -112,16 +72,14 @@ public:
 	virtual void Update(double dt);
 	virtual void Render();
 	virtual void Exit();
+	virtual void LoadAssets();
+	virtual void UnloadAssets();
 
 private:
 	void HandleKeyPress();
-	void RenderMesh(Mesh* mesh, bool enableLight);
 
-	unsigned m_vertexArrayID;
 	Mesh* meshList[NUM_GEOMETRY];
-
-	unsigned m_programID;
-	unsigned m_parameters[U_TOTAL];
+	unsigned skybox; // cube map from AssetCache, 0 while the sky is off or failed to load
 
 	//AltAzCamera camera;
 	int projType = 1; // fix to 0 for orthographic, 1 for projection
@@ -185,16 +143,9 @@ private:
 	glm::vec3 playerSize;
 	bool CheckWallCollision(const glm::vec3& pos);
 
-	void RenderSkybox();
-	void RenderMeshOnScreen(Mesh* mesh, float x, float y,
-		float sizex, float sizey);
 
 	void HandleMouseInput();
 
-	void RenderText(Mesh* mesh, std::string text, glm::vec3
-		color);
-	void RenderTextOnScreen(Mesh* mesh, std::string text,
-		glm::vec3 color, float size, float x, float y);
 
 	float fps = 0;
 };
@@ -0,0 +1,478 @@
+#include "ShaderCache.h"
+#include "MeshBin.h"
+#include "MappedFile.h"
+#include "UniformCache.h"
+
+#include <GL\glew.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include <windows.h>
+
+namespace
+{
+	const char PROGRAM_BIN_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+	const unsigned PROGRAM_BIN_VERSION = 1;
+
+	// GL_KHR_parallel_shader_compile, which this GLEW does not know yet
+	const GLenum COMPLETION_STATUS_KHR = 0x91B1;
+	typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+
+	// Layout: Header, then the program binary
+	struct Header
+	{
+		char magic[4];
+		unsigned version;
+		unsigned long long sourceHash;
+		unsigned long long driverHash;
+		unsigned format;
+		unsigned size;
+		double compileTime;
+	};
+	static_assert(sizeof(Header) == 40, "program binary header layout changed, bump PROGRAM_BIN_VERSION");
+
+	unsigned long long HashString(unsigned long long hash, const char* text)
+	{
+		for (; text && *text; ++text)
+		{
+			hash ^= static_cast<unsigned char>(*text);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Put the #defines of a variant after the #version line, which must come first
+	void InsertDefines(std::string& source, const std::string& defines)
+	{
+		if (defines.empty())
+			return;
+		size_t lineEnd = source.find('\n');
+		size_t at = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+		source.insert(at, defines + "#line 2\n");
+	}
+
+	std::string BaseName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		return name.substr(0, name.find_last_of('.'));
+	}
+
+	bool ReadSource(const char* file_path, std::string& source)
+	{
+		std::ifstream stream(file_path, std::ios::in | std::ios::binary);
+		if (!stream.is_open())
+		{
+			printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", file_path);
+			return false;
+		}
+		source.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	void PrintShaderLog(GLuint shaderID)
+	{
+		GLint length = 0;
+		glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length);
+		if (length > 0)
+		{
+			std::vector<char> message(length + 1);
+			glGetShaderInfoLog(shaderID, length, NULL, &message[0]);
+			printf("%s\n", &message[0]);
+		}
+	}
+
+	void PrintProgramLog(GLuint programID)
+	{
+		GLint length = 0;
+		glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &length);
+		if (length > 0)
+		{
+			std::vector<char> message(length + 1);
+			glGetProgramInfoLog(programID, length, NULL, &message[0]);
+			printf("%s\n", &message[0]);
+		}
+	}
+}
+
+ShaderCache* ShaderCache::m_instance = nullptr;
+
+ShaderCache::ShaderCache(void)
+	: driverHash(0)
+	, driverDetected(false)
+	, binarySupported(false)
+	, parallelSupported(false)
+{
+	stats = Stats();
+}
+
+ShaderCache::~ShaderCache(void)
+{
+}
+
+ShaderCache* ShaderCache::GetInstance(void)
+{
+	if (m_instance == nullptr)
+	{
+		m_instance = new ShaderCache();
+	}
+	return m_instance;
+}
+
+void ShaderCache::DestroyInstance(void)
+{
+	if (m_instance)
+	{
+		delete m_instance;
+		m_instance = nullptr;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Get the program of a shader pair. A pair already loaded is shared, a cached
+binary is handed to the driver, anything else is compiled from source. The
+returned program may still be compiling; call Finish before using it.
+
+\param vertex_file_path - path of the vertex shader
+\param fragment_file_path - path of the fragment shader
+\param defines - #define lines put into both shaders, for a variant of the pair
+\return the program, 0 if a source file could not be read
+*/
+/******************************************************************************/
+unsigned ShaderCache::Load(const char* vertex_file_path, const char* fragment_file_path,
+	const std::string& defines)
+{
+	double start = glfwGetTime();
+	DetectDriver();
+
+	std::vector<std::string> paths;
+	paths.push_back(vertex_file_path);
+	paths.push_back(fragment_file_path);
+	unsigned long long sourceHash = HashString(MeshBin::HashFiles(paths), defines.c_str());
+
+	for (Program& program : programs)
+	{
+		if (program.sourceHash == sourceHash)
+		{
+			++program.refCount;
+			++stats.shared;
+			stats.savedTime += program.compileTime;
+			stats.loadTime += glfwGetTime() - start;
+			return program.id;
+		}
+	}
+
+	Program program;
+	program.sourceHash = sourceHash;
+	program.id = 0;
+	program.shaders[0] = program.shaders[1] = 0;
+	program.refCount = 1;
+	program.pending = false;
+	program.startTime = start;
+	program.compileTime = 0.0;
+	std::string vertexPath = vertex_file_path;
+	size_t slash = vertexPath.find_last_of("/\\");
+	program.name = BaseName(vertexPath) + "+" + BaseName(fragment_file_path);
+	if (!defines.empty())
+	{
+		// Each variant gets its own binary, named by its defines
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "-%08x", static_cast<unsigned>(HashString(14695981039346656037ull, defines.c_str())));
+		program.name += suffix;
+	}
+	program.binPath = (slash == std::string::npos ? std::string() : vertexPath.substr(0, slash + 1))
+		+ program.name + ".progbin";
+
+	if (LoadBinary(program))
+	{
+		double elapsed = glfwGetTime() - start;
+		++stats.fromBinary;
+		stats.savedTime += std::max(program.compileTime - elapsed, 0.0);
+		stats.loadTime += elapsed;
+		programs.push_back(program);
+		return program.id;
+	}
+
+	std::string sources[2];
+	if (!ReadSource(vertex_file_path, sources[0]) || !ReadSource(fragment_file_path, sources[1]))
+		return 0;
+	InsertDefines(sources[0], defines);
+	InsertDefines(sources[1], defines);
+
+	const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	program.id = glCreateProgram();
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		printf("Compiling shader : %s\n", paths[i].c_str());
+		program.shaders[i] = glCreateShader(types[i]);
+		const char* source = sources[i].c_str();
+		glShaderSource(program.shaders[i], 1, &source, NULL);
+		glCompileShader(program.shaders[i]);
+		glAttachShader(program.id, program.shaders[i]);
+	}
+	if (binarySupported)
+		glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program.id);
+	program.pending = true;
+
+	stats.loadTime += glfwGetTime() - start;
+	programs.push_back(program);
+	return program.id;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Wait for every program Load started, print their logs and write their
+binaries. With parallel compiles the programs are picked up as they finish,
+so each one's compile time is its own.
+*/
+/******************************************************************************/
+void ShaderCache::Finish(void)
+{
+	double start = glfwGetTime();
+
+	bool waiting = parallelSupported;
+	while (waiting)
+	{
+		waiting = false;
+		for (Program& program : programs)
+		{
+			if (!program.pending)
+				continue;
+			if (IsComplete(program))
+				Complete(program, glfwGetTime());
+			else
+				waiting = true;
+		}
+		if (waiting)
+			std::this_thread::yield();
+	}
+
+	// Without parallel compiles, asking for the link status waits for the driver
+	for (Program& program : programs)
+	{
+		if (program.pending)
+			Complete(program, glfwGetTime());
+	}
+
+	stats.loadTime += glfwGetTime() - start;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Give back a program from Load; it is deleted when its last user releases it
+
+\param programID - program returned by Load
+*/
+/******************************************************************************/
+void ShaderCache::Release(unsigned programID)
+{
+	for (unsigned i = 0; i < programs.size(); ++i)
+	{
+		Program& program = programs[i];
+		if (program.id != programID)
+			continue;
+		if (--program.refCount > 0)
+			return;
+
+		for (unsigned shader = 0; shader < 2; ++shader)
+			glDeleteShader(program.shaders[shader]);
+		UniformCache::GetInstance()->ForgetProgram(program.id);
+		glDeleteProgram(program.id);
+		programs.erase(programs.begin() + i);
+		return;
+	}
+}
+
+// Counted since the program started
+const ShaderCache::Stats& ShaderCache::GetStats(void) const
+{
+	return stats;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Check once, with a context current, which of the binary and parallel compile
+extensions the driver has, and hash the strings a binary is only valid for
+*/
+/******************************************************************************/
+void ShaderCache::DetectDriver(void)
+{
+	if (driverDetected)
+		return;
+	driverDetected = true;
+
+	driverHash = 14695981039346656037ull;
+	driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+	driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+	driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+	GLint formats = 0;
+	if (GLEW_ARB_get_program_binary || GLEW_VERSION_4_1)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binarySupported = formats > 0;
+
+	MaxShaderCompilerThreadsProc maxThreads = nullptr;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+		maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+		maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+	parallelSupported = maxThreads != nullptr;
+	if (maxThreads)
+		maxThreads(0xFFFFFFFF); // as many threads as the driver likes
+
+	printf("Shader cache: program binaries %s, parallel compile %s\n",
+		binarySupported ? "on" : "off", parallelSupported ? "on" : "off");
+}
+
+/******************************************************************************/
+/*!
+\brief
+Link a program from its .progbin. The driver may still refuse a binary whose
+tags match, e.g. after an update that kept the version string.
+
+\param program - gets its id and recorded compile time
+\return false if there is no usable binary
+*/
+/******************************************************************************/
+bool ShaderCache::LoadBinary(Program& program)
+{
+	if (!binarySupported)
+		return false;
+
+	MappedFile file;
+	if (!file.Open(program.binPath) || file.GetSize() < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file.GetData(), sizeof(Header));
+	if (memcmp(header.magic, PROGRAM_BIN_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != PROGRAM_BIN_VERSION
+		|| header.sourceHash != program.sourceHash
+		|| header.driverHash != driverHash
+		|| header.size != file.GetSize() - sizeof(Header))
+		return false;
+
+	program.id = glCreateProgram();
+	glProgramBinary(program.id, header.format, file.GetData() + sizeof(Header), header.size);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		glDeleteProgram(program.id);
+		program.id = 0;
+		return false;
+	}
+	program.compileTime = header.compileTime;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Write a linked program's binary. The file is written under a temporary name
+and renamed, so a crash never leaves half a file.
+
+\param program - program to write
+*/
+/******************************************************************************/
+void ShaderCache::SaveBinary(const Program& program)
+{
+	if (!binarySupported)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program.id, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+	Header header;
+	memcpy(header.magic, PROGRAM_BIN_MAGIC, sizeof(header.magic));
+	header.version = PROGRAM_BIN_VERSION;
+	header.sourceHash = program.sourceHash;
+	header.driverHash = driverHash;
+	header.format = format;
+	header.size = static_cast<unsigned>(written);
+	header.compileTime = program.compileTime;
+
+	std::ostringstream tmp_path;
+	tmp_path << program.binPath << '.' << GetCurrentThreadId() << ".tmp";
+	{
+		std::ofstream fileStream(tmp_path.str(), std::ios::binary | std::ios::trunc);
+		if (!fileStream.is_open())
+		{
+			std::cout << "Impossible to write " << tmp_path.str() << "\n";
+			return;
+		}
+		fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fileStream.write(binary.data(), written);
+		if (!fileStream.good())
+		{
+			fileStream.close();
+			DeleteFileA(tmp_path.str().c_str());
+			return;
+		}
+	}
+	if (!MoveFileExA(tmp_path.str().c_str(), program.binPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+		DeleteFileA(tmp_path.str().c_str());
+}
+
+// Whether the driver is done with a program, without waiting for it
+bool ShaderCache::IsComplete(const Program& program) const
+{
+	GLint done = GL_FALSE;
+	glGetProgramiv(program.id, COMPLETION_STATUS_KHR, &done);
+	return done != GL_FALSE;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Collect a compiled program: print its logs, drop its shaders and write its
+binary if it linked
+
+\param program - program Load started
+\param now - glfwGetTime when it was found finished
+*/
+/******************************************************************************/
+void ShaderCache::Complete(Program& program, double now)
+{
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		PrintShaderLog(program.shaders[i]);
+		glDetachShader(program.id, program.shaders[i]);
+		glDeleteShader(program.shaders[i]);
+		program.shaders[i] = 0;
+	}
+
+	printf("Linking program %s\n", program.name.c_str());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+	PrintProgramLog(program.id);
+
+	program.pending = false;
+	program.compileTime = now - program.startTime;
+	++stats.compiled;
+	if (linked)
+		SaveBinary(program);
+}
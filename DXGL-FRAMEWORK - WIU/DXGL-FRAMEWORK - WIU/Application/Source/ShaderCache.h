@@ -0,0 +1,80 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <string>
+#include <vector>
+
+/******************************************************************************/
+/*!
+		Class ShaderCache:
+\brief	Linked shader programs, keyed by a hash of their source files and
+		#defines and shared by everyone who loads the same variant. A
+		linked program is written beside its vertex shader as
+		<vertex>+<fragment>.progbin, with a suffix per set of defines,
+		using glGetProgramBinary, so the next launch hands the binary back
+		to the driver instead of compiling. The binary is tagged with the
+		source hash and the driver's vendor, renderer and version, and
+		compiled again when any of them changes.
+
+		Load only starts a compile; Finish waits for every program started
+		since the last Finish. Where the driver has
+		GL_KHR_parallel_shader_compile, the programs of one batch compile
+		side by side on its threads.
+*/
+/******************************************************************************/
+class ShaderCache
+{
+public:
+	struct Stats
+	{
+		unsigned compiled;   // programs built from source
+		unsigned fromBinary; // programs loaded from a .progbin
+		unsigned shared;     // loads handed an already linked program
+		double loadTime;     // seconds spent in Load and Finish
+		double savedTime;    // seconds the binaries and sharing saved, by the compile times they recorded
+	};
+
+	static ShaderCache* GetInstance(void);
+	static void DestroyInstance(void);
+
+	unsigned Load(const char* vertex_file_path, const char* fragment_file_path,
+		const std::string& defines = std::string());
+	void Finish(void);
+	void Release(unsigned programID);
+
+	const Stats& GetStats(void) const;
+
+private:
+	ShaderCache(void);
+	~ShaderCache(void);
+
+	struct Program
+	{
+		unsigned long long sourceHash;
+		unsigned id;
+		unsigned shaders[2]; // vertex and fragment shader until the link is done, else 0
+		unsigned refCount;
+		bool pending;        // compiling or linking, not checked yet
+		double startTime;    // glfwGetTime when its compile was started
+		double compileTime;  // seconds the compile took, here or on the launch that wrote the binary
+		std::string binPath;
+		std::string name;
+	};
+
+	void DetectDriver(void);
+	bool LoadBinary(Program& program);
+	void SaveBinary(const Program& program);
+	bool IsComplete(const Program& program) const;
+	void Complete(Program& program, double now);
+
+	static ShaderCache* m_instance;
+
+	std::vector<Program> programs;
+	unsigned long long driverHash;
+	bool driverDetected;
+	bool binarySupported;
+	bool parallelSupported;
+	Stats stats;
+};
+
+#endif
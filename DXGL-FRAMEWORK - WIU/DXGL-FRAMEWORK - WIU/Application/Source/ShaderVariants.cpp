@@ -0,0 +1,175 @@
+#include "ShaderVariants.h"
+#include "ShaderCache.h"
+#include "GL\glew.h"
+
+#include <sstream>
+
+namespace
+{
+	const unsigned FEATURE_BITS = 4;
+	const unsigned FEATURE_MASK = (1u << FEATURE_BITS) - 1;
+	const unsigned COUNT_BITS = 4;
+	const unsigned COUNT_MASK = (1u << COUNT_BITS) - 1;
+	const unsigned TYPE_BITS = 2;
+	const unsigned MAX_LIGHTS = 8; // MAX_LIGHTS of the shaders
+	const unsigned CLUSTERED_COUNT = COUNT_MASK;
+}
+
+ShaderVariants::ShaderVariants()
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set the shader pair the variants are built from
+
+\param vertex_file_path - path of the vertex shader
+\param fragment_file_path - path of the fragment shader
+*/
+/******************************************************************************/
+void ShaderVariants::Init(const char* vertex_file_path, const char* fragment_file_path)
+{
+	vertexPath = vertex_file_path;
+	fragmentPath = fragment_file_path;
+}
+
+// Give every variant back to ShaderCache
+void ShaderVariants::Exit()
+{
+	for (const std::pair<const unsigned, unsigned>& program : programs)
+	{
+		if (program.second)
+			ShaderCache::GetInstance()->Release(program.second);
+	}
+	programs.clear();
+	started.clear();
+	linked.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Light bits of the key for a set of lights. Past the shaders' MAX_LIGHTS the
+lights are clustered, and their types are left to the shader.
+
+\param lights - the scene's lights
+\param count - number of lights
+\return key bits above the features
+*/
+/******************************************************************************/
+unsigned ShaderVariants::GetLightKey(const Light* lights, unsigned count)
+{
+	if (count > MAX_LIGHTS)
+		return CLUSTERED_COUNT << FEATURE_BITS;
+	unsigned key = count << FEATURE_BITS;
+	for (unsigned i = 0; i < count; ++i)
+		key |= static_cast<unsigned>(lights[i].type) << (FEATURE_BITS + COUNT_BITS + i * TYPE_BITS);
+	return key;
+}
+
+// Key of a variant; the lights only matter to lit ones
+unsigned ShaderVariants::MakeKey(unsigned features, unsigned lightKey)
+{
+	return (features & LIT) ? (features | lightKey) : features;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Start building a variant unless it was requested before; it can be drawn
+with after the next Finish
+
+\param key - key from MakeKey
+*/
+/******************************************************************************/
+void ShaderVariants::Request(unsigned key)
+{
+	if (programs.count(key))
+		return;
+
+	unsigned programID = ShaderCache::GetInstance()->Load(vertexPath.c_str(), fragmentPath.c_str(), GetDefines(key));
+	programs[key] = programID;
+	if (programID)
+		started.push_back(key);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Wait for the variants requested since the last Finish. A variant that fails
+to link is dropped, so its draws fall back to the plain pair.
+
+\return the programs that linked, e.g. to bind their uniform blocks
+*/
+/******************************************************************************/
+const std::vector<unsigned>& ShaderVariants::Finish()
+{
+	ShaderCache::GetInstance()->Finish();
+	linked.clear();
+	for (unsigned key : started)
+	{
+		unsigned& programID = programs[key];
+		GLint status = GL_FALSE;
+		glGetProgramiv(programID, GL_LINK_STATUS, &status);
+		if (status)
+		{
+			linked.push_back(programID);
+			continue;
+		}
+		ShaderCache::GetInstance()->Release(programID);
+		programID = 0;
+	}
+	started.clear();
+	return linked;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Program of a variant
+
+\param key - key from MakeKey
+\return the program, 0 if it was never requested or failed to load
+*/
+/******************************************************************************/
+unsigned ShaderVariants::Get(unsigned key) const
+{
+	std::map<unsigned, unsigned>::const_iterator it = programs.find(key);
+	return it == programs.end() ? 0 : it->second;
+}
+
+// #define lines of a variant, read by Texture.vertexshader and Text.fragmentshader
+std::string ShaderVariants::GetDefines(unsigned key)
+{
+	unsigned features = key & FEATURE_MASK;
+	unsigned count = (features & LIT) ? (key >> FEATURE_BITS) & COUNT_MASK : 0;
+
+	std::ostringstream defines;
+	defines << "#define PERMUTATION\n";
+	if (count == CLUSTERED_COUNT)
+	{
+		defines << "#define CLUSTERED\n";
+		count = 0;
+	}
+	defines << "#define LIGHT_ENABLED " << ((features & LIT) ? "true" : "false") << "\n";
+	defines << "#define COLOR_TEXTURE_ENABLED " << ((features & TEXTURED) ? "true" : "false") << "\n";
+	defines << "#define TEXT_ENABLED " << ((features & TEXT) ? "true" : "false") << "\n";
+	defines << "#define INSTANCING_ENABLED " << ((features & INSTANCED) ? "true" : "false") << "\n";
+	defines << "#define LIGHT_COUNT " << count << "\n";
+	if (count > 0)
+	{
+		defines << "#define LIGHT_TYPES ";
+		for (unsigned i = 0; i < count; ++i)
+		{
+			unsigned type = (key >> (FEATURE_BITS + COUNT_BITS + i * TYPE_BITS)) & ((1u << TYPE_BITS) - 1);
+			defines << (i > 0 ? ", " : "") << type;
+		}
+		defines << "\n";
+	}
+	return defines.str();
+}
@@ -0,0 +1,59 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Light.h"
+
+/******************************************************************************/
+/*!
+		Class ShaderVariants:
+\brief	Compile time variants of one shader pair, built through ShaderCache
+		with #defines in place of the pair's switch uniforms. A variant is
+		named by a key: the FEATURE bits, then for lit variants the number
+		of lights and the type of each, so its light loop unrolls with
+		every branch decided. The shaders keep their uniforms when PERMUTATION
+		is not defined, so the plain pair still draws anything.
+
+		Key layout, least significant first:
+		features(4) | light count(4) | type of light 0..7 (2 each)
+		A light count of 15 marks more lights than the shaders' MAX_LIGHTS;
+		those variants read the lights from LightClusters instead.
+*/
+/******************************************************************************/
+class ShaderVariants
+{
+public:
+	enum FEATURE
+	{
+		LIT = 1 << 0,
+		TEXTURED = 1 << 1,
+		TEXT = 1 << 2,
+		INSTANCED = 1 << 3,
+	};
+
+	ShaderVariants();
+	~ShaderVariants();
+
+	void Init(const char* vertex_file_path, const char* fragment_file_path);
+	void Exit();
+
+	static unsigned GetLightKey(const Light* lights, unsigned count);
+	static unsigned MakeKey(unsigned features, unsigned lightKey);
+
+	void Request(unsigned key);
+	const std::vector<unsigned>& Finish();
+	unsigned Get(unsigned key) const;
+
+private:
+	static std::string GetDefines(unsigned key);
+
+	std::string vertexPath, fragmentPath;
+	std::map<unsigned, unsigned> programs; // key -> program, 0 if it failed to load
+	std::vector<unsigned> started;         // keys requested since the last Finish
+	std::vector<unsigned> linked;          // programs returned by Finish
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "TexBin.h"
+#include "MeshBin.h"
+#include "MappedFile.h"
+#include "timer.h"
+
+#include <GL\glew.h>
+#include "LoadTGA.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <windows.h>
+
+namespace
+{
+	const char TEX_BIN_MAGIC[4] = { 'T', 'B', 'I', 'N' };
+	const unsigned TEX_BIN_VERSION = 1;
+
+	// Layout: Header, then every level, largest first
+	struct Header
+	{
+		char magic[4];
+		unsigned version;
+		unsigned long long sourceHash;
+		unsigned width;
+		unsigned height;
+		unsigned bytesPerPixel;
+		unsigned format;
+		unsigned levelCount;
+		unsigned dataSize;
+	};
+	static_assert(sizeof(Header) == 40, "TexBin header layout changed, bump TEX_BIN_VERSION");
+
+	// Size of the levels a header describes, 0 if it does not add up
+	size_t LevelsSize(const Header& header)
+	{
+		if (header.format > TEXTURE_BC3 || header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > 32)
+			return 0;
+		size_t size = 0;
+		for (unsigned level = 0; level < header.levelCount; ++level)
+		{
+			unsigned width = header.width >> level, height = header.height >> level;
+			size += GetTextureLevelSize(header.format, width ? width : 1, height ? height : 1);
+		}
+		return size;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Path of the cache file of a TGA, e.g. Images//calibri.tga -> Images//calibri.texbin
+
+\param tga_path - path of the TGA file
+\return path of the .texbin file
+*/
+/******************************************************************************/
+std::string TexBin::GetPath(const std::string& tga_path)
+{
+	size_t dot = tga_path.find_last_of('.');
+	size_t slash = tga_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return tga_path + ".texbin";
+	return tga_path.substr(0, dot) + ".texbin";
+}
+
+/******************************************************************************/
+/*!
+\brief
+Map a .texbin into image. The levels stay in the mapping, which image keeps
+open until it is destroyed.
+
+\param bin_path - path of the .texbin file
+\param sourceHash - hash of the current source file and settings
+\param image - receives the levels
+\return false if the file is missing, stale or damaged
+*/
+/******************************************************************************/
+bool TexBin::Load(const std::string& bin_path, unsigned long long sourceHash, TGAImage& image)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(bin_path) || file->GetSize() < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file->GetData(), sizeof(Header));
+	if (memcmp(header.magic, TEX_BIN_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != TEX_BIN_VERSION
+		|| header.sourceHash != sourceHash
+		|| header.dataSize != LevelsSize(header)
+		|| file->GetSize() != sizeof(Header) + header.dataSize)
+		return false;
+
+	image.width = header.width;
+	image.height = header.height;
+	image.bytesPerPixel = header.bytesPerPixel;
+	image.format = header.format;
+	image.levelCount = header.levelCount;
+	image.data.clear();
+	image.fileData = file->GetData() + sizeof(Header);
+	image.fileSize = header.dataSize;
+	image.file = file;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Write image as a .texbin. The file is written under a temporary name and
+renamed, so a crash or another loader never sees half a file.
+
+\param bin_path - path of the .texbin file
+\param sourceHash - hash of the source file and settings image was built with
+\param image - levels as built by DecodeTGA
+\return false if the file could not be written
+*/
+/******************************************************************************/
+bool TexBin::Save(const std::string& bin_path, unsigned long long sourceHash, const TGAImage& image)
+{
+	Header header;
+	memcpy(header.magic, TEX_BIN_MAGIC, sizeof(header.magic));
+	header.version = TEX_BIN_VERSION;
+	header.sourceHash = sourceHash;
+	header.width = image.width;
+	header.height = image.height;
+	header.bytesPerPixel = image.bytesPerPixel;
+	header.format = image.format;
+	header.levelCount = image.levelCount;
+	header.dataSize = static_cast<unsigned>(image.GetSize());
+
+	std::ostringstream tmp_path;
+	tmp_path << bin_path << '.' << GetCurrentThreadId() << ".tmp";
+
+	{
+		std::ofstream fileStream(tmp_path.str(), std::ios::binary | std::ios::trunc);
+		if (!fileStream.is_open())
+		{
+			std::cout << "Impossible to write " << tmp_path.str() << "\n";
+			return false;
+		}
+		fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fileStream.write(reinterpret_cast<const char*>(image.GetLevels()), header.dataSize);
+		if (!fileStream.good())
+		{
+			fileStream.close();
+			DeleteFileA(tmp_path.str().c_str());
+			return false;
+		}
+	}
+
+	// Fails if a loader still has the old file mapped; the next load writes it
+	if (!MoveFileExA(tmp_path.str().c_str(), bin_path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tmp_path.str().c_str());
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Print the memory and load times of every TGA in a folder. Memory is given as
+the single uncompressed level the old loader uploaded and as the full mip
+chain that is uploaded now. Cold decodes the TGA, builds the levels and
+writes the .texbin; warm is the average of loads from the .texbin. Neither
+uploads to GL.
+
+\param folder - folder with the TGA files, ending in a separator
+*/
+/******************************************************************************/
+void TexBin::Benchmark(const std::string& folder)
+{
+	const int WARM_RUNS = 10;
+	const char* FORMAT_NAMES[] = { "BGR", "BGRA", "BC1", "BC3" };
+
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((folder + "*.tga").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "No TGA files in " << folder << "\n";
+		return;
+	}
+
+	StopWatch timer;
+	unsigned long long totalRaw = 0, totalUploaded = 0;
+	double totalCold = 0.0, totalWarm = 0.0;
+	std::cout << "TexBin benchmark (" << WARM_RUNS << " warm runs)\n";
+	do
+	{
+		std::string tga_path = folder + found.cFileName;
+		DeleteFileA(GetPath(tga_path).c_str());
+
+		TGAImage cold;
+		timer.startTimer();
+		bool loaded = DecodeTGA(tga_path.c_str(), cold);
+		double coldTime = timer.getElapsedTime();
+		if (!loaded)
+			continue;
+
+		double warmTime = 0.0;
+		volatile unsigned char touched = 0;
+		for (int run = 0; run < WARM_RUNS; ++run)
+		{
+			TGAImage warm;
+			timer.startTimer();
+			DecodeTGA(tga_path.c_str(), warm);
+			// Touch every page like glCompressedTexImage2D would
+			const unsigned char* bytes = warm.GetLevels();
+			for (size_t i = 0; i < warm.GetSize(); i += 4096)
+				touched ^= bytes[i];
+			warmTime += timer.getElapsedTime();
+		}
+		warmTime /= WARM_RUNS;
+
+		unsigned long long raw = static_cast<unsigned long long>(cold.width) * cold.height * cold.bytesPerPixel;
+		totalRaw += raw;
+		totalUploaded += cold.GetSize();
+		totalCold += coldTime;
+		totalWarm += warmTime;
+		std::cout << "  " << found.cFileName << ": " << cold.width << "x" << cold.height << ", "
+			<< raw / 1024 << " KB -> " << cold.GetSize() / 1024 << " KB (" << FORMAT_NAMES[cold.format]
+			<< ", " << cold.levelCount << " levels), cold " << coldTime * 1000.0 << " ms, warm "
+			<< warmTime * 1000.0 << " ms\n";
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+
+	std::cout << "  total: " << totalRaw / 1024 << " KB -> " << totalUploaded / 1024 << " KB, cold "
+		<< totalCold * 1000.0 << " ms, warm " << totalWarm * 1000.0 << " ms\n";
+}
@@ -0,0 +1,28 @@
+#ifndef TEX_BIN_H
+#define TEX_BIN_H
+
+#include <string>
+
+struct TGAImage;
+
+/******************************************************************************/
+/*!
+		Class TexBin:
+\brief	Binary cache of a decoded TGA, written beside it as <name>.texbin.
+		It holds every mip level in the format they are uploaded in, tagged
+		with a hash of the source file so an edited TGA is decoded again.
+		Loading maps the file and uploads the levels straight from it.
+*/
+/******************************************************************************/
+class TexBin
+{
+public:
+	static std::string GetPath(const std::string& tga_path);
+
+	static bool Load(const std::string& bin_path, unsigned long long sourceHash, TGAImage& image);
+	static bool Save(const std::string& bin_path, unsigned long long sourceHash, const TGAImage& image);
+
+	static void Benchmark(const std::string& folder);
+};
+
+#endif
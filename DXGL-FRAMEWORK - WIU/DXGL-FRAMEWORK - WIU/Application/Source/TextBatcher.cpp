@@ -0,0 +1,356 @@
+#include "TextBatcher.h"
+#include "GL\glew.h"
+
+// GLM Headers
+#include <glm\gtc\matrix_transform.hpp>
+#include <glm\gtc\type_ptr.hpp>
+
+#include "Mesh.h"
+#include "MeshBuilder.h"
+#include "UniformCache.h"
+
+namespace
+{
+	// Glyph caches above this size are dropped, so per-frame strings like timers cannot grow it forever
+	const unsigned MAX_CACHED_STRINGS = 256;
+}
+
+bool TextBatcher::Entry::operator==(const Entry& rhs) const
+{
+	return text == rhs.text && transform == rhs.transform && color == rhs.color;
+}
+
+TextBatcher::TextBatcher()
+	: m_programID(0)
+	, m_textureID(0)
+	, numRow(16)
+	, numCol(16)
+	, advance(1.f)
+	, worldOrigin(0.f, 0.f)
+	, screenOrigin(0.f, 0.f)
+{
+	worldBatch.vertexArray = screenBatch.vertexArray = 0;
+}
+
+TextBatcher::~TextBatcher()
+{
+}
+
+/******************************************************************************/
+/*!
+\brief
+Create the dynamic buffers and look up the text uniforms
+
+\param programID - program drawing the text, with Text.fragmentshader
+\param textureID - font texture laid out as numRow x numCol glyphs
+\param numRow - rows of glyphs in the font texture
+\param numCol - columns of glyphs in the font texture
+*/
+/******************************************************************************/
+void TextBatcher::Init(unsigned programID, unsigned textureID, unsigned numRow, unsigned numCol)
+{
+	m_programID = programID;
+	m_textureID = textureID;
+	this->numRow = numRow;
+	this->numCol = numCol;
+
+	m_parameters[U_MVP] = glGetUniformLocation(programID, "MVP");
+	m_parameters[U_LIGHTENABLED] = glGetUniformLocation(programID, "lightEnabled");
+	m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(programID, "colorTextureEnabled");
+	m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(programID, "colorTexture");
+	m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(programID, "textEnabled");
+	m_parameters[U_TEXT_COLOR] = glGetUniformLocation(programID, "textColor");
+
+	InitBatch(worldBatch);
+	InitBatch(screenBatch);
+	glyphCache.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Delete the buffers; the font texture belongs to the caller
+*/
+/******************************************************************************/
+void TextBatcher::Exit()
+{
+	ExitBatch(worldBatch);
+	ExitBatch(screenBatch);
+	glyphCache.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Change the font texture; it must use the same glyph grid as Init
+
+\param textureID - font texture, 0 for none
+*/
+/******************************************************************************/
+void TextBatcher::SetTexture(unsigned textureID)
+{
+	m_textureID = textureID;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Set the glyph spacing, in units of the text size
+
+\param advance - distance from one glyph to the next
+\param worldOrigin - centre of the first glyph for AddText
+\param screenOrigin - centre of the first glyph for AddTextOnScreen
+*/
+/******************************************************************************/
+void TextBatcher::SetLayout(float advance, const glm::vec2& worldOrigin, const glm::vec2& screenOrigin)
+{
+	this->advance = advance;
+	this->worldOrigin = worldOrigin;
+	this->screenOrigin = screenOrigin;
+	glyphCache.clear();
+	worldBatch.uploaded.clear();
+	screenBatch.uploaded.clear();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a string in world space, drawn at the next Flush
+
+\param text - string to draw
+\param model - world matrix of the string, usually modelStack.Top()
+\param color - text color
+*/
+/******************************************************************************/
+void TextBatcher::AddText(const std::string& text, const glm::mat4& model, const glm::vec3& color)
+{
+	glm::mat4 transform = glm::translate(model, glm::vec3(worldOrigin, 0.f));
+	AddEntry(worldBatch, text, transform, color);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Queue a string on the 800x600 screen UI, drawn at the next Flush
+
+\param text - string to draw
+\param color - text color
+\param size - glyph size in UI units
+\param x - x position in UI units
+\param y - y position in UI units
+*/
+/******************************************************************************/
+void TextBatcher::AddTextOnScreen(const std::string& text, const glm::vec3& color, float size, float x, float y)
+{
+	glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(x, y, 0));
+	transform = glm::scale(transform, glm::vec3(size, size, size));
+	transform = glm::translate(transform, glm::vec3(screenOrigin, 0.f));
+	AddEntry(screenBatch, text, transform, color);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw the queued world strings, depth tested against the scene
+
+\param view - camera view matrix
+\param projection - camera projection matrix
+*/
+/******************************************************************************/
+void TextBatcher::FlushWorld(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (worldBatch.entries.empty())
+		return;
+
+	BeginDraw();
+	// Disable back face culling
+	glDisable(GL_CULL_FACE);
+	DrawBatch(worldBatch, projection * view);
+	glEnable(GL_CULL_FACE);
+	EndDraw();
+}
+
+/******************************************************************************/
+/*!
+\brief
+Draw the queued screen strings over everything, after the world strings so
+they can go to a different framebuffer
+*/
+/******************************************************************************/
+void TextBatcher::FlushScreen()
+{
+	if (screenBatch.entries.empty())
+		return;
+
+	BeginDraw();
+	glDisable(GL_DEPTH_TEST);
+	glm::mat4 ortho = glm::ortho(0.f, 800.f, 0.f, 600.f, -100.f, 100.f); // dimension of screen UI
+	DrawBatch(screenBatch, ortho);
+	glEnable(GL_DEPTH_TEST);
+	EndDraw();
+}
+
+// Program, blending and font texture shared by both spaces
+void TextBatcher::BeginDraw()
+{
+	UniformCache* uniforms = UniformCache::GetInstance();
+	uniforms->UseProgram(m_programID);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// The text color is baked into the vertex color
+	glm::vec3 white(1.f, 1.f, 1.f);
+	uniforms->Uniform1i(m_parameters[U_TEXT_ENABLED], 1);
+	uniforms->Uniform3fv(m_parameters[U_TEXT_COLOR], &white.r);
+	uniforms->Uniform1i(m_parameters[U_LIGHTENABLED], 0);
+	uniforms->Uniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	uniforms->Uniform1i(m_parameters[U_COLOR_TEXTURE], 0);
+}
+
+void TextBatcher::EndDraw()
+{
+	UniformCache* uniforms = UniformCache::GetInstance();
+	glBindTexture(GL_TEXTURE_2D, 0);
+	uniforms->Uniform1i(m_parameters[U_TEXT_ENABLED], 0);
+	glDisable(GL_BLEND);
+}
+
+void TextBatcher::InitBatch(Batch& batch)
+{
+	batch.entries.clear();
+	batch.uploaded.clear();
+	batch.vertices.clear();
+	batch.quadCapacity = 0;
+	batch.quadCount = 0;
+
+	glGenVertexArrays(1, &batch.vertexArray);
+	glGenBuffers(1, &batch.vertexBuffer);
+	glGenBuffers(1, &batch.indexBuffer);
+
+	// Same layout as the VAOs built by MeshBuilder
+	Mesh::BindVertexArray(batch.vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.indexBuffer);
+	glEnableVertexAttribArray(0); // 1st attribute buffer : positions
+	glEnableVertexAttribArray(1); // 2nd attribute buffer : colors
+	glEnableVertexAttribArray(2); // 3rd attribute : normals
+	glEnableVertexAttribArray(3); // 4th attribute : texture coordinate
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(glm::vec3));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+		(void*)(sizeof(glm::vec3) + sizeof(glm::vec3)));
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+		(void*)(sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec3)));
+	Mesh::BindVertexArray(0);
+}
+
+void TextBatcher::ExitBatch(Batch& batch)
+{
+	if (batch.vertexArray == 0)
+		return;
+
+	Mesh::BindVertexArray(0);
+	glDeleteVertexArrays(1, &batch.vertexArray);
+	glDeleteBuffers(1, &batch.vertexBuffer);
+	glDeleteBuffers(1, &batch.indexBuffer);
+	batch.vertexArray = 0;
+	batch.entries.clear();
+	batch.uploaded.clear();
+}
+
+void TextBatcher::AddEntry(Batch& batch, const std::string& text, const glm::mat4& transform, const glm::vec3& color)
+{
+	if (text.empty() || batch.vertexArray == 0)
+		return;
+
+	batch.entries.push_back(Entry());
+	Entry& entry = batch.entries.back();
+	entry.text = text;
+	entry.transform = transform;
+	entry.color = color;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Get the unit-size glyph quads of a string laid out along x, building and
+caching them the first time the string is seen
+
+\param text - string to lay out
+
+\return 4 vertices per character
+*/
+/******************************************************************************/
+const std::vector<Vertex>& TextBatcher::GetGlyphs(const std::string& text)
+{
+	std::map<std::string, std::vector<Vertex>>::iterator it = glyphCache.find(text);
+	if (it != glyphCache.end())
+		return it->second;
+
+	if (glyphCache.size() >= MAX_CACHED_STRINGS)
+		glyphCache.clear();
+
+	std::vector<Vertex>& glyphs = glyphCache[text];
+	glyphs.reserve(text.length() * 4);
+	for (unsigned i = 0; i < text.length(); ++i)
+	{
+		unsigned glyph = static_cast<unsigned char>(text[i]) % (numRow * numCol);
+		MeshBuilder::GenerateGlyph(glyphs, glyph / numCol, glyph % numCol, numRow, numCol);
+		for (unsigned j = glyphs.size() - 4; j < glyphs.size(); ++j)
+			glyphs[j].pos.x += i * advance;
+	}
+	return glyphs;
+}
+
+void TextBatcher::DrawBatch(Batch& batch, const glm::mat4& MVP)
+{
+	Mesh::BindVertexArray(batch.vertexArray);
+
+	// Same strings as the last upload: the vertex buffer is still valid
+	if (batch.entries != batch.uploaded)
+	{
+		batch.vertices.clear();
+		for (unsigned i = 0; i < batch.entries.size(); ++i)
+		{
+			const Entry& entry = batch.entries[i];
+			const std::vector<Vertex>& glyphs = GetGlyphs(entry.text);
+			for (unsigned j = 0; j < glyphs.size(); ++j)
+			{
+				Vertex v = glyphs[j];
+				v.pos = glm::vec3(entry.transform * glm::vec4(v.pos, 1.f));
+				v.color = entry.color;
+				batch.vertices.push_back(v);
+			}
+		}
+
+		batch.quadCount = batch.vertices.size() / 4;
+		if (batch.quadCount > batch.quadCapacity)
+		{
+			// Grow both buffers; the index pattern only depends on the quad count
+			batch.quadCapacity = batch.quadCount * 2;
+			std::vector<GLuint> index_buffer_data;
+			index_buffer_data.reserve(batch.quadCapacity * 6);
+			for (GLuint quad = 0, offset = 0; quad < batch.quadCapacity; ++quad, offset += 4)
+			{
+				index_buffer_data.push_back(0 + offset);
+				index_buffer_data.push_back(1 + offset);
+				index_buffer_data.push_back(2 + offset);
+				index_buffer_data.push_back(0 + offset);
+				index_buffer_data.push_back(2 + offset);
+				index_buffer_data.push_back(3 + offset);
+			}
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, batch.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, batch.quadCapacity * 4 * sizeof(Vertex), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, batch.vertices.size() * sizeof(Vertex), &batch.vertices[0]);
+		batch.uploaded.swap(batch.entries);
+	}
+
+	UniformCache::GetInstance()->UniformMatrix4fv(m_parameters[U_MVP], glm::value_ptr(MVP));
+	glDrawElements(GL_TRIANGLES, batch.quadCount * 6, GL_UNSIGNED_INT, 0);
+	batch.entries.clear();
+}
@@ -0,0 +1,92 @@
+#ifndef TEXT_BATCHER_H
+#define TEXT_BATCHER_H
+
+// GLM Headers
+#include <glm\glm.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Vertex.h"
+
+/******************************************************************************/
+/*!
+		Class TextBatcher:
+\brief	Collects the strings of a frame and draws them with one draw call per
+		space (world and screen), using the glyph grid of
+		MeshBuilder::GenerateText. Glyph quads are cached per string and
+		the vertex buffer is only re-uploaded when the strings change.
+*/
+/******************************************************************************/
+class TextBatcher
+{
+public:
+	TextBatcher();
+	~TextBatcher();
+
+	void Init(unsigned programID, unsigned textureID, unsigned numRow = 16, unsigned numCol = 16);
+	void Exit();
+	void SetTexture(unsigned textureID);
+	void SetLayout(float advance, const glm::vec2& worldOrigin, const glm::vec2& screenOrigin);
+
+	void AddText(const std::string& text, const glm::mat4& model, const glm::vec3& color);
+	void AddTextOnScreen(const std::string& text, const glm::vec3& color, float size, float x, float y);
+	void FlushWorld(const glm::mat4& view, const glm::mat4& projection);
+	void FlushScreen();
+
+private:
+	enum UNIFORM_TYPE
+	{
+		U_MVP = 0,
+		U_LIGHTENABLED,
+		U_COLOR_TEXTURE_ENABLED,
+		U_COLOR_TEXTURE,
+		U_TEXT_ENABLED,
+		U_TEXT_COLOR,
+
+		U_TOTAL,
+	};
+
+	struct Entry
+	{
+		std::string text;
+		glm::mat4 transform;
+		glm::vec3 color;
+
+		bool operator==(const Entry& rhs) const;
+	};
+
+	struct Batch
+	{
+		std::vector<Entry> entries; // added this frame
+		std::vector<Entry> uploaded; // currently in the vertex buffer
+		std::vector<Vertex> vertices;
+		unsigned vertexArray;
+		unsigned vertexBuffer;
+		unsigned indexBuffer;
+		unsigned quadCapacity;
+		unsigned quadCount;
+	};
+
+	void InitBatch(Batch& batch);
+	void ExitBatch(Batch& batch);
+	void AddEntry(Batch& batch, const std::string& text, const glm::mat4& transform, const glm::vec3& color);
+	const std::vector<Vertex>& GetGlyphs(const std::string& text);
+	void BeginDraw();
+	void EndDraw();
+	void DrawBatch(Batch& batch, const glm::mat4& MVP);
+
+	unsigned m_programID;
+	unsigned m_textureID;
+	int m_parameters[U_TOTAL];
+	unsigned numRow, numCol;
+
+	float advance;
+	glm::vec2 worldOrigin, screenOrigin;
+
+	Batch worldBatch, screenBatch;
+	std::map<std::string, std::vector<Vertex>> glyphCache; // unit-size quads per string
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "TextureCompressor.h"
+
+namespace
+{
+	// 4x4 block of pixels as RGBA
+	struct Block
+	{
+		int rgba[16][4];
+	};
+
+	void FetchBlock(const unsigned char* pixels, unsigned width, unsigned height, unsigned bytesPerPixel,
+		unsigned blockX, unsigned blockY, Block& block)
+	{
+		for (unsigned y = 0; y < 4; ++y)
+		{
+			unsigned row = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+			for (unsigned x = 0; x < 4; ++x)
+			{
+				unsigned column = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+				const unsigned char* pixel = pixels + (row * width + column) * bytesPerPixel;
+				int* texel = block.rgba[y * 4 + x];
+				texel[0] = pixel[2];
+				texel[1] = pixel[1];
+				texel[2] = pixel[0];
+				texel[3] = bytesPerPixel == 4 ? pixel[3] : 255;
+			}
+		}
+	}
+
+	unsigned short To565(const float color[3])
+	{
+		int r = static_cast<int>(color[0] * 31.f / 255.f + 0.5f);
+		int g = static_cast<int>(color[1] * 63.f / 255.f + 0.5f);
+		int b = static_cast<int>(color[2] * 31.f / 255.f + 0.5f);
+		r = r < 0 ? 0 : (r > 31 ? 31 : r);
+		g = g < 0 ? 0 : (g > 63 ? 63 : g);
+		b = b < 0 ? 0 : (b > 31 ? 31 : b);
+		return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+	}
+
+	void From565(unsigned short color, int rgb[3])
+	{
+		int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	/******************************************************************************/
+	/*!
+	\brief
+	Encode the colors of a block as two 565 endpoints and 2 bit indices. The
+	endpoints are the ends of the block's principal axis, pulled in by 1/16 of
+	the range so the interpolated colors land on the bulk of the pixels.
+	Always uses the four color mode, as BC3 requires.
+
+	\param block - pixels to encode
+	\param out - receives 8 bytes
+	*/
+	/******************************************************************************/
+	void EncodeColor(const Block& block, unsigned char* out)
+	{
+		float mean[3] = { 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 3; ++c)
+				mean[c] += block.rgba[i][c] / 16.f;
+
+		float covariance[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f }; // rr rg rb gg gb bb
+		for (int i = 0; i < 16; ++i)
+		{
+			float d[3] = { block.rgba[i][0] - mean[0], block.rgba[i][1] - mean[1], block.rgba[i][2] - mean[2] };
+			covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+			covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+		}
+
+		// Power iteration for the principal axis
+		float axis[3] = { 1.f, 1.f, 1.f };
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+			float largest = next[0] > next[1] ? next[0] : next[1];
+			largest = largest > next[2] ? largest : next[2];
+			float smallest = next[0] < next[1] ? next[0] : next[1];
+			smallest = smallest < next[2] ? smallest : next[2];
+			float scale = largest > -smallest ? largest : -smallest;
+			if (scale < 1e-6f)
+				break;
+			for (int c = 0; c < 3; ++c)
+				axis[c] = next[c] / scale;
+		}
+
+		float minProjection = 1e30f, maxProjection = -1e30f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float projection = (block.rgba[i][0] - mean[0]) * axis[0] + (block.rgba[i][1] - mean[1]) * axis[1]
+				+ (block.rgba[i][2] - mean[2]) * axis[2];
+			minProjection = projection < minProjection ? projection : minProjection;
+			maxProjection = projection > maxProjection ? projection : maxProjection;
+		}
+		float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float inset = (maxProjection - minProjection) / 16.f;
+		float high[3], low[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			float unit = axisLength > 0.f ? axis[c] / axisLength : 0.f;
+			high[c] = mean[c] + unit * (maxProjection - inset);
+			low[c] = mean[c] + unit * (minProjection + inset);
+		}
+
+		unsigned short color0 = To565(high), color1 = To565(low);
+		if (color0 < color1)
+		{
+			unsigned short swap = color0;
+			color0 = color1;
+			color1 = swap;
+		}
+
+		unsigned indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0, bestDistance = 0x7FFFFFFF;
+				for (int entry = 0; entry < 4; ++entry)
+				{
+					int distance = 0;
+					for (int c = 0; c < 3; ++c)
+						distance += (block.rgba[i][c] - palette[entry][c]) * (block.rgba[i][c] - palette[entry][c]);
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = entry;
+					}
+				}
+				indices |= static_cast<unsigned>(best) << (2 * i);
+			}
+		}
+
+		out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+		out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = (indices >> (8 * i)) & 0xFF;
+	}
+
+	// Alpha of a block as two endpoints and 3 bit indices, eight value mode
+	void EncodeAlpha(const Block& block, unsigned char* out)
+	{
+		int alpha0 = 0, alpha1 = 255;
+		for (int i = 0; i < 16; ++i)
+		{
+			alpha0 = block.rgba[i][3] > alpha0 ? block.rgba[i][3] : alpha0;
+			alpha1 = block.rgba[i][3] < alpha1 ? block.rgba[i][3] : alpha1;
+		}
+
+		unsigned long long indices = 0;
+		if (alpha0 != alpha1)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				// Step from alpha0 (0) to alpha1 (7); the codes are 0, 2..7, 1
+				int step = ((alpha0 - block.rgba[i][3]) * 14 + (alpha0 - alpha1)) / (2 * (alpha0 - alpha1));
+				unsigned long long code = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+				indices |= code << (3 * i);
+			}
+		}
+
+		out[0] = static_cast<unsigned char>(alpha0);
+		out[1] = static_cast<unsigned char>(alpha1);
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (indices >> (8 * i)) & 0xFF;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Encode an image as BC1; alpha, if any, is dropped
+
+\param pixels - BGR or BGRA rows
+\param width - width in pixels
+\param height - height in pixels
+\param bytesPerPixel - 3 or 4
+\param out - receives the blocks row by row
+*/
+/******************************************************************************/
+void TextureCompressor::CompressBC1(const unsigned char* pixels, unsigned width, unsigned height, unsigned bytesPerPixel, std::vector<unsigned char>& out)
+{
+	unsigned blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	out.resize(blocksX * blocksY * BC1_BLOCK_SIZE);
+
+	Block block;
+	unsigned char* cursor = out.data();
+	for (unsigned blockY = 0; blockY < blocksY; ++blockY)
+	{
+		for (unsigned blockX = 0; blockX < blocksX; ++blockX)
+		{
+			FetchBlock(pixels, width, height, bytesPerPixel, blockX, blockY, block);
+			EncodeColor(block, cursor);
+			cursor += BC1_BLOCK_SIZE;
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Encode an image as BC3
+
+\param pixels - BGRA rows
+\param width - width in pixels
+\param height - height in pixels
+\param out - receives the blocks row by row
+*/
+/******************************************************************************/
+void TextureCompressor::CompressBC3(const unsigned char* pixels, unsigned width, unsigned height, std::vector<unsigned char>& out)
+{
+	unsigned blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	out.resize(blocksX * blocksY * BC3_BLOCK_SIZE);
+
+	Block block;
+	unsigned char* cursor = out.data();
+	for (unsigned blockY = 0; blockY < blocksY; ++blockY)
+	{
+		for (unsigned blockX = 0; blockX < blocksX; ++blockX)
+		{
+			FetchBlock(pixels, width, height, 4, blockX, blockY, block);
+			EncodeAlpha(block, cursor);
+			EncodeColor(block, cursor + 8);
+			cursor += BC3_BLOCK_SIZE;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <vector>
+
+/******************************************************************************/
+/*!
+		Class TextureCompressor:
+\brief	CPU encoder for the S3TC block formats. BC1 stores a 4x4 block of
+		RGB in 8 bytes, BC3 adds 8 bytes of alpha. Pixels are read in TGA
+		order (BGR or BGRA) and a block past the edge of the image repeats
+		the last row and column.
+*/
+/******************************************************************************/
+class TextureCompressor
+{
+public:
+	static const unsigned BC1_BLOCK_SIZE = 8;
+	static const unsigned BC3_BLOCK_SIZE = 16;
+
+	static void CompressBC1(const unsigned char* pixels, unsigned width, unsigned height, unsigned bytesPerPixel, std::vector<unsigned char>& out);
+	static void CompressBC3(const unsigned char* pixels, unsigned width, unsigned height, std::vector<unsigned char>& out);
+};
+
+#endif
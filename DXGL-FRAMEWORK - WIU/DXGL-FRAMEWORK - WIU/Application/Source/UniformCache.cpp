@@ -0,0 +1,153 @@
+#include "UniformCache.h"
+#include "GL\glew.h"
+
+#include <cstring>
+
+UniformCache* UniformCache::m_instance = nullptr;
+
+UniformCache::UniformCache(void)
+	: current(nullptr)
+	, currentProgram(0)
+{
+	frameStats = Stats();
+	lastFrameStats = Stats();
+}
+
+UniformCache::~UniformCache(void)
+{
+}
+
+UniformCache* UniformCache::GetInstance(void)
+{
+	if (m_instance == nullptr)
+	{
+		m_instance = new UniformCache();
+	}
+	return m_instance;
+}
+
+void UniformCache::DestroyInstance(void)
+{
+	if (m_instance)
+	{
+		delete m_instance;
+		m_instance = nullptr;
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Make a program current, skipping glUseProgram if it already is
+
+\param programID - program returned by LoadShaders
+*/
+/******************************************************************************/
+void UniformCache::UseProgram(unsigned programID)
+{
+	if (current && currentProgram == programID)
+		return;
+
+	glUseProgram(programID);
+	currentProgram = programID;
+	current = &programs[programID];
+}
+
+/******************************************************************************/
+/*!
+\brief
+Drop the shadow copy of a program; call before glDeleteProgram, since GL may
+hand the same name to the next program
+
+\param programID - program about to be deleted
+*/
+/******************************************************************************/
+void UniformCache::ForgetProgram(unsigned programID)
+{
+	if (currentProgram == programID)
+	{
+		glUseProgram(0);
+		current = nullptr;
+		currentProgram = 0;
+	}
+	programs.erase(programID);
+}
+
+void UniformCache::Uniform1i(int location, int value)
+{
+	if (Changed(location, &value, sizeof(value)))
+		glUniform1i(location, value);
+}
+
+void UniformCache::Uniform1f(int location, float value)
+{
+	if (Changed(location, &value, sizeof(value)))
+		glUniform1f(location, value);
+}
+
+void UniformCache::Uniform3fv(int location, const float* value)
+{
+	if (Changed(location, value, 3 * sizeof(float)))
+		glUniform3fv(location, 1, value);
+}
+
+void UniformCache::Uniform4fv(int location, const float* value)
+{
+	if (Changed(location, value, 4 * sizeof(float)))
+		glUniform4fv(location, 1, value);
+}
+
+void UniformCache::UniformMatrix4fv(int location, const float* value)
+{
+	if (Changed(location, value, 16 * sizeof(float)))
+		glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Move the counters of this frame to the last frame; call once per frame
+*/
+/******************************************************************************/
+void UniformCache::EndFrame(void)
+{
+	lastFrameStats = frameStats;
+	frameStats = Stats();
+}
+
+const UniformCache::Stats& UniformCache::GetFrameStats(void) const
+{
+	return frameStats;
+}
+
+const UniformCache::Stats& UniformCache::GetLastFrameStats(void) const
+{
+	return lastFrameStats;
+}
+
+// Compare against the shadow copy and store the value if it differs
+bool UniformCache::Changed(int location, const void* value, unsigned size)
+{
+	// Uniforms the compiler removed have no location; GL ignores them anyway
+	if (location < 0 || !current)
+		return location >= 0;
+
+	if (static_cast<unsigned>(location) >= current->size())
+	{
+		Slot empty;
+		empty.valid = false;
+		current->resize(location + 1, empty);
+	}
+
+	Slot& slot = (*current)[location];
+	if (slot.valid && std::memcmp(slot.value, value, size) == 0)
+	{
+		++frameStats.skipped;
+		return false;
+	}
+
+	std::memcpy(slot.value, value, size);
+	slot.valid = true;
+	++frameStats.uploads;
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <map>
+#include <vector>
+
+/******************************************************************************/
+/*!
+		Class UniformCache:
+\brief	Keeps a shadow copy of the per-draw uniforms of every program and
+		skips glUniform calls that would upload the value already set.
+		All uniform uploads and glUseProgram calls must go through it, or
+		the shadow copy goes stale.
+*/
+/******************************************************************************/
+class UniformCache
+{
+public:
+	struct Stats
+	{
+		unsigned uploads;
+		unsigned skipped;
+	};
+
+	static UniformCache* GetInstance(void);
+	static void DestroyInstance(void);
+
+	void UseProgram(unsigned programID);
+	void ForgetProgram(unsigned programID);
+
+	void Uniform1i(int location, int value);
+	void Uniform1f(int location, float value);
+	void Uniform3fv(int location, const float* value);
+	void Uniform4fv(int location, const float* value);
+	void UniformMatrix4fv(int location, const float* value);
+
+	// Counters of the frame being drawn and of the last finished frame
+	void EndFrame(void);
+	const Stats& GetFrameStats(void) const;
+	const Stats& GetLastFrameStats(void) const;
+
+private:
+	UniformCache(void);
+	~UniformCache(void);
+
+	struct Slot
+	{
+		float value[16]; // big enough for a mat4
+		bool valid;
+	};
+
+	bool Changed(int location, const void* value, unsigned size);
+
+	static UniformCache* m_instance;
+
+	std::map<unsigned, std::vector<Slot>> programs;
+	std::vector<Slot>* current;
+	unsigned currentProgram;
+	Stats frameStats, lastFrameStats;
+};
+
+#endif
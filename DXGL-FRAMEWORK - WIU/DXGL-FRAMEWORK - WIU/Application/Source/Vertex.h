@@ -15,4 +15,11 @@ struct Vertex
 	glm::vec2 texCoord;
 };
 
+// Per-instance attributes for Mesh::RenderInstanced
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 color; // multiplied with the vertex color
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "VertexFormat.h"
+#include "GL\glew.h"
+
+#include <glm\gtc\packing.hpp>
+
+#include <cstring>
+
+namespace
+{
+	const unsigned POSITION_SIZE = sizeof(glm::vec3);
+	const unsigned NORMAL_SIZE = sizeof(glm::uint32);
+	const unsigned TEXCOORD_SIZE = sizeof(glm::uint32);
+	const unsigned COLOR_SIZE = 4;
+
+	unsigned char ToUnorm8(float value)
+	{
+		value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+		return static_cast<unsigned char>(value * 255.f + 0.5f);
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Size of one packed vertex
+
+\param format - VERTEX_FORMAT bits
+\return bytes per vertex, from 12 for positions only to 24
+*/
+/******************************************************************************/
+unsigned GetVertexStride(unsigned format)
+{
+	unsigned stride = POSITION_SIZE;
+	if (format & VERTEX_NORMAL)
+		stride += NORMAL_SIZE;
+	if (format & VERTEX_TEXCOORD)
+		stride += TEXCOORD_SIZE;
+	if (format & VERTEX_COLOR)
+		stride += COLOR_SIZE;
+	return stride;
+}
+
+/******************************************************************************/
+/*!
+\brief
+Pack vertices into the layout SetVertexAttributes describes
+
+\param vertices - vertices to pack
+\param count - number of vertices
+\param format - VERTEX_FORMAT bits
+\param out - receives count * GetVertexStride(format) bytes
+*/
+/******************************************************************************/
+void PackVertices(const Vertex* vertices, unsigned count, unsigned format, std::vector<unsigned char>& out)
+{
+	unsigned stride = GetVertexStride(format);
+	out.resize(count * stride);
+	unsigned char* cursor = out.data();
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Vertex& vertex = vertices[i];
+		memcpy(cursor, &vertex.pos, POSITION_SIZE);
+		cursor += POSITION_SIZE;
+
+		if (format & VERTEX_NORMAL)
+		{
+			glm::uint32 normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.f));
+			memcpy(cursor, &normal, NORMAL_SIZE);
+			cursor += NORMAL_SIZE;
+		}
+		if (format & VERTEX_TEXCOORD)
+		{
+			glm::uint32 texCoord = glm::packHalf2x16(vertex.texCoord);
+			memcpy(cursor, &texCoord, TEXCOORD_SIZE);
+			cursor += TEXCOORD_SIZE;
+		}
+		if (format & VERTEX_COLOR)
+		{
+			cursor[0] = ToUnorm8(vertex.color.r);
+			cursor[1] = ToUnorm8(vertex.color.g);
+			cursor[2] = ToUnorm8(vertex.color.b);
+			cursor[3] = 255;
+			cursor += COLOR_SIZE;
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+\brief
+Point the attributes of the bound VAO into the bound VBO for a packed format.
+The shaders still read vec3 normals and vec2 texture coordinates; GL widens
+the packed values.
+
+\param format - VERTEX_FORMAT bits of the VBO
+*/
+/******************************************************************************/
+void SetVertexAttributes(unsigned format)
+{
+	GLsizei stride = GetVertexStride(format);
+	size_t offset = 0;
+
+	glEnableVertexAttribArray(VERTEX_POSITION_LOCATION);
+	glVertexAttribPointer(VERTEX_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+	offset += POSITION_SIZE;
+
+	if (format & VERTEX_NORMAL)
+	{
+		glEnableVertexAttribArray(VERTEX_NORMAL_LOCATION);
+		glVertexAttribPointer(VERTEX_NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+		offset += NORMAL_SIZE;
+	}
+	else
+		glDisableVertexAttribArray(VERTEX_NORMAL_LOCATION);
+
+	if (format & VERTEX_TEXCOORD)
+	{
+		glEnableVertexAttribArray(VERTEX_TEXCOORD_LOCATION);
+		glVertexAttribPointer(VERTEX_TEXCOORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+		offset += TEXCOORD_SIZE;
+	}
+	else
+		glDisableVertexAttribArray(VERTEX_TEXCOORD_LOCATION);
+
+	if (format & VERTEX_COLOR)
+	{
+		glEnableVertexAttribArray(VERTEX_COLOR_LOCATION);
+		glVertexAttribPointer(VERTEX_COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offset);
+		offset += COLOR_SIZE;
+	}
+	else
+		glDisableVertexAttribArray(VERTEX_COLOR_LOCATION);
+}
+
+unsigned GetIndexSize(unsigned vertexCount)
+{
+	return vertexCount <= 0x10000 ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Narrow indices to indexSize bytes each
+
+\param indices - 32 bit indices
+\param count - number of indices
+\param indexSize - 2 or 4, from GetIndexSize
+\param out - receives count * indexSize bytes
+*/
+/******************************************************************************/
+void PackIndices(const unsigned* indices, unsigned count, unsigned indexSize, std::vector<unsigned char>& out)
+{
+	out.resize(count * indexSize);
+	if (indexSize == sizeof(GLuint))
+	{
+		memcpy(out.data(), indices, count * sizeof(GLuint));
+		return;
+	}
+
+	GLushort* shorts = reinterpret_cast<GLushort*>(out.data());
+	for (unsigned i = 0; i < count; ++i)
+		shorts[i] = static_cast<GLushort>(indices[i]);
+}
@@ -0,0 +1,35 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <vector>
+
+#include "Vertex.h"
+
+// Attributes a mesh keeps per vertex in its VBO, packed behind the float
+// position in this order. What a mesh leaves out is a constant at draw time:
+// the mesh color, a +Z normal or a (0,0) texture coordinate.
+enum VERTEX_FORMAT
+{
+	VERTEX_POSITION = 0,
+	VERTEX_NORMAL = 1 << 0,   // GL_INT_2_10_10_10_REV, normalized
+	VERTEX_TEXCOORD = 1 << 1, // 2 half floats
+	VERTEX_COLOR = 1 << 2,    // 4 unsigned bytes, normalized
+
+	VERTEX_LIT_TEXTURED = VERTEX_NORMAL | VERTEX_TEXCOORD,
+};
+
+// Attribute locations shared by every vertex shader
+const unsigned VERTEX_POSITION_LOCATION = 0;
+const unsigned VERTEX_COLOR_LOCATION = 1;
+const unsigned VERTEX_NORMAL_LOCATION = 2;
+const unsigned VERTEX_TEXCOORD_LOCATION = 3;
+
+unsigned GetVertexStride(unsigned format);
+void PackVertices(const Vertex* vertices, unsigned count, unsigned format, std::vector<unsigned char>& out);
+void SetVertexAttributes(unsigned format);
+
+// 16 bit indices whenever every vertex can be addressed with them
+unsigned GetIndexSize(unsigned vertexCount);
+void PackIndices(const unsigned* indices, unsigned count, unsigned indexSize, std::vector<unsigned char>& out);
+
+#endif
@@ -1,11 +1,62 @@
 
 
 #include "Application.h"
+#include "MeshBin.h"
+#include "LoadOBJ.h"
+#include "MeshBuilder.h"
+#include "TexBin.h"
+#include <GL\glew.h>
+#include "LoadTGA.h"
 
-int main( void )
+#include <cstring>
+
+int main( int argc, char* argv[] )
 {
 	Application app;
+
+	// Load OBJ and TGA files as they are written, e.g. to compare against the optimized ones
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--no-mesh-opt") == 0)
+			MeshBuilder::SetOptimizeOBJ(false);
+		if (strcmp(argv[i], "--no-tex-compress") == 0)
+			SetTextureCompression(false);
+		// Anti-aliasing of the scenes: --aa=msaa (default), --aa=fxaa or --aa=none
+		if (strncmp(argv[i], "--aa=", 5) == 0)
+		{
+			for (int mode = 0; mode < DynamicResolution::AA_TOTAL; ++mode)
+			{
+				DynamicResolution::ANTI_ALIASING antiAliasing = static_cast<DynamicResolution::ANTI_ALIASING>(mode);
+				if (strcmp(argv[i] + 5, DynamicResolution::GetName(antiAliasing)) == 0)
+					app.SetAntiAliasing(antiAliasing);
+			}
+		}
+	}
+
+	// Time loading the models from OBJ and from .meshbin, without opening a window
+	if (argc > 1 && strcmp(argv[1], "--bench-meshbin") == 0)
+	{
+		MeshBin::Benchmark("Models//");
+		return 0;
+	}
+	// Texture memory and load times from TGA and from .texbin
+	if (argc > 1 && strcmp(argv[1], "--bench-tga") == 0)
+	{
+		TexBin::Benchmark("Images//");
+		return 0;
+	}
+	// Time the OBJ parser on a file, or on a generated grid
+	if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0)
+	{
+		BenchmarkOBJ(argc > 2 ? argv[2] : nullptr);
+		return 0;
+	}
+
 	app.Init();
-	app.Run();
+	// Frame time and memory of MSAA, FXAA and no anti-aliasing in every scene
+	if (argc > 1 && strcmp(argv[1], "--bench-aa") == 0)
+		app.BenchmarkAntiAliasing();
+	else
+		app.Run();
 	app.Exit();
 }
\ No newline at end of file